@@ -1,4 +1,5 @@
 #include <thread>
+#include <vector>
 #include <chrono>
 #include <atomic>
 #include <iostream>
@@ -9,23 +10,27 @@
 #include "ravine_utils.hpp"
 #include "ravine_packets.hpp"
 #include "ravine_video_source.hpp"
+#include "ravine_capture_manager.hpp"
 #include "ravine_event_source.hpp"
 #include "ravine_audio_filter.hpp"
 #include "ravine_neuron_filter.hpp"
+#include "ravine_population_filter.hpp"
 #include "ravine_datafile_sink.hpp"
+#include "ravine_thread_policy.hpp"
+#include "ravine_frame_budget.hpp"
+#include "ravine_integral_filter.hpp"
+#include "ravine_spike_mixer.hpp"
 
 #include "ravine_argparse.hpp"
 
-#define FRAMERATE 15
-
 #define MICROSECONDS 1000000
 #define WIDTH 320
 #define HEIGHT 240
 
-// NOTE: assumes a 128x128 RF (which will be centered), smaller or larger RFs
-// will be offset...
-#define LEFT 96
-#define TOP  56
+// seconds of streaming before the first budget report, and between checks
+// for overruns after that
+#define BUDGET_WARMUP 2
+#define BUDGET_PERIOD 5
 
 std::atomic_flag GLOBAL_WAIT = ATOMIC_FLAG_INIT;
 
@@ -44,16 +49,110 @@ void usage()
     std::cout <<
     "\n------------------------------------------------------\n"
     "Usage: ravine <options> \n"
-    "   -d DEV      - path to the video device to use (e.g. /dev/video0)\n"
+    "   -d DEV      - path to the video device to use (e.g. /dev/video0),\n"
+    "                 repeat for more cameras: each gets a model of it's own\n"
+    "                 (the same RF / population), their spikes are heard\n"
+    "                 (and saved) together\n"
+    "   -F FORMAT   - capture pixel format: auto (default, cheapest the camera\n"
+    "                 supports), grey, nv12, yu12, yuyv or mjpeg\n"
+    "   -L          - low latency: only the newest frame is processed (stale\n"
+    "                 ones are skipped) and the buffer count is tuned down to\n"
+    "                 the fewest that avoid drops\n"
+    "   -A          - auto exposure: exposure (and gain) follow the scene\n"
+    "                 brightness, w/in what the frame rate allows, every\n"
+    "                 change is logged w/ the frame it was made on\n"
+    "   -I          - integer (fixed point) correlation for the model neuron,\n"
+    "                 meant for the pi (NEON, untimed), no faster on an\n"
+    "                 x86 desktop, ignored w/ -P\n"
+    "   -K KERNEL   - temporal kernel for the model neuron, as\n"
+    "                 biphasic:FAST,SLOW[,WEIGHT[,ORDER]] (ms) or\n"
+    "                 fir:T0,T1,... (one tap per frame), default none, a\n"
+    "                 population sets it's own w/ \"temporal KERNEL\" lines\n"
+    "   -S SPIKES   - how responses become spikes: threshold (default, at\n"
+    "                 most one per frame), or poisson / lif, a rate of\n"
+    "                 GAIN x (response - OFFSET) Hz w/ spikes at sub-frame\n"
+    "                 times, as MODE[:GAIN[,OFFSET[,MAX_RATE[,REFRACTORY\n"
+    "                 [,TAU_M]]]]] (times in ms)\n"
+    "   -D DELAY    - ms from a spike's time to it's onset at the speaker\n"
+    "                 (default 150), constant as long as each spike reaches\n"
+    "                 the audio callback in time, i.e. it covers the capture\n"
+    "                 -> spike latency plus an audio buffer and the device's\n"
+    "                 output latency\n"
+    "   -V VOICES   - overlapping spikes heard at once (default 32, up to\n"
+    "                 256), each further spike cuts the oldest one short\n"
+    "   -R FPS      - capture frame rate (default 15, up to 120 if the camera\n"
+    "                 can), per-stage frame time is checked against it\n"
     "   -p PORT     - use port PORT to listen for TCP/IP trigger / event connections\n"
     "                 set to -1 to omit\n"
     "   -f DATAFILE - output path for saving data (omit to not save data)\n"
     "   -r RFFILE   - path to RF file to use for the model neuron\n"
+    "   -P POPFILE  - path to a population file (one \"RFFILE COL ROW\" per\n"
+    "                 line, or \"dog CENTER SURROUND COL ROW\" for a box\n"
+    "                 center-surround cell) to model a population of neurons\n"
+    "                 instead of one\n"
+    "   -T POLICY   - scheduling of one role's threads, as\n"
+    "                 ROLE=SCHED[:PRIO][@CPU[,CPU...]] w/ ROLE one of capture,\n"
+    "                 compute, audio or io and SCHED fifo or other, e.g.\n"
+    "                 -T capture=fifo:80@2 -T io=other@0 (repeat per role)\n"
     "   -h          - print this help message\n"
     "------------------------------------------------------\n"
     << std::endl;
 }
 
+/* ========================================================================= */
+typedef RVN::Filter<RVN::ImagePacket, RVN::SpikeBatch> Model;
+
+// the model for one camera, a single neuron in the middle of the frame or a
+// population, w/ the part of the frame it looks at in <roi>. Returns nullptr
+// (and says why) if it can't be made
+Model* make_model(const std::string& rffile, const std::string& popfile,
+    bool fixed, const RVN::TemporalKernel& kernel,
+    const RVN::SpikeParams& spike_params, RVN::FrameBudget* budget,
+    RVN::CropWindow& roi)
+{
+    if (popfile.empty())
+    {
+        RVN::NeuronFilter* neuron = new RVN::NeuronFilter(rffile.c_str(), 0, 0,
+            8);
+
+        if (!neuron->isvalid())
+        {
+            printf("[ERROR]: failed to initialize neuron filter\n");
+            printf("    [MSG]: %s\n", neuron->get_error_msg().c_str());
+            delete neuron;
+            return nullptr;
+        }
+
+        // a single RF sits in the middle of the frame, whatever it's size
+        neuron->set_position((WIDTH - neuron->width()) / 2,
+            (HEIGHT - neuron->height()) / 2);
+
+        neuron->set_budget(budget);
+        neuron->set_fixed_point(fixed);
+        (void)neuron->set_temporal(kernel);
+        (void)neuron->set_spike_params(spike_params);
+
+        roi = neuron->window();
+        return neuron;
+    }
+
+    RVN::PopulationFilter* population = new RVN::PopulationFilter(
+        popfile.c_str(), 8);
+
+    if (!population->isvalid())
+    {
+        printf("[ERROR]: failed to initialize population filter\n");
+        printf("    [MSG]: %s\n", population->get_error_msg().c_str());
+        delete population;
+        return nullptr;
+    }
+
+    population->set_budget(budget);
+    (void)population->set_spike_params(spike_params);
+
+    roi = population->bounds();
+    return population;
+}
 /* ========================================================================= */
 int main(int narg, const char** args)
 {
@@ -62,44 +161,177 @@ int main(int narg, const char** args)
     signal(SIGINT, handle_signal);
     (void)keep_waiting();
 
-    std::string dev, ofile, rffile;
-    int port;
-    bool save, listen;
+    std::string ofile, rffile, popfile, format, temporal, spikes;
+    std::vector<std::string> devs, threads;
+    int port, fps;
+    bool save, listen, latest, autoexp, fixed;
+    float delay;
+    int voices;
 
-    if (RVN::arg_parse(args, narg, dev, rffile, ofile, port, save, listen) < 0)
+    RVN::PixelFormat pixel_format;
+
+    if (RVN::arg_parse(args, narg, devs, rffile, popfile, ofile, format, port,
+        fps, save, listen, latest, autoexp, fixed, temporal, spikes, delay,
+        voices, threads) < 0)
     {
         usage();
         return -1;
     }
 
-    RVN::AudioFilter audio;
-
-    RVN::V4L2 video(dev.c_str(), WIDTH, HEIGHT, FRAMERATE);
+    if (!RVN::format_from_name(format.c_str(), pixel_format))
+    {
+        printf("[ERROR]: invalid pixel format \"%s\"\n", format.c_str());
+        usage();
+        return -1;
+    }
 
-    if (!video.open_stream())
+    RVN::TemporalKernel kernel;
+    if (!RVN::parse_temporal_kernel(temporal, kernel))
     {
-        printf("[ERROR]: failed to open stream\n");
-        printf("[MSG]: %s\n", video.get_error_msg().c_str());
+        printf("[ERROR]: invalid temporal kernel \"%s\"\n", temporal.c_str());
+        usage();
         return -1;
     }
 
-    if (!video.initialize_buffers(16))
+    RVN::SpikeParams spike_params;
+    if (!RVN::parse_spike_params(spikes, spike_params))
     {
-        printf("[ERROR]: failed to init buffers\n");
-        printf("[MSG]: %s\n", video.get_error_msg().c_str());
+        printf("[ERROR]: invalid spike generator \"%s\"\n", spikes.c_str());
+        usage();
         return -1;
     }
 
-    RVN::NeuronFilter neuron(rffile.c_str(), LEFT, TOP, 8);
+    for (size_t k = 0; k < threads.size(); ++k)
+    {
+        if (!RVN::parse_thread_policy(threads[k]))
+        {
+            printf("[ERROR]: invalid thread policy \"%s\"\n",
+                threads[k].c_str());
+            usage();
+            return -1;
+        }
+    }
 
-    if (!neuron.isvalid())
+    RVN::AudioFilter audio;
+    audio.set_latency(delay / 1000.0f);
+
+    if (!audio.set_max_voices(voices))
     {
-        printf("[ERROR]: failed to initialize neuron filter\n");
-        printf("    [MSG]: %s\n", neuron.get_error_msg().c_str());
+        printf("[ERROR]: invalid number of voices %d\n", voices);
+        usage();
         return -1;
     }
 
+    const int ncam = devs.size();
+
+    // one pipeline per camera: camera -> (integral image ->) model, every
+    // model's spikes go through the mixer to the one audio stream
+    std::vector<RVN::V4L2*> cameras;
+    std::vector<Model*> models;
+    std::vector<RVN::IntegralFilter*> integrals;
+
+    RVN::SpikeMixer mixer;
+
+    // w/ more than one camera every frame is captured on one thread
+    RVN::CaptureManager manager;
+
+    // every stage of the pipeline is timed against the frame interval that
+    // the cameras actually give us (the shortest, if they differ)
+    RVN::FrameBudget budget(fps);
+    float max_fps = 0.0f;
+
     RVN::DataFileSink* datafile = nullptr;
+    RVN::EventSource* events = nullptr;
+
+    bool streaming = false;
+
+    for (int k = 0; k < ncam; ++k)
+    {
+        RVN::V4L2* video = new RVN::V4L2(devs[k].c_str(), WIDTH, HEIGHT, fps,
+            pixel_format);
+        cameras.push_back(video);
+
+        if (!video->open_stream())
+        {
+            printf("[ERROR]: failed to open stream for %s\n", devs[k].c_str());
+            printf("[MSG]: %s\n", video->get_error_msg().c_str());
+            EXIT_CODE = -1;
+            goto error;
+        }
+
+        // the part of the frame the model looks at, and so all we need to
+        // capture
+        RVN::CropWindow roi;
+
+        Model* model = make_model(rffile, popfile, fixed, kernel,
+            spike_params, &budget, roi);
+
+        if (model == nullptr)
+        {
+            EXIT_CODE = -1;
+            goto error;
+        }
+        models.push_back(model);
+
+        // only transfer the pixels the RFs cover (if the camera can crop),
+        // the model learns where it's frames start when the stream starts
+        // (see RVN::Sink::format_changed())
+        if (!video->fit_roi(roi) || !video->initialize_buffers(16))
+        {
+            printf("[ERROR]: failed to init buffers for %s\n",
+                devs[k].c_str());
+            printf("[MSG]: %s\n", video->get_error_msg().c_str());
+            EXIT_CODE = -1;
+            goto error;
+        }
+
+        max_fps = RVN_MAX(max_fps, video->framerate());
+
+        video->set_budget(&budget);
+
+        // 16 buffers is the most we'll use, the tuner takes out what's not
+        // needed
+        video->set_latest_only(latest);
+        video->set_auto_tune(latest);
+
+        video->set_auto_exposure(autoexp);
+
+        model->register_sink(&mixer);
+
+        if (!model->has_valid_sink())
+        {
+            printf("[ERROR]: failed to register sink with source\n");
+            EXIT_CODE = -1;
+            goto error;
+        }
+
+        // a population shares one integral image of each frame
+        if (!popfile.empty())
+        {
+            RVN::IntegralFilter* integral = new RVN::IntegralFilter();
+            integrals.push_back(integral);
+
+            integral->set_budget(&budget);
+            integral->register_sink(model);
+            video->register_sink(integral);
+        }
+        else
+        {
+            video->register_sink(model);
+        }
+
+        if (!video->has_valid_sink())
+        {
+            printf("[ERROR]: failed to register sink with source\n");
+            EXIT_CODE = -1;
+            goto error;
+        }
+
+        if (ncam > 1) { (void)manager.add_camera(video); }
+    }
+
+    if (max_fps > 0.0f) { budget.set_framerate(max_fps); }
+
     if (save)
     {
         datafile = new RVN::DataFileSink(ofile.c_str(), audio.frames_per_buffer);
@@ -108,12 +340,11 @@ int main(int narg, const char** args)
         {
             printf("[ERROR]: failed to init sink\n");
             printf("[MSG]: %s\n", datafile->get_error_msg().c_str());
-            delete datafile;
-            return -1;
+            EXIT_CODE = -1;
+            goto error;
         }
     }
 
-    RVN::EventSource* events = nullptr;
     if (listen)
     {
         events = new RVN::EventSource(port);
@@ -126,8 +357,8 @@ int main(int narg, const char** args)
             if (!events->has_valid_sink())
             {
                 printf("[ERROR]: failed to register sink for event source\n");
-                delete events;
-                return -1;
+                EXIT_CODE = -1;
+                goto error;
             }
         }
 
@@ -154,23 +385,7 @@ int main(int narg, const char** args)
         }
     }
 
-    neuron.register_sink(&audio);
-
-    if (!neuron.has_valid_sink())
-    {
-        printf("[ERROR]: failed to register sink with source\n");
-        EXIT_CODE = -1;
-        goto error;
-    }
-
-    video.register_sink(&neuron);
-
-    if (!video.has_valid_sink())
-    {
-        printf("[ERROR]: failed to register sink with source\n");
-        EXIT_CODE = -1;
-        goto error;
-    }
+    mixer.register_sink(&audio);
 
     printf("[MAIN]: everything seems to be working...\n");
 
@@ -191,48 +406,82 @@ int main(int narg, const char** args)
         }
     }
 
-    if (!video.start_stream())
+    streaming = ncam > 1 ? manager.start_stream() :
+        cameras[0]->start_stream();
+
+    if (!streaming)
     {
         printf("[ERROR]: failed to start stream\n");
-        printf("[MSG]: %s\n", video.get_error_msg().c_str());
+        printf("[MSG]: %s\n", ncam > 1 ? manager.get_error_msg().c_str() :
+            cameras[0]->get_error_msg().c_str());
         EXIT_CODE = -1;
-        goto error;
     }
-
-    printf("[MAIN]: entering main loop!\n");
-    if (listen)
+    else
     {
-        while (events->still_running())
+        printf("[MAIN]: entering main loop!\n");
+
+        // in 100 ms ticks
+        int ticks = 0;
+
+        while (listen ? events->still_running() : keep_waiting())
         {
             RVN::sleep_ms(100);
+            ++ticks;
+
+            // once things have settled, say whether every stage fits in a
+            // frame, after that only complain when one doesn't
+            if (ticks == BUDGET_WARMUP * 10)
+            {
+                if (!budget.report())
+                {
+                    printf("[WARNING]: this machine can't keep up w/ %.1f "
+                        "fps\n", 1000.0f / budget.interval());
+                }
+            }
+            else if (ticks > BUDGET_WARMUP * 10 &&
+                ticks % (BUDGET_PERIOD * 10) == 0)
+            {
+                budget.report_overruns();
+            }
         }
+
+        printf("[MAIN]: exiting main loop!\n");
     }
-    else
+
+    // a failed start may have left some cameras (and the audio) running
+    printf("[MAIN]: stopping video stream!\n");
+    if (ncam > 1)
     {
-        while (keep_waiting())
+        if (!manager.stop_stream() && streaming)
         {
-            RVN::sleep_ms(500);
+            printf("[ERROR]: error during streaming\n");
+            printf("[MSG]: %s\n", manager.get_error_msg().c_str());
+            for (int k = 0; k < ncam; ++k)
+            {
+                if (!cameras[k]->isvalid())
+                {
+                    printf("[MSG]: %s: %s\n", devs[k].c_str(),
+                        cameras[k]->get_error_msg().c_str());
+                }
+            }
+            EXIT_CODE = -1;
         }
     }
-
-    printf("[MAIN]: exiting main loop!\n");
-
-    printf("[MAIN]: stopping video stream!\n");
-    if (!video.stop_stream())
+    else if (!cameras[0]->stop_stream() && streaming)
     {
         printf("[ERROR]: error during streaming\n");
-        printf("[MSG]: %s\n", video.get_error_msg().c_str());
-        video.close_stream();
+        printf("[MSG]: %s\n", cameras[0]->get_error_msg().c_str());
         EXIT_CODE = -1;
-        goto error;
     }
 
     printf("[MAIN]: closing video stream!\n");
-    if (!video.close_stream())
+    for (int k = 0; k < ncam; ++k)
     {
-        printf("[ERROR]: failed to close stream?\n");
-        EXIT_CODE = -1;
-        goto error;
+        if (!cameras[k]->close_stream())
+        {
+            printf("[ERROR]: failed to close stream?\n");
+            EXIT_CODE = -1;
+        }
     }
 
     if (listen)
@@ -250,5 +499,9 @@ error:
     if (datafile != nullptr) { delete datafile; }
     if (events != nullptr) { delete events; }
 
+    for (size_t k = 0; k < cameras.size(); ++k) { delete cameras[k]; }
+    for (size_t k = 0; k < integrals.size(); ++k) { delete integrals[k]; }
+    for (size_t k = 0; k < models.size(); ++k) { delete models[k]; }
+
     return EXIT_CODE;
 }
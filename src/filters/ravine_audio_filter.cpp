@@ -1,5 +1,6 @@
 #include <cstddef>
 #include <cstdio>
+#include <chrono>
 
 extern "C"
 {
@@ -8,6 +9,7 @@ extern "C"
 
 #include "ravine_packets.hpp"
 #include "ravine_pink_noise.hpp"
+#include "ravine_thread_policy.hpp"
 #include "ravine_spike_waveform.hpp"
 #include "ravine_audio_filter.hpp"
 
@@ -18,19 +20,25 @@ namespace RVN
 {
     /* ====================================================================== */
     AudioFilter::AudioFilter() :
-        _isvalid(true), _waveform("./spike.wf"), _noise(NOISE_ROWS, NOISE_LEVEL)
+        _isvalid(true), _waveform("./spike.wf"), _noise(NOISE_ROWS, NOISE_LEVEL),
+        _voices(_waveform.data(), _waveform.length(), voice_capacity,
+            frames_per_buffer),
+        _scheduler(sample_rate)
     {
         (void)error_check(Pa_Initialize());
 
-        // spike flag starts true:
-        //      true = no spike
-        //      false = spike
-        _no_spike.test_and_set();
-
         if (!_waveform.isvalid())
         {
             set_error_msg("Failed to init waveform");
         }
+        else if (!_voices.isvalid() || !_voices.set_max_voices(default_voices))
+        {
+            set_error_msg("Failed to init voices");
+        }
+        else if (!_scheduler.isvalid())
+        {
+            set_error_msg("Failed to init spike queue");
+        }
     }
     /* ---------------------------------------------------------------------- */
     AudioFilter::~AudioFilter()
@@ -55,40 +63,68 @@ namespace RVN
         return isvalid();
     }
     /* ---------------------------------------------------------------------- */
-    int AudioFilter::callback(void* outp, const PaStreamCallbackTimeInfo* /* time */,
+    void AudioFilter::process(SpikeBatch* packet, length_t)
+    {
+        if (packet->empty()) { return; }
+
+        // batches w/o a capture time don't count
+        if (packet->timestamp() >= 0.0)
+        {
+            _spike_latency.add(_clock.now() - packet->timestamp());
+        }
+        _spike_count += packet->size();
+
+        // each spike is played at it's own time (+ latency()), see callback()
+        (void)_scheduler.push(packet->data(), packet->size());
+    }
+    /* ---------------------------------------------------------------------- */
+    int AudioFilter::callback(void* outp, const PaStreamCallbackTimeInfo* time,
         PaStreamCallbackFlags /* status */)
     {
-        // in theory we could use the streamcallbacktime, but that uses
-        // clock_gettime(CLOCK_REALTIME), and we probably want a steady clock,
-        // CLOCK_MONOTONIC or std::chrono::steady_clock which is what _clock
-        // uses, which should aid synchronizing timestamps across threads
-        const float time = _clock.now();
+        // PortAudio's times use it's own clock (CLOCK_REALTIME on some
+        // hosts), so only the DAC time relative to the callback's is used
+        // and mapped onto _clock (CLOCK_MONOTONIC / std::chrono::steady_clock)
+        // which the spike times share
+        const auto t0 = std::chrono::steady_clock::now();
+
+        const double now = _clock.now();
         float* out = static_cast<float*>(outp);
 
-        for (int k = 0; k < frames_per_buffer; ++k)
+        double delay = _output_delay;
+        if (time != nullptr && time->outputBufferDacTime > 0.0 &&
+            time->outputBufferDacTime >= time->currentTime)
         {
-            if (have_spike()) { _isspiking = true; }
+            delay = time->outputBufferDacTime - time->currentTime;
+        }
 
-            if (_isspiking)
-            {
-                // next_sample() will set _isspiking to false once the spike
-                // waveform has been sampled in its entirety, so we retain our
-                // state w.r.t to spiking across calls from PA
-                out[k] = _waveform.next_sample(_isspiking);
-            }
-            else
-            {
-                // NOTE: this was *out++ which *OF COURSE* leaves the pointer
-                // pointing to the *END OF THE ARRAY* for the AudioPacket copy
-                // construction below... WTF...
-                out[k] = _noise.next_sample();
-            }
+        // PortAudio creates this thread, so it gets it's policy (and name) on
+        // the first callback
+        if (!_policy_applied)
+        {
+            apply_thread_policy(ThreadRole::Audio, "rvn-audio");
+            _policy_applied = true;
         }
 
+        // sample offsets (in order) at which a spike starts in this buffer
+        const int* onsets;
+        const int nonsets = _scheduler.schedule(now + delay, frames_per_buffer,
+            onsets);
+
+        // the whole buffer at once, spikes are mixed in over it
+        _noise.fill(out, frames_per_buffer);
+
+        // every spike gets it's own voice, overlapping ones add up, and the
+        // noise is only heard where no voice is playing
+        _voices.render(onsets, nonsets, out, frames_per_buffer);
+
          // sink just copies data and returns
-         AudioPacket packet(out, frames_per_buffer, time);
+         AudioPacket packet(out, frames_per_buffer, now);
          send_sink(&packet, frames_per_buffer);
 
+        _callback_time.add(std::chrono::duration_cast<
+            std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0)
+            .count() * 1e-9);
+
         return paContinue;
     }
     /* ---------------------------------------------------------------------- */
@@ -136,10 +172,27 @@ namespace RVN
             // tell our sink to prepare to receive data
             if (open_sink_stream())
             {
+                // PortAudio may start a new callback thread
+                _policy_applied = false;
+
+                // the device's latency, for hosts that don't give the DAC
+                // time of each buffer
+                const PaStreamInfo* info = Pa_GetStreamInfo(_pa_stream);
+                if (info != nullptr && info->outputLatency > 0.0)
+                {
+                    _output_delay = info->outputLatency;
+                }
+
                 // open the audio stream
                 if (error_check(Pa_StartStream(_pa_stream)))
                 {
                     _stream_open = true;
+
+                    // w/ the seed and it's sample index the background can
+                    // be regenerated offline (PinkNoise::seek())
+                    printf("[AUDIO]: noise seed %llu, from sample %llu\n",
+                        (unsigned long long)_noise.seed(),
+                        (unsigned long long)_noise.position());
                 }
             }
             else
@@ -157,6 +210,43 @@ namespace RVN
             _stream_open = false;
         }
 
+        if (_spike_latency.count() > 0)
+        {
+            printf("[AUDIO]: %llu spikes in %ld batches, capture -> batch "
+                "latency (ms): mean %.3f, sd %.3f, min %.3f, max %.3f\n",
+                (unsigned long long)_spike_count, _spike_latency.count(),
+                _spike_latency.mean() * 1e3,
+                _spike_latency.sd() * 1e3, _spike_latency.min() * 1e3,
+                _spike_latency.max() * 1e3);
+        }
+
+        const RunningStats& render = _scheduler.render_latency();
+        if (render.count() > 0)
+        {
+            printf("[AUDIO]: spike -> DAC latency (ms, target %.1f): mean "
+                "%.3f, sd %.3f, min %.3f, max %.3f, %llu late, %llu dropped\n",
+                _scheduler.latency() * 1e3, render.mean() * 1e3,
+                render.sd() * 1e3, render.min() * 1e3, render.max() * 1e3,
+                (unsigned long long)_scheduler.late(),
+                (unsigned long long)_scheduler.dropped());
+        }
+
+        if (_callback_time.count() > 0)
+        {
+            // the worst case is what has to fit in a buffer's time
+            printf("[AUDIO]: callback (us): mean %.1f, sd %.1f, max %.1f of "
+                "%.1f per buffer\n", _callback_time.mean() * 1e6,
+                _callback_time.sd() * 1e6, _callback_time.max() * 1e6,
+                1e6 * frames_per_buffer / sample_rate);
+        }
+
+        if (_voices.stolen() > 0)
+        {
+            printf("[AUDIO]: %llu spikes cut short by later ones w/ all %d "
+                "voices playing\n", (unsigned long long)_voices.stolen(),
+                _voices.max_voices());
+        }
+
         if (!close_sink_stream())
         {
             if (isvalid())
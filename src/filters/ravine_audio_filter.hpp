@@ -1,7 +1,6 @@
 #ifndef RAVINE_AUDIO_FILTER_HPP_
 #define RAVINE_AUDIO_FILTER_HPP_
 
-#include <atomic>
 #include <string>
 #include <ctime>
 
@@ -11,14 +10,17 @@ extern "C"
 }
 
 #include "ravine_clock.hpp"
+#include "ravine_stats.hpp"
 #include "ravine_packets.hpp"
 #include "ravine_pink_noise.hpp"
 #include "ravine_base_filter.hpp"
+#include "ravine_voice_pool.hpp"
 #include "ravine_spike_waveform.hpp"
+#include "ravine_spike_scheduler.hpp"
 
 namespace RVN
 {
-    class AudioFilter : public Filter<BoolPacket, AudioPacket>
+    class AudioFilter : public Filter<SpikeBatch, AudioPacket>
     {
     public:
         AudioFilter();
@@ -29,13 +31,52 @@ namespace RVN
         bool stop_stream() override;
         bool close_stream() override;
 
-        void process(BoolPacket*, length_t) override { send_spike(); }
+        void process(SpikeBatch* packet, length_t) override;
 
-        inline void send_spike() { _no_spike.clear(); }
+        // queue a spike for right now (heard latency() from now), only call
+        // this from the thread that calls process()
+        inline void send_spike()
+        {
+            Spike spike = {_clock.now(), 0};
+            (void)_scheduler.push(&spike, 1);
+        }
+
+        // s, from a spike's time to it's onset at the DAC, which has to
+        // cover the time from capture to the spike reaching the callback
+        // plus a buffer and the device's output latency for every spike to
+        // be heard on time, only set it while the stream is stopped
+        inline void set_latency(float latency)
+        {
+            _scheduler.set_latency(latency);
+        }
+        inline float latency() const { return _scheduler.latency(); }
+
+        // at most <n> (1 to voice_capacity) overlapping spikes are heard at
+        // once, a spike beyond that cuts the oldest one short, only set it
+        // while the stream is stopped
+        inline bool set_max_voices(int n) { return _voices.set_max_voices(n); }
+        inline int max_voices() const { return _voices.max_voices(); }
+
+        // seconds from the capture of a frame to it's spikes reaching us, one
+        // sample per batch, only valid once the stream has stopped
+        inline const RunningStats& spike_latency() const
+        {
+            return _spike_latency;
+        }
 
-        // only returns true iff send_spike() was just called with *NO*
-        // intervening calls to have_spike()
-        inline bool have_spike() { return _no_spike.test_and_set() == false; }
+        // spikes received, only valid once the stream has stopped
+        inline uint64_t spike_count() const { return _spike_count; }
+
+        // spike time -> onset at the DAC, late and dropped spikes, only valid
+        // once the stream has stopped
+        inline const SpikeScheduler& scheduler() const { return _scheduler; }
+
+        // s, how long each callback takes, only valid once the stream has
+        // stopped
+        inline const RunningStats& callback_time() const
+        {
+            return _callback_time;
+        }
 
         inline bool isvalid() const { return _isvalid; }
 
@@ -75,14 +116,29 @@ namespace RVN
         std::string _err_msg;
 
         bool _stream_open = false;
-        bool _isspiking = false;
+
+        // only touched by callback()
+        bool _policy_applied = false;
 
         PaStream* _pa_stream = nullptr;
 
         WaveForm _waveform;
         PinkNoise _noise;
 
-        std::atomic_flag _no_spike = ATOMIC_FLAG_INIT;
+        // only touched by callback()
+        VoicePool _voices;
+        RunningStats _callback_time;
+
+        // process() queues spikes, callback() plays them
+        SpikeScheduler _scheduler;
+
+        // s, DAC time of the first sample of a buffer - the callback's
+        // time, for hosts that don't report it
+        double _output_delay = output_latency;
+
+        // only touched by process() (i.e. the model's thread)
+        RunningStats _spike_latency;
+        uint64_t _spike_count = 0;
 
         Clock _clock;
 
@@ -90,6 +146,10 @@ namespace RVN
         static constexpr int sample_rate = 24000;
         static constexpr int frames_per_buffer = 1024; //~1.5ms @ 44100Hz
         static constexpr float output_latency = 0.030f; // 30ms, avoids choppy sound
+
+        // overlapping spikes heard at once, by default and at most
+        static constexpr int default_voices = 32;
+        static constexpr int voice_capacity = 256;
     };
 }
 
@@ -0,0 +1,21 @@
+#include "ravine_integral_filter.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    void IntegralFilter::process(ImagePacket* packet, length_t bytes)
+    {
+        const FrameBudget::time_point t0 = FrameBudget::now();
+
+        _integral.build(packet, bytes);
+
+        if (_budget != nullptr) { _budget->add(Stage::Luma, t0); }
+
+        packet->set_integral(&_integral);
+        send_sink(packet, bytes);
+
+        // a sink that held on to the frame can't count on the tables
+        packet->set_integral(nullptr);
+    }
+    /* ====================================================================== */
+}
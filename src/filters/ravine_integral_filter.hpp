@@ -0,0 +1,45 @@
+#ifndef RAVIE_INTEGRAL_FILTER_HPP_
+#define RAVIE_INTEGRAL_FILTER_HPP_
+
+#include "ravine_packets.hpp"
+#include "ravine_frame_budget.hpp"
+#include "ravine_base_filter.hpp"
+#include "ravine_integral_image.hpp"
+
+namespace RVN
+{
+    // a pass-through stage (on the source's thread, no queue) that builds
+    // each frame's IntegralImage once and hands it to the sink w/ the frame
+    // (ImagePacket::integral()), so that everything downstream gets O(1)
+    // window means / energies and box DoGs for the price of one pass
+    class IntegralFilter : public Filter<ImagePacket, ImagePacket>
+    {
+    public:
+        bool open_stream() override { return open_sink_stream(); }
+        bool close_stream() override { return close_sink_stream(); }
+
+        bool start_stream() override { return true; }
+        bool stop_stream() override { return true; }
+
+        void process(ImagePacket* packet, length_t bytes) override;
+
+        // the frames don't change on the way through
+        inline void format_changed(const StreamFormat& fmt) override
+        {
+            notify_sink_format(fmt);
+        }
+
+        // time the build (as Stage::Luma) against the frame interval,
+        // <budget> must outlive the stream
+        inline void set_budget(FrameBudget* budget) { _budget = budget; }
+
+        // the last frame's tables, only safe to look at between frames
+        inline const IntegralImage& integral() const { return _integral; }
+
+    private:
+        IntegralImage _integral;
+        FrameBudget* _budget = nullptr;
+    };
+}
+
+#endif
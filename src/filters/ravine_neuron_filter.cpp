@@ -1,39 +1,16 @@
-#include <fstream>
 #include <string>
 #include <cstdio>
 #include <cmath>
 
 #include "ravine_utils.hpp"
+#include "ravine_thread_policy.hpp"
 #include "ravine_neuron_filter.hpp"
 
 namespace RVN
 {
-    /* ---------------------------------------------------------------------- */
-    float mean(const uint8_t* data, int length)
-    {
-        float mn = 0.0f;
-        for (int k = 0; k < length; ++k)
-        {
-            mn += data[k];
-        }
-        return mn / length;
-    }
-    /* ---------------------------------------------------------------------- */
-    float two_norm(const uint8_t* data, int length, float& mn)
-    {
-        mn = mean(data, length);
-        float mag = 0.0f;
-        for (int k = 0; k < length; ++k)
-        {
-            float tmp = ((float)data[k]) - mn;
-            mag += tmp*tmp;
-        }
-
-        return mag;
-    }
     /* ---------------------------------------------------------------------- */
     NeuronFilter::NeuronFilter(const char* rf_file, int x, int y, int nbuf) :
-        _open(false), _isvalid(true), _rf_mag(0.0f)
+        _open(false), _isvalid(true)
     {
         int width, height;
         if (read_rf_file(rf_file, width, height))
@@ -45,6 +22,9 @@ namespace RVN
             allocate_buffers(nbuf);
 
             printf("[NEURON]: %d buffers allocated\n", _qin.size());
+
+            // purely spatial until told otherwise
+            (void)_temporal.add(TemporalKernel());
         }
         else
         {
@@ -56,10 +36,54 @@ namespace RVN
     {
         delete_queue(_qin);
         delete_queue(_qout);
-        if (_rf != nullptr)
+    }
+    /* ---------------------------------------------------------------------- */
+    void NeuronFilter::set_position(int col, int row)
+    {
+        _win.col = col - _origin_col;
+        _win.row = row - _origin_row;
+    }
+    /* ---------------------------------------------------------------------- */
+    void NeuronFilter::set_origin(int col, int row)
+    {
+        // same place in the full frame, new place in the frames we get
+        _win.col += _origin_col - col;
+        _win.row += _origin_row - row;
+
+        _origin_col = col;
+        _origin_row = row;
+
+        printf("[NEURON]: frames start at (%d, %d), RF @ (%d, %d) w/in them\n",
+            col, row, _win.col, _win.row);
+    }
+    /* ---------------------------------------------------------------------- */
+    bool NeuronFilter::set_temporal(const TemporalKernel& kernel)
+    {
+        TemporalFilter tmp;
+        if (!tmp.add(kernel))
         {
-            delete[] _rf;
+            printf("[NEURON]: invalid temporal kernel\n");
+            return false;
         }
+
+        _temporal = tmp;
+
+        printf("[NEURON]: temporal kernel: %s\n", kernel_name(kernel).c_str());
+
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    bool NeuronFilter::set_spike_params(const SpikeParams& params)
+    {
+        if (!_spikes.configure(1, params, spike_seed()))
+        {
+            printf("[NEURON]: invalid spike generator parameters\n");
+            return false;
+        }
+
+        printf("[NEURON]: %s spikes\n", mode_name(params.mode));
+
+        return true;
     }
     /* ---------------------------------------------------------------------- */
     bool NeuronFilter::open_stream()
@@ -74,7 +98,12 @@ namespace RVN
         {
             (void)persist();
 
-            _process_thread = std::thread(&NeuronFilter::forward_loop, this);
+            // a new stream shouldn't be filtered w/ the old one's past
+            _temporal.reset();
+            _spikes.reset();
+
+            _process_thread = spawn_thread(ThreadRole::Compute, "rvn-neuron",
+                &NeuronFilter::forward_loop, this);
             _open = true;
         }
         else
@@ -110,50 +139,51 @@ namespace RVN
         {
             // this should only be called from a constructor so no need
             // with wait on _qin_busy
-            _qin.push(new FloatPacket());
+            _qin.push(new ActivationPacket());
         }
     }
     /* ---------------------------------------------------------------------- */
-    void NeuronFilter::filter(YUYVImagePacket* packet, length_t bytes, float& act)
+    void NeuronFilter::filter(ImagePacket* packet, length_t bytes, float& act)
     {
-        act = 0.0f;
-        int32_t inc = 0;
+        float frame_mag, xy;
 
-        float frame_mag = 0.0f;
-        float xy = 0.0f;
-        float yi;
+        FrameBudget::time_point t0 = FrameBudget::now();
 
-        // in YUYV, every other element is luminance channel
-        const int row_length = packet->width() * 2;
+        // the luma (and only the luma) mean, for free if the frame comes w/
+        // it's integral image
+        const IntegralImage* ii = packet->integral();
+        const double frame_mean = ii != nullptr ? ii->frame_mean() :
+            luma_mean(packet, bytes);
 
-        const uint8_t* data_in = packet->data();
+        // (an upstream IntegralFilter timed the tables itself)
+        if (_budget != nullptr && ii == nullptr)
+        {
+            _budget->add(Stage::Luma, t0);
+        }
+        t0 = FrameBudget::now();
 
-        float frame_mean = mean(data_in, bytes);
+        if (_fixed)
+        {
+            act = _rf.correlate_fixed(packet, bytes, _win.col, _win.row,
+                frame_mean);
 
-        const int first_col = _win.col * 2;
-        const int last_col = first_col + (_win.width*2);
+            if (_budget != nullptr) { _budget->add(Stage::Neuron, t0); }
+            return;
+        }
 
-        const int last_row = _win.row + _win.height;
+        // zero-mean dot product and energy of the luma w/in our window,
+        // vectorized where possible (see ravine_receptive_field.cpp)
+        _rf.correlate(packet, bytes, _win.col, _win.row, (float)frame_mean,
+            xy, frame_mag);
 
-        for (int k = _win.row; k < last_row; ++k)
-        {
-            for (int j = first_col; j < last_col; j+=2, ++inc)
-            {
-                int32_t idx = k * row_length + j;
-                if (idx < bytes)
-                {
-                    yi = ((float)data_in[idx]) - frame_mean;
-                    frame_mag += yi*yi;
-                    xy += yi * (((float)_rf[inc]) - _rf_mean);
-                }
-            }
-        }
+        const float rf_mag = _rf.mag();
+        const float mx = RVN_MAX(rf_mag, frame_mag);
+        act = xy / mx / sqrt(RVN_MIN(rf_mag, frame_mag) / mx);
 
-        const float mx = RVN_MAX(_rf_mag, frame_mag);
-        act = xy / mx / sqrt(RVN_MIN(_rf_mag, frame_mag) / mx);
+        if (_budget != nullptr) { _budget->add(Stage::Neuron, t0); }
     }
     /* ---------------------------------------------------------------------- */
-    void NeuronFilter::process(YUYVImagePacket* packet, length_t bytes)
+    void NeuronFilter::process(ImagePacket* packet, length_t bytes)
     {
         //printf("[NEURON]: got packet\n");
         if (is_open())
@@ -163,14 +193,23 @@ namespace RVN
             while (wait_flag(_qin_busy)) {/* spin until queue is available */}
 
             // no buffers are available, drop the frame...
-            if (_qin.size() < 1) { return; }
+            if (_qin.size() < 1)
+            {
+                release_flag(_qin_busy);
+                return;
+            }
 
-            FloatPacket* ptr = pop_queue(_qin);
+            ActivationPacket* ptr = pop_queue(_qin);
             release_flag(_qin_busy);
 
             // convolve image with RF
             filter(packet, bytes, ptr->get_data());
 
+            // the response is from when the RF's rows were exposed, which
+            // for a rolling shutter depends on where the RF is
+            ptr->set_timestamp(packet->row_time(_win.row +
+                0.5f * (_win.height - 1)), packet->sequence());
+
             // again, no sleep to stay quick
             while (wait_flag(_qout_busy)) {/* spin */}
             _qout.push(ptr);
@@ -180,41 +219,20 @@ namespace RVN
     /* ---------------------------------------------------------------------- */
     bool NeuronFilter::read_rf_file(const char* filepath, int& width, int& height)
     {
-        bool success = false;
-
-        std::ifstream ifs;
-        ifs.open(filepath, std::ifstream::in | std::ifstream::binary);
+        // the RF builds its mean-subtracted, aligned copy once here so that
+        // filter() doesn't have to re-center every pixel of every frame
+        bool success = _rf.load(filepath);
 
-        if (ifs.good())
-        {
-            std::string tmp;
-            std::getline(ifs, tmp);
-            if (tmp == "P5")
-            {
-                int white;
-                ifs >> width >> height >> white;
-                if (width > 0 && height > 0 && white < 256)
-                {
-                    _rf = new uint8_t[width*height];
-                    ifs.read(reinterpret_cast<char*>(_rf), width*height);
-                    if (ifs)
-                    {
-                        success = true;
-
-                        // pre-calculate the mean and 2-norm of the rf
-                        _rf_mag = two_norm(_rf, width*height, _rf_mean);
-                    }
-                }
-            }
-        }
+        width = _rf.width();
+        height = _rf.height();
 
-        ifs.close();
         return success;
     }
     /* ---------------------------------------------------------------------- */
     void NeuronFilter::forward_loop()
     {
-        BoolPacket packet(true);
+        SpikeBatch batch;
+        batch.reserve(64);
 
         // process input when available until we receive the terminate signal
         while (persist())
@@ -232,27 +250,25 @@ namespace RVN
             {
                 //const float time = _clock.now();
 
-                FloatPacket* ptr = pop_queue(_qout);
+                ActivationPacket* ptr = pop_queue(_qout);
                 release_flag(_qout_busy);
 
-                if (ptr->data() > _threshold)
-                {
-                    // process input? or forward to audio thread? or should this
-                    // all happen in the audio thread?
-                    //printf("[NEURON]: spike \"%f\" @ %f\n", ptr->data(), time);
-                    send_sink(&packet, 1);
-
-                    // increase threshold by 10%
-                    _threshold += (1.0f - _threshold) * _dthreshold;
-                }
-                else
-                {
-                    // printf("[NEURON]: no spike - %f\n", ptr->data());
-                    // decrease threshold by 10%
-                    _threshold *= (1.0f - _dthreshold);
-                }
-
-                // printf("[NEURON]: thr = %f\n", _threshold);
+                const FrameBudget::time_point t0 = FrameBudget::now();
+
+                // the response to this frame and those before it
+                float act = ptr->data();
+                _temporal.step(ptr->timestamp(), &act);
+
+                // the spikes since the previous frame (see SpikeGenerator)
+                const double time = ptr->timestamp();
+
+                batch.clear();
+                batch.copy_timestamp(*ptr);
+                _spikes.generate(&act, &time, batch);
+
+                if (!batch.empty()) { send_sink(&batch, batch.size()); }
+
+                if (_budget != nullptr) { _budget->add(Stage::Dispatch, t0); }
 
                 ptr->set_data(0.0f);
 
@@ -266,8 +282,9 @@ namespace RVN
                 // no packets ready, release _qout
                 release_flag(_qout_busy);
 
-                // queue is empty, might as well actually wait
-                sleep_ms(10);
+                // queue is empty, might as well actually wait, but not so long
+                // as to miss a frame at high frame rates
+                sleep_ms(1);
             }
 
         }
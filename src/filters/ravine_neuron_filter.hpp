@@ -6,11 +6,16 @@
 
 #include "ravine_clock.hpp"
 #include "ravine_packets.hpp"
+#include "ravine_frame_budget.hpp"
 #include "ravine_base_filter.hpp"
+#include "ravine_integral_image.hpp"
+#include "ravine_receptive_field.hpp"
+#include "ravine_temporal_filter.hpp"
+#include "ravine_spike_generator.hpp"
 
 namespace RVN
 {
-    class NeuronFilter : public Filter<YUYVImagePacket, BoolPacket>
+    class NeuronFilter : public Filter<ImagePacket, SpikeBatch>
     {
     public:
         NeuronFilter(const char* rf_file, int x, int y, int nbuf);
@@ -22,11 +27,51 @@ namespace RVN
 
         inline bool is_open() { return _open; }
 
-        inline void process(YUYVImagePacket* packet, length_t bytes);
+        inline void process(ImagePacket* packet, length_t bytes);
 
         inline int width() const { return _win.width; }
         inline int height() const { return _win.height; }
 
+        // the RF's window in frame coordinates (see set_origin())
+        inline CropWindow window() const
+        {
+            return {_win.col + _origin_col, _win.row + _origin_row,
+                _win.width, _win.height};
+        }
+
+        // move the RF's top-left corner to (<col>, <row>) of the frame
+        void set_position(int col, int row);
+
+        // frames passed to process() are the part of the full frame that
+        // starts at (<col>, <row>), e.g. due to a hardware crop (see
+        // V4L2::crop()), the RF stays put w/in the full frame
+        void set_origin(int col, int row);
+
+        // the source's frames changed, follow their origin
+        inline void format_changed(const StreamFormat& fmt) override
+        {
+            set_origin(fmt.crop.col, fmt.crop.row);
+        }
+
+        // compute the response w/ integer sums straight from the uint8 luma
+        // (see ReceptiveField::correlate_fixed()) instead of in float, set
+        // before the stream starts
+        inline void set_fixed_point(bool fixed) { _fixed = fixed; }
+        inline bool fixed_point() const { return _fixed; }
+
+        // give the RF a temporal component: the response compared w/ the
+        // threshold is <kernel> applied to the RF's responses to successive
+        // frames (see TemporalFilter), set before the stream starts
+        bool set_temporal(const TemporalKernel& kernel);
+
+        // how the response becomes spikes (see SpikeGenerator), an adaptive
+        // threshold by default, set before the stream starts
+        bool set_spike_params(const SpikeParams& params);
+
+        // time our stages against the frame interval, <budget> must outlive
+        // the stream
+        inline void set_budget(FrameBudget* budget) { _budget = budget; }
+
         inline const std::string& get_error_msg() const { return _err_msg; }
 
         inline bool isvalid() const { return _isvalid; }
@@ -35,7 +80,7 @@ namespace RVN
         bool read_rf_file(const char*, int&, int&);
         void allocate_buffers(int n);
 
-        void filter(YUYVImagePacket* img, length_t bytes, float& act);
+        void filter(ImagePacket* img, length_t bytes, float& act);
 
         void forward_loop();
 
@@ -64,28 +109,36 @@ namespace RVN
         bool _isvalid;
         std::string _err_msg;
 
+        // relative to the frames we're given, which start at
+        // (_origin_col, _origin_row) of the full frame
         CropWindow _win;
-        uint8_t* _rf = nullptr;
+        int _origin_col = 0;
+        int _origin_row = 0;
+
+        // holds the raw RF along w/ a pre-centered, aligned float copy
+        ReceptiveField _rf;
+
+        bool _fixed = false;
 
-        float _rf_mag;
-        float _rf_mean;
+        // O(1) state per frame, only touched by forward_loop()
+        TemporalFilter _temporal;
 
         std::atomic_flag _state_continue = ATOMIC_FLAG_INIT;
 
         std::atomic_flag _qin_busy = ATOMIC_FLAG_INIT;
-        std::queue<FloatPacket*> _qin;
+        std::queue<ActivationPacket*> _qin;
 
         std::atomic_flag _qout_busy = ATOMIC_FLAG_INIT;
-        std::queue<FloatPacket*> _qout;
+        std::queue<ActivationPacket*> _qout;
 
         std::thread _process_thread;
 
         Clock _clock;
 
-        float _threshold = 0.0f;
+        // only touched by forward_loop() once the stream starts
+        SpikeGenerator _spikes;
 
-         //threshold change per sample in %
-        static constexpr float _dthreshold = 0.1f;
+        FrameBudget* _budget = nullptr;
     };
 }
 
@@ -0,0 +1,527 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include <cmath>
+
+#include "ravine_simd.hpp"
+#include "ravine_utils.hpp"
+#include "ravine_thread_policy.hpp"
+#include "ravine_population_filter.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    PopulationFilter::PopulationFilter(const char* pop_file, int nbuf) :
+        _open(false), _isvalid(true), _bounds({0, 0, 0, 0})
+    {
+        if (read_population_file(pop_file))
+        {
+            finalize();
+
+            printf("[POPULATION]: %d neurons w/in %d x %d @ (%d, %d)\n",
+                size(), _bounds.width, _bounds.height, _bounds.col,
+                _bounds.row);
+
+            // we're not yet parallel, so no need to check busy flags
+            allocate_buffers(nbuf);
+        }
+        else
+        {
+            set_error_msg("Failed to read population file");
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    PopulationFilter::~PopulationFilter()
+    {
+        delete_queue(_qin);
+        delete_queue(_qout);
+
+        for (size_t k = 0; k < _rf.size(); ++k)
+        {
+            delete _rf[k];
+        }
+
+        free_aligned(_luma);
+    }
+    /* ---------------------------------------------------------------------- */
+    bool PopulationFilter::set_spike_params(const SpikeParams& params)
+    {
+        if (!_spikes.configure(size(), params, spike_seed()))
+        {
+            printf("[POPULATION]: invalid spike generator parameters\n");
+            return false;
+        }
+
+        printf("[POPULATION]: %s spikes\n", mode_name(params.mode));
+
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    bool PopulationFilter::open_stream()
+    {
+        open_sink_stream();
+        return start_stream();
+    }
+    /* ---------------------------------------------------------------------- */
+    bool PopulationFilter::start_stream()
+    {
+        if (!is_open() && isvalid())
+        {
+            (void)persist();
+
+            // as in NeuronFilter::start_stream()
+            _temporal.reset();
+            _spikes.reset();
+
+            _process_thread = spawn_thread(ThreadRole::Compute,
+                "rvn-population", &PopulationFilter::forward_loop, this);
+            _open = true;
+        }
+        else
+        {
+            printf("[POPULATION]: failed starting stream\n");
+        }
+        return isvalid() && is_open();
+    }
+    /* ---------------------------------------------------------------------- */
+    bool PopulationFilter::stop_stream()
+    {
+        if (is_open())
+        {
+            _state_continue.clear();
+            _open = false;
+        }
+        return isvalid();
+    }
+    /* ---------------------------------------------------------------------- */
+    bool PopulationFilter::close_stream()
+    {
+        if (is_open()) { (void)stop_stream(); }
+
+        if (_process_thread.joinable()) { _process_thread.join(); }
+
+        close_sink_stream();
+
+        return isvalid();
+    }
+    /* ---------------------------------------------------------------------- */
+    bool PopulationFilter::read_population_file(const char* filepath)
+    {
+        std::ifstream ifs(filepath);
+
+        if (!ifs.good())
+        {
+            set_error_msg("Failed to open population file");
+            return false;
+        }
+
+        // the kernel of the neurons that follow
+        TemporalKernel kernel;
+
+        std::string line;
+        while (std::getline(ifs, line))
+        {
+            std::istringstream is(line);
+
+            std::string rf_file;
+            int col, row;
+
+            // skip blank and comment lines
+            if (!(is >> rf_file) || rf_file[0] == '#') { continue; }
+
+            if (rf_file == "temporal")
+            {
+                std::string spec;
+                if (!(is >> spec) || !parse_temporal_kernel(spec, kernel))
+                {
+                    set_error_msg("Invalid temporal kernel: " + line);
+                    break;
+                }
+
+                printf("[POPULATION]: temporal kernel from neuron %d on: %s\n",
+                    size(), kernel_name(kernel).c_str());
+
+                continue;
+            }
+
+            if (rf_file == "dog")
+            {
+                int center, surround;
+                if (!(is >> center >> surround >> col >> row))
+                {
+                    set_error_msg("Invalid line in population file: " + line);
+                    break;
+                }
+
+                if (!add_dog(center, surround, col, row)) { break; }
+            }
+            else
+            {
+                if (!(is >> col >> row))
+                {
+                    set_error_msg("Invalid line in population file: " + line);
+                    break;
+                }
+
+                if (!add_neuron(rf_file, col, row)) { break; }
+            }
+
+            (void)_temporal.add(kernel);
+        }
+
+        if (isvalid() && _rf.empty())
+        {
+            set_error_msg("Population file lists no neurons");
+        }
+
+        return isvalid();
+    }
+    /* ---------------------------------------------------------------------- */
+    bool PopulationFilter::add_neuron(const std::string& rf_file, int col,
+        int row)
+    {
+        if (col < 0 || row < 0)
+        {
+            set_error_msg("RF position must be >= 0: " + rf_file);
+            return false;
+        }
+
+        ReceptiveField* rf = new ReceptiveField();
+        if (!rf->load(rf_file.c_str()))
+        {
+            set_error_msg("Failed to read rf file " + rf_file);
+            delete rf;
+            return false;
+        }
+
+        _rf.push_back(rf);
+        _center.push_back(0);
+        _col.push_back(col);
+        _row.push_back(row);
+        _width.push_back(rf->width());
+        _height.push_back(rf->height());
+
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    bool PopulationFilter::add_dog(int center, int surround, int col, int row)
+    {
+        if (col < 0 || row < 0)
+        {
+            set_error_msg("DoG position must be >= 0");
+            return false;
+        }
+
+        if (center < 1 || surround <= center)
+        {
+            set_error_msg("DoG center must be >= 1 px and smaller than it's "
+                "surround");
+            return false;
+        }
+
+        _rf.push_back(nullptr);
+        _center.push_back(center);
+        _col.push_back(col);
+        _row.push_back(row);
+        _width.push_back(surround);
+        _height.push_back(surround);
+
+        _has_dog = true;
+
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    void PopulationFilter::finalize()
+    {
+        const int n = size();
+
+        _xy.resize(n);
+        _energy.resize(n);
+
+        (void)_spikes.configure(n, SpikeParams(), spike_seed());
+        _active.reserve(n);
+
+        // sweep order: neurons are picked up as the first row of their RF
+        // is reached, center-surround cells don't take part
+        _order.clear();
+        for (int k = 0; k < n; ++k)
+        {
+            if (_rf[k] != nullptr) { _order.push_back(k); }
+        }
+
+        std::stable_sort(_order.begin(), _order.end(),
+            [this](int a, int b) { return _row[a] < _row[b]; }
+        );
+
+        int left = _col[0], top = _row[0];
+        int right = left + _width[0], bottom = top + _height[0];
+        for (int k = 1; k < n; ++k)
+        {
+            left = RVN_MIN(left, _col[k]);
+            top = RVN_MIN(top, _row[k]);
+            right = RVN_MAX(right, _col[k] + _width[k]);
+            bottom = RVN_MAX(bottom, _row[k] + _height[k]);
+        }
+
+        _bounds = {left, top, right - left, bottom - top};
+
+        _luma = alloc_aligned<float>(simd_stride(_bounds.width));
+        if (_luma == nullptr)
+        {
+            set_error_msg("Failed to allocate row buffer");
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void PopulationFilter::set_origin(int col, int row)
+    {
+        const int dc = _origin_col - col;
+        const int dr = _origin_row - row;
+
+        for (int k = 0; k < size(); ++k)
+        {
+            _col[k] += dc;
+            _row[k] += dr;
+        }
+
+        _bounds.col += dc;
+        _bounds.row += dr;
+
+        _origin_col = col;
+        _origin_row = row;
+
+        printf("[POPULATION]: frames start at (%d, %d), bounds @ (%d, %d) w/in "
+            "them\n", col, row, _bounds.col, _bounds.row);
+    }
+    /* ---------------------------------------------------------------------- */
+    void PopulationFilter::allocate_buffers(int n)
+    {
+        for (int k = 0; k < n; ++k)
+        {
+            // this should only be called from a constructor so no need
+            // with wait on _qin_busy
+            _qin.push(new ActivationBuffer(size()));
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void PopulationFilter::filter(ImagePacket* packet, length_t bytes,
+        float* act)
+    {
+        const int n = size();
+
+        std::fill(_xy.begin(), _xy.end(), 0.0f);
+        std::fill(_energy.begin(), _energy.end(), 0.0f);
+        _active.clear();
+
+        // works for any pixel format, see ImagePacket
+        const uint8_t* data_in = packet->luma();
+        const int step = packet->luma_step();
+        const int row_length = packet->luma_stride();
+
+        FrameBudget::time_point t0 = FrameBudget::now();
+
+        // center-surround cells can't do w/o an integral image
+        const IntegralImage* ii = packet->integral();
+
+        // tables built upstream were timed there (see IntegralFilter)
+        const bool own_luma = ii == nullptr;
+
+        if (ii == nullptr && _has_dog)
+        {
+            _integral.build(packet, bytes);
+            ii = &_integral;
+        }
+
+        const float frame_mean = ii != nullptr ? ii->frame_mean() :
+            luma_mean(packet, bytes);
+
+        bytes = packet->luma_bytes(bytes);
+
+        if (_budget != nullptr && own_luma) { _budget->add(Stage::Luma, t0); }
+        t0 = FrameBudget::now();
+
+        // RFs that hang off the right edge of the frame are clipped to it
+        const int first_col = _bounds.col;
+        const int last_col = RVN_MIN(_bounds.col + _bounds.width,
+            packet->width());
+
+        const int last_row = _bounds.row + _bounds.height;
+
+        const int nsweep = _order.size();
+        int next = 0;
+
+        for (int k = _bounds.row; k < last_row && first_col < last_col; ++k)
+        {
+            // neurons whose RF starts on this row join the sweep...
+            while (next < nsweep && _row[_order[next]] <= k)
+            {
+                _active.push_back(_order[next++]);
+            }
+
+            // ...and those whose RF ended on the previous row leave it
+            _active.erase(std::remove_if(_active.begin(), _active.end(),
+                [this, k](int j) { return _row[j] + _height[j] <= k; }),
+                _active.end()
+            );
+
+            if (_active.empty()) { continue; }
+
+            // only the part of the row that the active RFs span is needed
+            int row_first = last_col, row_last = first_col;
+            for (size_t j = 0; j < _active.size(); ++j)
+            {
+                const int idx = _active[j];
+                row_first = RVN_MIN(row_first, _col[idx]);
+                row_last = RVN_MAX(row_last, _col[idx] + _width[idx]);
+            }
+            row_last = RVN_MIN(row_last, last_col);
+
+            if (row_first >= row_last) { continue; }
+
+            const length_t start = k * row_length + row_first * step;
+            if (start >= bytes) { break; }
+
+            // as in NeuronFilter, pixels at or past <bytes> are skipped
+            const int valid = RVN_MIN(row_last - row_first,
+                (int)((bytes - start + step - 1) / step));
+
+            // the only read of this row of the frame
+            luma_row(data_in + start, step, valid, frame_mean, _luma);
+
+            for (size_t j = 0; j < _active.size(); ++j)
+            {
+                const int idx = _active[j];
+                const int offset = _col[idx] - row_first;
+                const int len = RVN_MIN(_width[idx], valid - offset);
+
+                if (len < 1) { continue; }
+
+                const ReceptiveField* rf = _rf[idx];
+                const float* rf_row = rf->centered() +
+                    (k - _row[idx]) * rf->stride();
+
+                // the energy of the window is a lookup w/ the integral image
+                if (ii != nullptr)
+                {
+                    _xy[idx] += dot(_luma + offset, rf_row, len);
+                }
+                else
+                {
+                    dot_energy(_luma + offset, rf_row, len, _xy[idx],
+                        _energy[idx]);
+                }
+            }
+        }
+
+        for (int k = 0; k < n; ++k)
+        {
+            if (_rf[k] == nullptr)
+            {
+                const int c = _center[k];
+                const int inset = (_width[k] - c) / 2;
+
+                const CropWindow center = {_col[k] + inset, _row[k] + inset,
+                    c, c};
+                act[k] = ii->box_dog(center, {_col[k], _row[k], _width[k],
+                    _height[k]}, frame_mean);
+
+                continue;
+            }
+
+            if (ii != nullptr)
+            {
+                _energy[k] = ii->energy({_col[k], _row[k], _width[k],
+                    _height[k]}, frame_mean);
+            }
+
+            const float rf_mag = _rf[k]->mag();
+            const float mx = RVN_MAX(rf_mag, _energy[k]);
+            act[k] = _xy[k] / mx / sqrt(RVN_MIN(rf_mag, _energy[k]) / mx);
+        }
+
+        if (_budget != nullptr) { _budget->add(Stage::Neuron, t0); }
+    }
+    /* ---------------------------------------------------------------------- */
+    void PopulationFilter::process(ImagePacket* packet, length_t bytes)
+    {
+        if (is_open())
+        {
+            // wait for use of the queue, this function needs to return asap
+            // so as not to block the frame acqusition thread, so no sleep
+            while (wait_flag(_qin_busy)) {/* spin until queue is available */}
+
+            // no buffers are available, drop the frame...
+            if (_qin.size() < 1)
+            {
+                release_flag(_qin_busy);
+                return;
+            }
+
+            ActivationBuffer* ptr = pop_queue(_qin);
+            release_flag(_qin_busy);
+
+            filter(packet, bytes, ptr->data());
+            ptr->copy_timestamp(*packet);
+
+            // again, no sleep to stay quick
+            while (wait_flag(_qout_busy)) {/* spin */}
+            _qout.push(ptr);
+            release_flag(_qout_busy);
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void PopulationFilter::forward_loop()
+    {
+        const int n = size();
+
+        SpikeBatch batch;
+        batch.reserve(16 * n);
+
+        std::vector<double> time(n);
+
+        // process input when available until we receive the terminate signal
+        while (persist())
+        {
+            while (wait_flag(_qout_busy)) { sleep_ms(1); }
+
+            if (_qout.size() > 0)
+            {
+                ActivationBuffer* ptr = pop_queue(_qout);
+                release_flag(_qout_busy);
+
+                const FrameBudget::time_point t0 = FrameBudget::now();
+
+                // each neuron's response to this frame and those before it
+                float* act = ptr->data();
+                _temporal.step(ptr->timestamp(), act);
+
+                // each neuron's spikes are from when it's RF's rows were
+                // exposed (see Timestamped::row_time())
+                for (int k = 0; k < n; ++k)
+                {
+                    time[k] = ptr->row_time(_row[k] + 0.5f * (_height[k] - 1));
+                }
+
+                batch.clear();
+                batch.copy_timestamp(*ptr);
+                _spikes.generate(act, time.data(), batch);
+
+                if (!batch.empty()) { send_sink(&batch, batch.size()); }
+
+                if (_budget != nullptr) { _budget->add(Stage::Dispatch, t0); }
+
+                // reuse the packet once _qin is free
+                while (wait_flag(_qin_busy)) { sleep_ms(1); }
+                _qin.push(ptr);
+                release_flag(_qin_busy);
+            }
+            else
+            {
+                release_flag(_qout_busy);
+                sleep_ms(1);
+            }
+        }
+    }
+    /* ====================================================================== */
+}
@@ -0,0 +1,201 @@
+#ifndef RAVIE_POPULATION_FILTER_HPP_
+#define RAVIE_POPULATION_FILTER_HPP_
+
+#include <atomic>
+#include <thread>
+#include <queue>
+#include <vector>
+#include <string>
+
+#include "ravine_packets.hpp"
+#include "ravine_frame_budget.hpp"
+#include "ravine_base_filter.hpp"
+#include "ravine_integral_image.hpp"
+#include "ravine_receptive_field.hpp"
+#include "ravine_temporal_filter.hpp"
+#include "ravine_spike_generator.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // the activations of every neuron in the population for one frame
+    class ActivationBuffer : public BufferPacket<float>, public Timestamped
+    {
+    public:
+        ActivationBuffer(length_t length) :
+            BufferPacket<float>(new float[length], length) {}
+
+        ~ActivationBuffer()
+        {
+            if (this->_data != nullptr)
+            {
+                delete[] this->_data;
+            }
+        }
+    };
+    /* ====================================================================== */
+    // a population of model neurons, each w/ it's own RF, position and
+    // spike generator state. All responses are computed in a single
+    // top-to-bottom sweep of the frame: each row of luma is extracted once and
+    // then dotted w/ the matching row of every RF that covers it, so cost
+    // grows w/ the total RF area rather than (# of neurons x frame size)
+    //
+    // given the frame's IntegralImage (see IntegralFilter) the energy of each
+    // window is a lookup, leaving only the dot products to the sweep, and
+    // center-surround cells (box DoGs) cost a handful of lookups each
+    class PopulationFilter : public Filter<ImagePacket, SpikeBatch>
+    {
+    public:
+        // <pop_file> is a text file w/ one neuron per line:
+        //      <rf_file> <col> <row>
+        // where (col, row) is the top-left corner of the RF in the frame, or
+        //      dog <center> <surround> <col> <row>
+        // for a center-surround cell: a <center> px square centered in a
+        // <surround> px square w/ it's top-left corner at (col, row). A line
+        //      temporal <kernel>
+        // gives the neurons listed after it a temporal kernel (see
+        // parse_temporal_kernel()), until the next such line. Blank lines and
+        // lines that start w/ '#' are ignored
+        PopulationFilter(const char* pop_file, int nbuf);
+        ~PopulationFilter();
+
+        bool open_stream() override;
+        bool close_stream() override;
+        bool start_stream() override;
+        bool stop_stream() override;
+
+        void process(ImagePacket* packet, length_t bytes) override;
+
+        inline bool is_open() { return _open; }
+
+        inline int size() const { return _col.size(); }
+
+        // neuron <k>'s RF, and the smallest window that contains every
+        // neuron's RF, in frame coordinates (see set_origin())
+        inline CropWindow window(int k) const
+        {
+            return {_col[k] + _origin_col, _row[k] + _origin_row, _width[k],
+                _height[k]};
+        }
+
+        inline CropWindow bounds() const
+        {
+            return {_bounds.col + _origin_col, _bounds.row + _origin_row,
+                _bounds.width, _bounds.height};
+        }
+
+        // frames passed to process() are the part of the full frame that
+        // starts at (<col>, <row>), e.g. due to a hardware crop (see
+        // V4L2::crop()), the RFs stay put w/in the full frame
+        void set_origin(int col, int row);
+
+        // the source's frames changed, follow their origin
+        inline void format_changed(const StreamFormat& fmt) override
+        {
+            set_origin(fmt.crop.col, fmt.crop.row);
+        }
+
+        // how responses become spikes (see SpikeGenerator), an adaptive
+        // threshold per neuron by default, set before the stream starts
+        bool set_spike_params(const SpikeParams& params);
+
+        // time our stages against the frame interval, <budget> must outlive
+        // the stream
+        inline void set_budget(FrameBudget* budget) { _budget = budget; }
+
+        inline const std::string& get_error_msg() const { return _err_msg; }
+
+        inline bool isvalid() const { return _isvalid; }
+
+    private:
+        bool read_population_file(const char*);
+        bool add_neuron(const std::string& rf_file, int col, int row);
+        bool add_dog(int center, int surround, int col, int row);
+        void finalize();
+        void allocate_buffers(int n);
+
+        void filter(ImagePacket* packet, length_t bytes, float* act);
+
+        void forward_loop();
+
+        inline bool persist()
+        {
+            return _state_continue.test_and_set(std::memory_order_acquire);
+        }
+
+        inline void set_error_msg(const std::string& msg)
+        {
+            if (isvalid())
+            {
+                _err_msg = msg;
+                _isvalid = false;
+            }
+            else
+            {
+                _err_msg.append(" " + msg);
+            }
+        }
+
+    private:
+
+        bool _open;
+
+        bool _isvalid;
+        std::string _err_msg;
+
+        // per-neuron state, stored as structure-of-arrays: neuron k is the
+        // k'th element of each
+        //
+        // center-surround cells have no RF (nullptr), their surround is the
+        // window and _center the side of their center (0 for RF neurons)
+        std::vector<ReceptiveField*> _rf;
+        std::vector<int> _center;
+        std::vector<int> _col;
+        std::vector<int> _row;
+        std::vector<int> _width;
+        std::vector<int> _height;
+
+        // each neuron's temporal kernel and spike generator, only touched by
+        // forward_loop() once the stream starts
+        TemporalFilter _temporal;
+        SpikeGenerator _spikes;
+
+        // per-frame accumulators (only touched by the thread calling filter)
+        std::vector<float> _xy;
+        std::vector<float> _energy;
+
+        // indices of the neurons w/ an RF sorted by first row, and those
+        // that cover the row currently being swept
+        std::vector<int> _order;
+        std::vector<int> _active;
+
+        // RF positions (_col / _row) and _bounds are relative to the frames
+        // we're given, which start at (_origin_col, _origin_row)
+        CropWindow _bounds;
+        int _origin_col = 0;
+        int _origin_row = 0;
+
+        FrameBudget* _budget = nullptr;
+
+        // one row of (mean subtracted) luma spanning _bounds
+        float* _luma = nullptr;
+
+        // our own integral image, for center-surround cells when the frames
+        // come w/o one
+        bool _has_dog = false;
+        IntegralImage _integral;
+
+        std::atomic_flag _state_continue = ATOMIC_FLAG_INIT;
+
+        std::atomic_flag _qin_busy = ATOMIC_FLAG_INIT;
+        std::queue<ActivationBuffer*> _qin;
+
+        std::atomic_flag _qout_busy = ATOMIC_FLAG_INIT;
+        std::queue<ActivationBuffer*> _qout;
+
+        std::thread _process_thread;
+    };
+    /* ====================================================================== */
+}
+
+#endif
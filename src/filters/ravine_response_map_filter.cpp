@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "ravine_utils.hpp"
+#include "ravine_thread_policy.hpp"
+#include "ravine_response_map_filter.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    ResponseMapFilter::ResponseMapFilter(const char* rf_file, int width,
+        int height, int step, int nbuf, MapMethod method, float tolerance) :
+        _open(false), _isvalid(true), _width(width), _height(height),
+        _step(step), _nbuf(nbuf), _method(method)
+    {
+        if (!_rf.load(rf_file, tolerance))
+        {
+            set_error_msg("Failed to read rf file");
+            return;
+        }
+
+        // we're not yet parallel, so no need to check busy flags
+        build();
+    }
+    /* ---------------------------------------------------------------------- */
+    ResponseMapFilter::~ResponseMapFilter()
+    {
+        delete_queue(_qin);
+        delete_queue(_qout);
+
+        if (_out != nullptr) { delete _out; }
+        if (_map != nullptr) { delete _map; }
+    }
+    /* ---------------------------------------------------------------------- */
+    bool ResponseMapFilter::build()
+    {
+        _map = new CorrelationMap(_rf, _width, _height, _step, _method);
+
+        if (!_map->isvalid())
+        {
+            set_error_msg("RF does not fit w/in the frame");
+            return false;
+        }
+
+        printf("[MAP]: %d x %d RF every %d px of %d x %d -> %d x %d map (%s)\n",
+            _rf.width(), _rf.height(), _map->step(), _width, _height,
+            map_width(), map_height(), method_name(_map->method()));
+
+        if (_rf.rank() > 0)
+        {
+            printf("[MAP]: rank %d separable path est. %.1fx the speed of the "
+                "best of direct / fft at this size and step\n", _rf.rank(),
+                _map->separable_gain());
+        }
+
+        _out = new ResponseMap(map_width(), map_height());
+
+        allocate_buffers(_nbuf);
+
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    void ResponseMapFilter::format_changed(const StreamFormat& fmt)
+    {
+        if (!isvalid() || (fmt.width == _width && fmt.height == _height))
+        {
+            return;
+        }
+
+        // the map thread has to be done w/ the old map before it goes
+        const bool was_open = is_open();
+
+        if (was_open) { (void)stop_stream(); }
+        if (_process_thread.joinable()) { _process_thread.join(); }
+
+        drain();
+
+        delete_queue(_qin);
+        delete _out;
+        delete _map;
+
+        _out = nullptr;
+        _map = nullptr;
+
+        _width = fmt.width;
+        _height = fmt.height;
+
+        if (build() && was_open) { (void)start_stream(); }
+    }
+    /* ---------------------------------------------------------------------- */
+    bool ResponseMapFilter::open_stream()
+    {
+        open_sink_stream();
+        return start_stream();
+    }
+    /* ---------------------------------------------------------------------- */
+    bool ResponseMapFilter::start_stream()
+    {
+        if (!is_open() && isvalid())
+        {
+            (void)persist();
+
+            _process_thread = spawn_thread(ThreadRole::Compute, "rvn-map",
+                &ResponseMapFilter::forward_loop, this);
+            _open = true;
+        }
+        else
+        {
+            printf("[MAP]: failed starting stream\n");
+        }
+        return isvalid() && is_open();
+    }
+    /* ---------------------------------------------------------------------- */
+    bool ResponseMapFilter::stop_stream()
+    {
+        if (is_open())
+        {
+            _state_continue.clear();
+            _open = false;
+        }
+        return isvalid();
+    }
+    /* ---------------------------------------------------------------------- */
+    bool ResponseMapFilter::close_stream()
+    {
+        if (is_open()) { (void)stop_stream(); }
+
+        if (_process_thread.joinable()) { _process_thread.join(); }
+
+        drain();
+
+        close_sink_stream();
+
+        return isvalid();
+    }
+    /* ---------------------------------------------------------------------- */
+    void ResponseMapFilter::drain()
+    {
+        // hand back any frames we never got to, no one else is using the
+        // queues at this point
+        while (_qout.size() > 0)
+        {
+            MapJob* ptr = pop_queue(_qout);
+            if (ptr->frame != nullptr)
+            {
+                ptr->frame->release();
+                ptr->frame = nullptr;
+            }
+            _qin.push(ptr);
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void ResponseMapFilter::allocate_buffers(int n)
+    {
+        for (int k = 0; k < n; ++k)
+        {
+            _qin.push(new MapJob(_width, _height));
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void ResponseMapFilter::extract_luma(ImagePacket* packet,
+        length_t bytes, FloatFrame* luma)
+    {
+        const uint8_t* data_in = packet->luma();
+        const int step = packet->luma_step();
+        const int row_length = packet->luma_stride();
+        const int width = RVN_MIN(_width, packet->width());
+
+        bytes = packet->luma_bytes(bytes);
+
+        // same offset as NeuronFilter so that the map agrees w/ it
+        const float frame_mean = luma_mean(packet, bytes);
+
+        float* dst = luma->data();
+        std::fill(dst, dst + luma->length(), 0.0f);
+
+        for (int k = 0; k < _height; ++k)
+        {
+            const length_t start = k * row_length;
+            if (start >= bytes) { break; }
+
+            const int n = RVN_MIN(width,
+                (int)((bytes - start + step - 1) / step));
+            luma_row(data_in + start, step, n, frame_mean, dst + k * _width);
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void ResponseMapFilter::process(ImagePacket* packet, length_t bytes)
+    {
+        if (is_open())
+        {
+            // wait for use of the queue, this function needs to return asap
+            // so as not to block the frame acqusition thread, so no sleep
+            while (wait_flag(_qin_busy)) {/* spin until queue is available */}
+
+            // no buffers are available, drop the frame...
+            if (_qin.size() < 1)
+            {
+                release_flag(_qin_busy);
+                return;
+            }
+
+            MapJob* ptr = pop_queue(_qin);
+            release_flag(_qin_busy);
+
+            ptr->luma.copy_timestamp(*packet);
+
+            // work on the source's buffer directly if we can hold on to it,
+            // otherwise extracting the luma is the only work done here
+            if (packet->retain())
+            {
+                ptr->frame = packet;
+                ptr->bytes = bytes;
+            }
+            else
+            {
+                extract_luma(packet, bytes, &ptr->luma);
+            }
+
+            // again, no sleep to stay quick
+            while (wait_flag(_qout_busy)) {/* spin */}
+            _qout.push(ptr);
+            release_flag(_qout_busy);
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void ResponseMapFilter::forward_loop()
+    {
+        while (persist())
+        {
+            while (wait_flag(_qout_busy)) { sleep_ms(1); }
+
+            if (_qout.size() > 0)
+            {
+                MapJob* ptr = pop_queue(_qout);
+                release_flag(_qout_busy);
+
+                FrameBudget::time_point t0 = FrameBudget::now();
+
+                if (ptr->frame != nullptr)
+                {
+                    extract_luma(ptr->frame, ptr->bytes, &ptr->luma);
+
+                    if (_budget != nullptr) { _budget->add(Stage::Luma, t0); }
+                    t0 = FrameBudget::now();
+
+                    // the source can have it's buffer back
+                    ptr->frame->release();
+                    ptr->frame = nullptr;
+                }
+
+                _map->compute(ptr->luma.data(), ptr->luma.width(),
+                    _out->data());
+                _out->copy_timestamp(ptr->luma);
+
+                // map row <m> is the response to frame rows m * step through
+                // m * step + RF height - 1, so it's timing is theirs
+                const float center = 0.5f * (_rf.height() - 1);
+                _out->set_row_timing(ptr->luma.row_time(center),
+                    ptr->luma.line_time() * _map->step());
+
+                if (_budget != nullptr) { _budget->add(Stage::Neuron, t0); }
+                t0 = FrameBudget::now();
+
+                // sink gets the map synchronously (as in V4L2 -> sink)
+                send_sink(_out, _out->length());
+
+                if (_budget != nullptr) { _budget->add(Stage::Dispatch, t0); }
+
+                while (wait_flag(_qin_busy)) { sleep_ms(1); }
+                _qin.push(ptr);
+                release_flag(_qin_busy);
+            }
+            else
+            {
+                release_flag(_qout_busy);
+                sleep_ms(1);
+            }
+        }
+    }
+    /* ====================================================================== */
+}
@@ -0,0 +1,139 @@
+#ifndef RAVIE_RESPONSE_MAP_FILTER_HPP_
+#define RAVIE_RESPONSE_MAP_FILTER_HPP_
+
+#include <atomic>
+#include <thread>
+#include <queue>
+#include <string>
+
+#include "ravine_packets.hpp"
+#include "ravine_frame_budget.hpp"
+#include "ravine_frame_buffer.hpp"
+#include "ravine_base_filter.hpp"
+#include "ravine_receptive_field.hpp"
+#include "ravine_correlation_map.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // map_width() x map_height() activations, see CorrelationMap, map row
+    // <m> was exposed around row_time(m)
+    typedef FloatFrame ResponseMap;
+    /* ====================================================================== */
+    // a frame waiting for the map thread: either the source's frame itself
+    // (retain()ed, the luma is extracted by the map thread) or it's luma,
+    // already extracted on the capture thread
+    struct MapJob
+    {
+        MapJob(int width, int height) : luma(width, height) {}
+
+        FloatFrame luma;
+        ImagePacket* frame = nullptr;
+        length_t bytes = 0;
+    };
+    /* ====================================================================== */
+    // a retinotopic array of model neurons: the RF is applied at every
+    // <step>'th position of the frame, producing one ResponseMap per frame.
+    // The capture thread only queues the frame (or at worst extracts it's
+    // luma), everything else runs on the filter's own thread
+    class ResponseMapFilter : public Filter<ImagePacket, ResponseMap>
+    {
+    public:
+        // a <tolerance> > 0 lets the map use a separable approximation of
+        // the RF (see ReceptiveField::separate())
+        ResponseMapFilter(const char* rf_file, int width, int height, int step,
+            int nbuf, MapMethod method = MapMethod::Auto,
+            float tolerance = 0.0f);
+        ~ResponseMapFilter();
+
+        bool open_stream() override;
+        bool close_stream() override;
+        bool start_stream() override;
+        bool stop_stream() override;
+
+        void process(ImagePacket* packet, length_t bytes) override;
+
+        // the map (and our buffers) follow the size of the source's frames
+        void format_changed(const StreamFormat& fmt) override;
+
+        inline bool is_open() { return _open; }
+
+        inline int map_width() const { return _map->map_width(); }
+        inline int map_height() const { return _map->map_height(); }
+        inline MapMethod method() const { return _map->method(); }
+
+        // time our stages against the frame interval, <budget> must outlive
+        // the stream
+        inline void set_budget(FrameBudget* budget) { _budget = budget; }
+
+        inline const std::string& get_error_msg() const { return _err_msg; }
+
+        inline bool isvalid() const { return _isvalid; }
+
+    private:
+        // the map, output and buffers for _width x _height frames
+        bool build();
+
+        // frames still queued go back to the source, w/ the map thread
+        // stopped
+        void drain();
+
+        void allocate_buffers(int n);
+        void extract_luma(ImagePacket* packet, length_t bytes,
+            FloatFrame* luma);
+
+        void forward_loop();
+
+        inline bool persist()
+        {
+            return _state_continue.test_and_set(std::memory_order_acquire);
+        }
+
+        inline void set_error_msg(const std::string& msg)
+        {
+            if (isvalid())
+            {
+                _err_msg = msg;
+                _isvalid = false;
+            }
+            else
+            {
+                _err_msg.append(" " + msg);
+            }
+        }
+
+    private:
+
+        bool _open;
+
+        bool _isvalid;
+        std::string _err_msg;
+
+        int _width;
+        int _height;
+        int _step;
+        int _nbuf;
+        MapMethod _method;
+
+        ReceptiveField _rf;
+        CorrelationMap* _map = nullptr;
+
+        // the map we send to our sink (only touched by forward_loop)
+        ResponseMap* _out = nullptr;
+
+        FrameBudget* _budget = nullptr;
+
+        std::atomic_flag _state_continue = ATOMIC_FLAG_INIT;
+
+        std::atomic_flag _qin_busy = ATOMIC_FLAG_INIT;
+        std::queue<MapJob*> _qin;
+
+        std::atomic_flag _qout_busy = ATOMIC_FLAG_INIT;
+        std::queue<MapJob*> _qout;
+
+        std::thread _process_thread;
+    };
+    /* ====================================================================== */
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef RAVIE_SPIKE_MIXER_HPP_
+#define RAVIE_SPIKE_MIXER_HPP_
+
+#include <atomic>
+
+#include "ravine_utils.hpp"
+#include "ravine_packets.hpp"
+#include "ravine_base_filter.hpp"
+
+namespace RVN
+{
+    // a pass-through stage that lets several models (e.g. one per camera,
+    // each on it's own thread) share one sink: their batches are passed on
+    // one at a time, so the sink sees a single producer, and the sink's
+    // stream is opened w/ the first model's and closed w/ the last one's
+    class SpikeMixer : public Filter<SpikeBatch, SpikeBatch>
+    {
+    public:
+        bool open_stream() override
+        {
+            while (wait_flag(_busy)) {/* spin */}
+
+            bool success = true;
+            if (_nopen++ == 0) { success = open_sink_stream(); }
+
+            release_flag(_busy);
+            return success;
+        }
+
+        bool close_stream() override
+        {
+            while (wait_flag(_busy)) {/* spin */}
+
+            bool success = true;
+            if (_nopen > 0 && --_nopen == 0) { success = close_sink_stream(); }
+
+            release_flag(_busy);
+            return success;
+        }
+
+        bool start_stream() override { return true; }
+        bool stop_stream() override { return true; }
+
+        void process(SpikeBatch* packet, length_t bytes) override
+        {
+            // passing a batch on is quick (the sink queues it), so no sleep
+            while (wait_flag(_busy)) {/* spin */}
+            send_sink(packet, bytes);
+            release_flag(_busy);
+        }
+
+    private:
+        std::atomic_flag _busy = ATOMIC_FLAG_INIT;
+        int _nopen = 0;
+    };
+}
+
+#endif
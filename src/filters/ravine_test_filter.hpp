@@ -10,7 +10,7 @@
 
 namespace RVN
 {
-    class TestFilter : public Filter<YUYVImagePacket, YUYVImagePacket>
+    class TestFilter : public Filter<ImagePacket, ImagePacket>
     {
     public:
         bool open_stream() override { return _sink->open_stream(); }
@@ -19,7 +19,7 @@ namespace RVN
         bool start_stream() override { return true; }
         bool stop_stream() override { return true; }
 
-        inline void process(YUYVImagePacket* packet, length_t bytes)
+        inline void process(ImagePacket* packet, length_t bytes)
         {
             printf("    [INFO]: re-forwarding buffer...\n");
             send_sink(packet, bytes);
@@ -12,42 +12,39 @@ namespace RVN
             delete[] _data;
         }
     }
-    /* ====================================================================== */
-    void FullFrameBuffer::set_data(YUYVImagePacket* packet, length_t bytes)
+    /* ---------------------------------------------------------------------- */
+    void FrameBuffer::fill()
     {
-        const int32_t end = RVN_MIN(this->length()*2, bytes);
-
-        // copy from input packet to internal storage
-        const uint8_t* data_in = packet->data();
-        uint8_t* data = this->data();
-
-        int32_t inc = 0;
-
-        // +=2 for YUYV encoding
-        for (int32_t k = 0; k < end; k += 2, ++inc)
+        if (_src != nullptr)
         {
-            data[inc] = data_in[k];
+            set_data(_src, _src_bytes);
+            _src->release();
+            _src = nullptr;
         }
     }
     /* ====================================================================== */
-    void CroppedFrameBuffer::set_data(YUYVImagePacket* packet, length_t bytes)
+    // copy the luma of <packet> w/in <win> to <data>, skipping any pixel at
+    // or past <bytes>
+    static void copy_luma(ImagePacket* packet, length_t bytes,
+        const CropWindow& win, uint8_t* data)
     {
         int32_t inc = 0;
 
-        // in YUYV, every other element is luminance channel
-        const int row_length = packet->width() * 2;
+        // works for any pixel format, see ImagePacket
+        const uint8_t* data_in = packet->luma();
+        const int step = packet->luma_step();
+        const int row_length = packet->luma_stride();
 
-        const uint8_t* data_in = packet->data();
-        uint8_t* data = this->data();
+        bytes = packet->luma_bytes(bytes);
 
-        int first_col = _win->col * 2;
-        int last_col = first_col + (_win->width*2);
+        const int first_col = win.col * step;
+        const int last_col = first_col + (win.width * step);
 
-        int last_row = _win->row + _win->height;
+        const int last_row = win.row + win.height;
 
-        for (int k = _win->row; k < last_row; ++k)
+        for (int k = win.row; k < last_row; ++k)
         {
-            for (int j = first_col; j < last_col; j+=2, ++inc)
+            for (int j = first_col; j < last_col; j += step, ++inc)
             {
                 int32_t idx = k * row_length + j;
                 if (idx < bytes)
@@ -58,5 +55,16 @@ namespace RVN
         }
     }
     /* ====================================================================== */
+    void FullFrameBuffer::set_data(ImagePacket* packet, length_t bytes)
+    {
+        const CropWindow win = {0, 0, _width, _height};
+        copy_luma(packet, bytes, win, this->data());
+    }
+    /* ====================================================================== */
+    void CroppedFrameBuffer::set_data(ImagePacket* packet, length_t bytes)
+    {
+        copy_luma(packet, bytes, *_win, this->data());
+    }
+    /* ====================================================================== */
 }
 
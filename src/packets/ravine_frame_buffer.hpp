@@ -4,6 +4,7 @@
 #include <new>
 #include <queue>
 
+#include "ravine_simd.hpp"
 #include "ravine_packets.hpp"
 
 namespace RVN
@@ -16,9 +17,24 @@ namespace RVN
             BufferPacket<uint8_t>(new uint8_t[length], length) {}
         virtual ~FrameBuffer();
 
-        virtual void set_data(YUYVImagePacket* packet, length_t bytes) = 0;
+        virtual void set_data(ImagePacket* packet, length_t bytes) = 0;
         virtual int width() const { return 0; };
         virtual int height() const { return 0; };
+
+        // keep a reference to <packet> (which the caller has retain()ed) and
+        // defer the copy to fill(), so it can happen off the capture thread
+        inline void hold(ImagePacket* packet, length_t bytes)
+        {
+            _src = packet;
+            _src_bytes = bytes;
+        }
+
+        // copy from the held packet (if any) and release it
+        void fill();
+
+    private:
+        ImagePacket* _src = nullptr;
+        length_t _src_bytes = 0;
     };
     /* ====================================================================== */
     class FullFrameBuffer : public FrameBuffer
@@ -27,7 +43,7 @@ namespace RVN
         FullFrameBuffer(int width, int height) :
             FrameBuffer(width*height), _width(width), _height(height) {}
 
-        void set_data(YUYVImagePacket* packet, length_t bytes) override;
+        void set_data(ImagePacket* packet, length_t bytes) override;
 
         inline int width() const override { return _width; }
         inline int height() const override { return _height; }
@@ -43,7 +59,7 @@ namespace RVN
         CroppedFrameBuffer(CropWindow* win) :
             FrameBuffer(win->length()), _win(win) {}
 
-        void set_data(YUYVImagePacket*packet, length_t bytes) override;
+        void set_data(ImagePacket*packet, length_t bytes) override;
 
         inline int width() const override { return _win->width; }
         inline int height() const override { return _win->height; }
@@ -52,5 +68,22 @@ namespace RVN
         CropWindow* _win;
     };
     /* ====================================================================== */
+    // an (aligned) width x height frame of floats that manages it's own
+    // memory, e.g. a frame's luma ready for filtering or a response map
+    class FloatFrame : public FramePacket<float>
+    {
+    public:
+        FloatFrame(int width, int height) :
+            FramePacket<float>(alloc_aligned<float>(width*height),
+                width*height, width), _height(height) {}
+
+        ~FloatFrame() { free_aligned(this->_data); }
+
+        inline int height() const { return _height; }
+
+    private:
+        int _height;
+    };
+    /* ====================================================================== */
 }
 #endif
@@ -7,6 +7,24 @@ namespace RVN
     template class FramePacket<uint8_t>;
     template class ScalarPacket<float>;
 
+    /* ====================================================================== */
+    bool format_from_name(const char* name, PixelFormat& fmt)
+    {
+        const PixelFormat all[] = {PixelFormat::Auto, PixelFormat::YUYV,
+            PixelFormat::GREY, PixelFormat::NV12, PixelFormat::YU12,
+            PixelFormat::MJPEG};
+
+        for (PixelFormat f : all)
+        {
+            if (strcmp(name, format_name(f)) == 0)
+            {
+                fmt = f;
+                return true;
+            }
+        }
+        return false;
+    }
+
     /* ====================================================================== */
     // void AudioPacket::copy_from(const AudioPacket& other) :
     // {
@@ -1,6 +1,8 @@
 #ifndef RAVINE_PACKETS_HPP_
 #define RAVINE_PACKETS_HPP_
 
+#include <vector>
+
 #include <cinttypes>
 #include "ravine_base_packet.hpp"
 
@@ -10,6 +12,8 @@
 namespace RVN
 {
     typedef int32_t length_t;
+
+    class IntegralImage;
     /* ====================================================================== */
     struct CropWindow
     {
@@ -23,6 +27,52 @@ namespace RVN
         int height;
     };
     /* ====================================================================== */
+    // when (in the Clock time base, seconds) the frame that a packet came from
+    // was captured, and it's sequence number as counted by the driver
+    class Timestamped
+    {
+    public:
+        inline double timestamp() const { return _time; }
+        inline uint32_t sequence() const { return _sequence; }
+
+        // a rolling shutter exposes (and reads out) the frame a row at a
+        // time: row <row> of the frame was exposed around row_time(row),
+        // which is just timestamp() unless the source set the row timing
+        inline double row_time(float row) const
+        {
+            return _row0 + row * _line_time;
+        }
+        inline float line_time() const { return _line_time; }
+
+        inline void set_timestamp(double time, uint32_t sequence)
+        {
+            _time = time;
+            _sequence = sequence;
+            _row0 = time;
+            _line_time = 0.0f;
+        }
+
+        // the mid-exposure time of the frame's first row and the time (s)
+        // b/t the rows, set after set_timestamp()
+        inline void set_row_timing(double row0, float line_time)
+        {
+            _row0 = row0;
+            _line_time = line_time;
+        }
+
+        inline void copy_timestamp(const Timestamped& other)
+        {
+            set_timestamp(other.timestamp(), other.sequence());
+            set_row_timing(other._row0, other.line_time());
+        }
+
+    protected:
+        double _time = -1.0;
+        uint32_t _sequence = 0;
+        double _row0 = -1.0;
+        float _line_time = 0.0f;
+    };
+    /* ====================================================================== */
     template <class T>
     class BufferPacket : public Packet<T*>
     {
@@ -37,17 +87,119 @@ namespace RVN
     };
     /* ====================================================================== */
     template <class T>
-    class FramePacket : public BufferPacket<T>
+    class FramePacket : public BufferPacket<T>, public Timestamped
     {
     public:
         FramePacket(T* data, length_t length, int width) : BufferPacket<T>(data, length), _width(width) {}
         FramePacket() : _width(0) {}
         inline int width() const { return _width; }
+
+        // a sink that needs the frame's data after process() returns calls
+        // retain(), if that returns true the data stays valid (and untouched
+        // by the source) until the matching release(). Frames that can't be
+        // held return false and must be copied (or used) w/in process()
+        virtual bool retain() { return false; }
+        virtual void release() {}
     protected:
         int _width;
     };
     /* ====================================================================== */
-    typedef FramePacket<uint8_t> YUYVImagePacket;
+    // Auto is only meaningful when asking a source for a format
+    enum class PixelFormat { Auto, YUYV, GREY, NV12, YU12, MJPEG };
+
+    inline const char* format_name(PixelFormat fmt)
+    {
+        switch (fmt)
+        {
+            case PixelFormat::YUYV: return "yuyv";
+            case PixelFormat::GREY: return "grey";
+            case PixelFormat::NV12: return "nv12";
+            case PixelFormat::YU12: return "yu12";
+            case PixelFormat::MJPEG: return "mjpeg";
+            default: return "auto";
+        }
+    }
+
+    // returns false if <name> isn't one of the names format_name() gives
+    bool format_from_name(const char* name, PixelFormat& fmt);
+    /* ====================================================================== */
+    // what a source's frames look like: <crop> is the part of the full frame
+    // they cover (width x height, starting at (crop.col, crop.row)), see
+    // Sink::format_changed()
+    struct StreamFormat
+    {
+        PixelFormat format;
+        int width;
+        int height;
+        int stride;
+        CropWindow crop;
+        float fps;
+    };
+    /* ====================================================================== */
+    // a camera frame in any of the supported pixel formats, consumers should
+    // only ever touch the luma (Y) plane through luma(): luma_step() bytes
+    // between samples and luma_stride() bytes between rows, so that:
+    //      Y(col, row) = luma()[row * luma_stride() + col * luma_step()]
+    // for YUYV the luma is interleaved w/ the chroma (step 2), for GREY and
+    // the planar formats (NV12 / YU12) the Y plane is packed (step 1) and
+    // comes first. MJPEG frames have no accessible luma (see V4L2)
+    class ImagePacket : public FramePacket<uint8_t>
+    {
+    public:
+        ImagePacket() : _format(PixelFormat::YUYV), _height(0), _stride(0) {}
+
+        ImagePacket(uint8_t* data, length_t length, int width,
+            PixelFormat format = PixelFormat::YUYV, int height = 0,
+            int stride = 0) : FramePacket<uint8_t>(data, length, width)
+        {
+            set_format(format, width, height, stride);
+        }
+
+        // a <stride> of 0 means rows are packed, a <height> of 0 means as
+        // many rows as fit in length()
+        inline void set_format(PixelFormat format, int width, int height,
+            int stride = 0)
+        {
+            _format = format;
+            _width = width;
+
+            _stride = stride > 0 ? stride : width * luma_step();
+            _height = height > 0 ? height :
+                (_stride > 0 ? this->_length / _stride : 0);
+        }
+
+        inline PixelFormat format() const { return _format; }
+        inline int height() const { return _height; }
+
+        inline const uint8_t* luma() const { return this->_data; }
+        inline int luma_step() const
+        {
+            return _format == PixelFormat::YUYV ? 2 : 1;
+        }
+        inline int luma_stride() const { return _stride; }
+
+        // how many of the <bytes> (used) bytes in the frame are luma, or
+        // interleaved luma for YUYV
+        inline length_t luma_bytes(length_t bytes) const
+        {
+            if (_format == PixelFormat::YUYV) { return bytes; }
+
+            const length_t plane = ((length_t)_stride) * _height;
+            return RVN_MIN(bytes, plane);
+        }
+
+        // the frame's integral image, if a stage upstream built one (see
+        // IntegralFilter), only valid w/in the process() call it came w/
+        inline const IntegralImage* integral() const { return _integral; }
+        inline void set_integral(const IntegralImage* ii) { _integral = ii; }
+
+    protected:
+        PixelFormat _format;
+        int _height;
+        int _stride;
+
+        const IntegralImage* _integral = nullptr;
+    };
     /* ====================================================================== */
     template <class T>
     class ScalarPacket : public Packet<T>
@@ -60,31 +212,73 @@ namespace RVN
     typedef ScalarPacket<float> FloatPacket;
     typedef Packet<bool> BoolPacket;
     /* ====================================================================== */
+    // a model neuron's response to one frame
+    class ActivationPacket : public ScalarPacket<float>, public Timestamped
+    {
+    public:
+        ActivationPacket() { this->_data = 0.0f; }
+    };
+    /* ====================================================================== */
     class EventPacket : public Packet<uint8_t>
     {
     public:
-        EventPacket() : Packet<uint8_t>(0x00), _time(-1.0f) {}
-        EventPacket(uint8_t d, float time) : Packet<uint8_t>(d), _time(time) {}
+        EventPacket() : Packet<uint8_t>(0x00), _time(-1.0) {}
+        EventPacket(uint8_t d, double time) : Packet<uint8_t>(d), _time(time) {}
 
         inline void operator=(const EventPacket* other)
         {
             this->_data = other->data();
             _time = other->timestamp();
         }
-        inline float timestamp() const { return _time; }
+        inline double timestamp() const { return _time; }
+    protected:
+        double _time;
+    };
+    /* ====================================================================== */
+    // a spike emitted by model neuron <neuron> (always 0 for a NeuronFilter,
+    // the neuron's index w/in the population for a PopulationFilter) at
+    // <time> (Clock time base, s)
+    struct Spike
+    {
+        double time;
+        int32_t neuron;
+    };
+    /* ====================================================================== */
+    // the spikes of every model neuron since the frame before, in time order
+    // (see SpikeGenerator), stamped w/ the capture time of the frame that
+    // caused them. The spikes belong to the sender and are only valid until
+    // process() returns
+    class SpikeBatch : public Timestamped
+    {
+    public:
+        inline int size() const { return _spikes.size(); }
+        inline bool empty() const { return _spikes.empty(); }
+
+        inline const Spike* data() const { return _spikes.data(); }
+        inline Spike* data() { return _spikes.data(); }
+
+        inline const Spike& operator[](int k) const { return _spikes[k]; }
+
+        inline void clear() { _spikes.clear(); }
+        inline void reserve(int n) { _spikes.reserve(n); }
+
+        inline void push(double time, int neuron)
+        {
+            _spikes.push_back({time, neuron});
+        }
     protected:
-        float _time;
+        std::vector<Spike> _spikes;
     };
     /* ====================================================================== */
     class AudioPacket : public BufferPacket<float>
     {
     public:
-        AudioPacket(float* data, length_t length, float time) :
+        AudioPacket(float* data, length_t length, double time) :
             BufferPacket<float>(data, length), _time(time) {}
         virtual ~AudioPacket() {}
-        inline float timestamp() const { return _time; }
+        inline double timestamp() const { return _time; }
     protected:
-        float _time;
+        double _time;
     };
     /* ====================================================================== */
 }
@@ -14,6 +14,11 @@ namespace RVN
         virtual bool close_stream() = 0;
         virtual void process(PacketType*, length_t) = 0;
 
+        // called by the source before the first frame, and whenever the
+        // frames it sends change (size, format, crop or rate). The source
+        // is not delivering, and no earlier frame is held, while it runs
+        virtual void format_changed(const StreamFormat&) {}
+
         //inline bool isopen() const { return _isopen; }
     //protected:
         //bool _isopen;
@@ -1,6 +1,7 @@
 #include <cstdio>
 
 #include "ravine_utils.hpp"
+#include "ravine_thread_policy.hpp"
 #include "ravine_datafile_sink.hpp"
 
 namespace RVN
@@ -35,7 +36,8 @@ namespace RVN
             // indicate that we should continue streaming to file...
             (void)persist();
 
-            _write_thread = std::thread(&DataFileSink::write_loop, this);
+            _write_thread = spawn_thread(ThreadRole::IO, "rvn-datafile",
+                &DataFileSink::write_loop, this);
             this->_isopen = true;
         }
         return isvalid();
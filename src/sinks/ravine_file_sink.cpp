@@ -5,22 +5,26 @@
 #include <queue>
 
 #include <cinttypes>
+#include <cstdio>
 
 #include "ravine_utils.hpp"
+#include "ravine_thread_policy.hpp"
 #include "ravine_frame_buffer.hpp"
 #include "ravine_file_sink.hpp"
 
 namespace RVN
 {
     /* ====================================================================== */
-    FileSink::FileSink(const CropWindow& win, int nbuff) : _win(win)
+    FileSink::FileSink(const CropWindow& win, int nbuff) :
+        _win(win), _frame_win(win), _follow(false)
     {
         init(nbuff);
     }
     /* ---------------------------------------------------------------------- */
-    FileSink::FileSink(int width, int height, int nbuff)
+    FileSink::FileSink(int width, int height, int nbuff) : _follow(true)
     {
         _win = {0, 0, width, height};
+        _frame_win = _win;
         init(nbuff);
     }
     /* ---------------------------------------------------------------------- */
@@ -38,6 +42,7 @@ namespace RVN
     void FileSink::init(int nbuff)
     {
         _state_continue.test_and_set();
+        _nbuf = nbuff;
         allocate_buffers(nbuff);
         _open = false;
         _frame = 0;
@@ -49,7 +54,8 @@ namespace RVN
 
         if (!is_open())
         {
-            _write_thread = std::thread(&FileSink::write_loop, this);
+            _write_thread = spawn_thread(ThreadRole::IO, "rvn-frames",
+                &FileSink::write_loop, this);
             _open = true;
         }
         return true;
@@ -67,7 +73,7 @@ namespace RVN
         return true;
     }
     /* ---------------------------------------------------------------------- */
-    void FileSink::process(YUYVImagePacket* packet, length_t bytes)
+    void FileSink::process(ImagePacket* packet, length_t bytes)
     {
         if (is_open())
         {
@@ -76,13 +82,25 @@ namespace RVN
             while (wait_flag(_qin_busy)) {/* spin until queue is available */}
 
             // no buffers are available, drop the frame...
-            if (_qin.size() < 1) { return; }
+            if (_qin.size() < 1)
+            {
+                release_flag(_qin_busy);
+                return;
+            }
 
             FrameBuffer* ptr = pop_queue(_qin);
             release_flag(_qin_busy);
 
-            // copy data, no alloc / free
-            ptr->set_data(packet, bytes);
+            // hold on to the source's buffer and copy it on the write thread
+            // if we can, otherwise copy data now (no alloc / free either way)
+            if (packet->retain())
+            {
+                ptr->hold(packet, bytes);
+            }
+            else
+            {
+                ptr->set_data(packet, bytes);
+            }
 
             // again, no sleep to stay quick
             while (wait_flag(_qout_busy)) {/* spin */}
@@ -91,6 +109,56 @@ namespace RVN
         }
     }
     /* ---------------------------------------------------------------------- */
+    void FileSink::format_changed(const StreamFormat& fmt)
+    {
+        CropWindow win;
+
+        if (_follow)
+        {
+            win = {0, 0, fmt.width, fmt.height};
+        }
+        else
+        {
+            // our window stays put w/in the full frame, clipped to the part
+            // of it that we get
+            const int left = RVN_MAX(_frame_win.col - fmt.crop.col, 0);
+            const int top = RVN_MAX(_frame_win.row - fmt.crop.row, 0);
+            const int right = RVN_MIN(_frame_win.col + _frame_win.width -
+                fmt.crop.col, fmt.width);
+            const int bottom = RVN_MIN(_frame_win.row + _frame_win.height -
+                fmt.crop.row, fmt.height);
+
+            win = {left, top, RVN_MAX(right - left, 0),
+                RVN_MAX(bottom - top, 0)};
+        }
+
+        if (win.col == _win.col && win.row == _win.row &&
+            win.width == _win.width && win.height == _win.height)
+        {
+            return;
+        }
+
+        // the source isn't delivering, so once the write thread hands back
+        // every buffer no one is using them
+        while (true)
+        {
+            while (wait_flag(_qin_busy)) { sleep_ms(1); }
+            if (_qin.size() >= (size_t)_nbuf) { break; }
+            release_flag(_qin_busy);
+            sleep_ms(1);
+        }
+
+        delete_queue(_qin);
+
+        _win = win;
+        allocate_buffers(_nbuf);
+
+        release_flag(_qin_busy);
+
+        printf("[FILE]: writing %d x %d @ (%d, %d) of each frame\n",
+            _win.width, _win.height, _win.col, _win.row);
+    }
+    /* ---------------------------------------------------------------------- */
     void FileSink::allocate_buffers(int n)
     {
         bool full = _win.col == 0 && _win.row == 0;
@@ -107,8 +175,8 @@ namespace RVN
                 ptr = new CroppedFrameBuffer(&_win);
             }
 
-            // this should only be called from a constructor so no need
-            // with wait on _qin_busy
+            // only called from a constructor or w/ _qin_busy held (see
+            // format_changed())
             _qin.push(ptr);
         }
     }
@@ -124,6 +192,8 @@ namespace RVN
     /* ---------------------------------------------------------------------- */
     void FileSink::write_file(FrameBuffer* buf)
     {
+        buf->fill();
+
         if (next_file())
         {
             _file << "P5" << std::endl << buf->width() << " " << buf->height() << std::endl << "255" << std::endl;
@@ -14,7 +14,10 @@
 
 namespace RVN
 {
-    class FileSink : public Sink<YUYVImagePacket>
+    // writes the luma of every frame it gets to ./frames as a PGM: either
+    // the whole frame (w/ the (width, height) constructor, following the
+    // source's frame size) or the window <win> of the full frame
+    class FileSink : public Sink<ImagePacket>
     {
     public:
         FileSink(const CropWindow& win, int nbuf);
@@ -23,7 +26,10 @@ namespace RVN
 
         bool open_stream() override;
         bool close_stream() override;
-        void process(YUYVImagePacket* packet, length_t bytes) override;
+        void process(ImagePacket* packet, length_t bytes) override;
+
+        // re-size our buffers for the source's new frames
+        void format_changed(const StreamFormat& fmt) override;
 
         inline bool is_open() { return _open; }
 
@@ -46,7 +52,12 @@ namespace RVN
 
         std::atomic_flag _state_continue = ATOMIC_FLAG_INIT;
 
+        // the window w/in the frames we get, and as asked for (in full
+        // frame coordinates) unless we follow the frame size
         CropWindow _win;
+        CropWindow _frame_win;
+        bool _follow;
+        int _nbuf;
 
         std::atomic_flag _qout_busy = ATOMIC_FLAG_INIT;
         std::queue<FrameBuffer*> _qout;
@@ -52,6 +52,11 @@ namespace RVN
             return true;
         }
 
+        inline void notify_sink_format(const StreamFormat& fmt)
+        {
+            if (has_valid_sink()) { _sink->format_changed(fmt); }
+        }
+
     protected:
         Sink<PacketType>* _sink = nullptr;
     };
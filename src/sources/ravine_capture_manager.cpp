@@ -0,0 +1,247 @@
+#include <cstdio>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include "ravine_clock.hpp"
+#include "ravine_thread_policy.hpp"
+#include "ravine_capture_manager.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    CaptureManager::~CaptureManager()
+    {
+        close_events();
+    }
+    /* ---------------------------------------------------------------------- */
+    int CaptureManager::add_camera(V4L2* camera)
+    {
+        _cameras.push_back(camera);
+        _capturing.push_back(false);
+        return _cameras.size() - 1;
+    }
+    /* ---------------------------------------------------------------------- */
+    bool CaptureManager::start_stream()
+    {
+        if (!isvalid()) { return false; }
+
+        if (_cameras.empty())
+        {
+            set_error_msg("No cameras to capture from");
+            return false;
+        }
+
+        if (!init_events())
+        {
+            set_error_msg("Failed to set up epoll");
+            return false;
+        }
+
+        for (size_t k = 0; k < _cameras.size(); ++k)
+        {
+            if (!_cameras[k]->begin_capture())
+            {
+                set_error_msg("Failed to start " + _cameras[k]->device() +
+                    ": " + _cameras[k]->get_error_msg());
+                break;
+            }
+            _capturing[k] = true;
+        }
+
+        if (isvalid())
+        {
+            printf("[CAPTURE]: launching stream for %d cameras\n",
+                camera_count());
+
+            // see V4L2::start_stream()
+            persist();
+
+            _stream_thread = spawn_thread(ThreadRole::Capture,
+                "rvn-capture", &CaptureManager::stream, this);
+        }
+
+        return isvalid();
+    }
+    /* ---------------------------------------------------------------------- */
+    void CaptureManager::stream()
+    {
+        const int ncam = camera_count();
+
+        // at most one event per fd
+        std::vector<epoll_event> events(ncam + 1);
+
+        timespec t1, t2;
+
+        // one clock (and so one time base) for every camera's frames
+        Clock clock;
+
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        std::string err_msg;
+
+        while (persist())
+        {
+            int n = epoll_wait(_epoll_fd, events.data(), events.size(), -1);
+
+            if (n < 0)
+            {
+                if (errno != EINTR)
+                {
+                    set_error_msg("Error occured in epoll_wait!");
+                    break;
+                }
+                continue;
+            }
+
+            timespec t_ready;
+            clock_gettime(CLOCK_MONOTONIC, &t_ready);
+
+            for (int k = 0; k < n; ++k)
+            {
+                const int idx = events[k].data.u32;
+
+                if (idx >= ncam)
+                {
+                    // stop_stream() cleared the flag, so the loop ends, but
+                    // drain the counter anyway
+                    uint64_t val;
+                    ssize_t r = read(_stop_fd, &val, sizeof(val));
+                    (void)r;
+                }
+                else if (events[k].events & EPOLLERR)
+                {
+                    drop_camera(idx, "Device reported an error");
+                }
+                else if (events[k].events & EPOLLIN)
+                {
+                    if (!_cameras[idx]->dequeue(clock, t_ready, err_msg))
+                    {
+                        drop_camera(idx, err_msg);
+                    }
+                }
+            }
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+
+        _duration = (float)(t2.tv_sec - t1.tv_sec) +
+            (float)(t2.tv_nsec - t1.tv_nsec) * 1e-9f;
+    }
+    /* ---------------------------------------------------------------------- */
+    void CaptureManager::drop_camera(int k, const std::string& msg)
+    {
+        printf("[CAPTURE]: %s failed: %s\n", _cameras[k]->device().c_str(),
+            msg.c_str());
+
+        _cameras[k]->set_error_msg(msg);
+
+        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, _cameras[k]->get_fd(), nullptr);
+    }
+    /* ---------------------------------------------------------------------- */
+    bool CaptureManager::stop_stream()
+    {
+        send_stop();
+
+        if (_stop_fd >= 0)
+        {
+            uint64_t one = 1;
+            ssize_t r = write(_stop_fd, &one, sizeof(one));
+            (void)r;
+        }
+
+        if (_stream_thread.joinable()) { _stream_thread.join(); }
+
+        close_events();
+
+        bool ok = isvalid();
+
+        for (size_t k = 0; k < _cameras.size(); ++k)
+        {
+            if (!_capturing[k]) { continue; }
+
+            V4L2* cam = _cameras[k];
+
+            // report before end_capture(), as that can fail too
+            const bool failed = !cam->isvalid();
+
+            _capturing[k] = !cam->end_capture();
+
+            ok = ok && cam->isvalid();
+
+            if (failed) { continue; }
+
+            const RunningStats& lat = cam->dqbuf_latency();
+
+            printf("[CAPTURE]: %s: %u frames (%.1f fps), %u dropped, starved "
+                "%u times, ready -> DQBUF %.3f ms (max %.3f), frame age %.3f "
+                "ms (max %.3f)\n", cam->device().c_str(), cam->frame_count(),
+                _duration > 0.0f ? cam->frame_count() / _duration : 0.0f,
+                cam->dropped_frames(), cam->starvation_count(), lat.mean(),
+                lat.max(), cam->frame_age_stats().mean(),
+                cam->frame_age_stats().max());
+        }
+
+        printf("[CAPTURE]: %d cameras, %.1f fps total over %.2f s\n",
+            camera_count(), aggregate_fps(), _duration);
+
+        return ok;
+    }
+    /* ---------------------------------------------------------------------- */
+    float CaptureManager::aggregate_fps() const
+    {
+        if (_duration <= 0.0f) { return 0.0f; }
+
+        uint32_t frames = 0;
+        for (size_t k = 0; k < _cameras.size(); ++k)
+        {
+            frames += _cameras[k]->frame_count();
+        }
+
+        return frames / _duration;
+    }
+    /* ---------------------------------------------------------------------- */
+    bool CaptureManager::init_events()
+    {
+        close_events();
+
+        _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        _stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (_epoll_fd < 0 || _stop_fd < 0) { return false; }
+
+        // events carry the camera's index, the stop fd comes after the last
+        epoll_event ev = {};
+
+        for (size_t k = 0; k < _cameras.size(); ++k)
+        {
+            ev.events = EPOLLIN;
+            ev.data.u32 = k;
+
+            if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _cameras[k]->get_fd(),
+                &ev) < 0)
+            {
+                return false;
+            }
+        }
+
+        ev.events = EPOLLIN;
+        ev.data.u32 = _cameras.size();
+
+        return epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _stop_fd, &ev) == 0;
+    }
+    /* ---------------------------------------------------------------------- */
+    void CaptureManager::close_events()
+    {
+        if (_epoll_fd >= 0) { close(_epoll_fd); }
+        if (_stop_fd >= 0) { close(_stop_fd); }
+
+        _epoll_fd = -1;
+        _stop_fd = -1;
+    }
+    /* ====================================================================== */
+}
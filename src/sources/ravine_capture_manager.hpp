@@ -0,0 +1,95 @@
+#ifndef RAVINE_CAPTURE_MANAGER_HPP_
+#define RAVINE_CAPTURE_MANAGER_HPP_
+
+#include <string>
+#include <vector>
+
+#include <atomic>
+#include <thread>
+
+#include "ravine_video_source.hpp"
+
+namespace RVN
+{
+    /* =======================================================================*/
+    // captures from several cameras on a single thread: every device (and an
+    // eventfd to stop) is watched by one epoll set, each frame is dequeued and
+    // passed to it's camera's own sink (i.e. pipeline) as soon as it's ready,
+    // and all frames are stamped w/ the one Clock
+    class CaptureManager
+    {
+    public:
+        CaptureManager() : _isvalid(true) {}
+        ~CaptureManager();
+
+        // <camera> must be open, w/ it's buffers initialized and it's sink
+        // registered, and must not be started on it's own. It is not owned
+        // by the manager. Returns the camera's index
+        int add_camera(V4L2* camera);
+
+        bool start_stream();
+
+        // stops every camera, returns false if the manager or any camera
+        // failed while streaming (see get_error_msg() / the camera's own)
+        bool stop_stream();
+
+        inline int camera_count() const { return _cameras.size(); }
+        inline V4L2* camera(int k) { return _cameras[k]; }
+
+        inline const std::string& get_error_msg() const { return _err_msg; }
+        inline bool isvalid() const { return _isvalid; }
+
+        // seconds spent streaming, and frames per second summed over every
+        // camera, only valid once the stream has stopped
+        inline float duration() const { return _duration; }
+        float aggregate_fps() const;
+
+    private:
+        bool init_events();
+        void close_events();
+
+        void stream();
+
+        // stop watching a camera that failed, the others carry on
+        void drop_camera(int k, const std::string& msg);
+
+        inline void set_error_msg(const std::string& msg)
+        {
+            if (isvalid())
+            {
+                _err_msg = msg;
+                _isvalid = false;
+            }
+            else
+            {
+                _err_msg.append(" " + msg);
+            }
+        }
+
+        inline bool persist()
+        {
+            return _state_continue.test_and_set(std::memory_order_acquire);
+        }
+
+        inline void send_stop() { _state_continue.clear(); }
+
+    private:
+        std::vector<V4L2*> _cameras;
+
+        // cameras that are streaming, for stop_stream() to shut down
+        std::vector<bool> _capturing;
+
+        bool _isvalid;
+        std::string _err_msg;
+
+        int _epoll_fd = -1;
+        int _stop_fd = -1;
+
+        float _duration = 0.0f;
+
+        std::atomic_flag _state_continue = ATOMIC_FLAG_INIT;
+        std::thread _stream_thread;
+    };
+    /* =======================================================================*/
+}
+#endif
@@ -1,4 +1,5 @@
 #include <iostream>
+#include "ravine_thread_policy.hpp"
 #include "ravine_event_source.hpp"
 
 namespace RVN
@@ -13,7 +14,8 @@ namespace RVN
 
         // launch our io_context thread: this just call io_context::run() in
         // a seperate thread to allow control to return to the caller
-        _io_thread = std::thread(&EventSource::io_loop, this);
+        _io_thread = spawn_thread(ThreadRole::IO, "rvn-events",
+            &EventSource::io_loop, this);
 
         return true;
     }
@@ -41,7 +43,7 @@ namespace RVN
     /* ---------------------------------------------------------------------- */
     void EventSource::handle_read(const asio::error_code& ec, uint32_t bytes)
     {
-        const float time = _clock.now();
+        const double time = _clock.now();
 
         if (!ec)
         {
@@ -0,0 +1,323 @@
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+
+#include <linux/videodev2.h>
+
+#include "ravine_utils.hpp"
+#include "ravine_frame_budget.hpp"
+#include "ravine_thread_policy.hpp"
+#include "ravine_video_source.hpp"
+#include "ravine_exposure_control.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    uint32_t luma_histogram(const ImagePacket& packet, length_t bytes,
+        int grid, uint32_t* hist)
+    {
+        // increments of one table stall on each other when neighboring
+        // samples land in the same bin (the usual case for luma), so spread
+        // them over four and sum at the end
+        uint32_t tab[4][256] = {};
+
+        const uint8_t* luma = packet.luma();
+        const int step = packet.luma_step() * grid;
+        const int stride = packet.luma_stride();
+        const int first = grid / 2;
+
+        bytes = packet.luma_bytes(bytes);
+
+        // only whole rows
+        int rows = stride > 0 ? bytes / stride : 0;
+        if (packet.height() > 0) { rows = RVN_MIN(rows, packet.height()); }
+
+        // samples per row
+        const int n = packet.width() > first ?
+            (packet.width() - first + grid - 1) / grid : 0;
+
+        for (int r = first; r < rows; r += grid)
+        {
+            const uint8_t* p = luma + r * stride + first * packet.luma_step();
+
+            int k = 0;
+            for (; k + 4 <= n; k += 4, p += 4 * step)
+            {
+                ++tab[0][p[0]];
+                ++tab[1][p[step]];
+                ++tab[2][p[2 * step]];
+                ++tab[3][p[3 * step]];
+            }
+            for (; k < n; ++k, p += step)
+            {
+                ++tab[0][p[0]];
+            }
+        }
+
+        uint32_t total = 0;
+        for (int b = 0; b < 256; ++b)
+        {
+            hist[b] = tab[0][b] + tab[1][b] + tab[2][b] + tab[3][b];
+            total += hist[b];
+        }
+
+        return total;
+    }
+    /* ====================================================================== */
+    ExposureControl::ExposureControl(float target, int grid, int interval) :
+        _target(target * 255.0f),
+        _grid(RVN_MAX(grid, 1)),
+        _interval(interval),
+        _isvalid(true) {}
+    /* ---------------------------------------------------------------------- */
+    ExposureControl::~ExposureControl()
+    {
+        stop();
+    }
+    /* ---------------------------------------------------------------------- */
+    bool ExposureControl::query(uint32_t id, Range& range, int& value)
+    {
+        v4l2_queryctrl q = {};
+        q.id = id;
+
+        if (xioctl(_fd, VIDIOC_QUERYCTRL, &q) < 0 ||
+            (q.flags & V4L2_CTRL_FLAG_DISABLED))
+        {
+            return false;
+        }
+
+        v4l2_control c = {};
+        c.id = id;
+
+        if (xioctl(_fd, VIDIOC_G_CTRL, &c) < 0) { return false; }
+
+        range = {q.minimum, q.maximum, RVN_MAX((int)q.step, 1)};
+        value = c.value;
+
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    bool ExposureControl::set_control(uint32_t id, int value)
+    {
+        v4l2_control c = {};
+        c.id = id;
+        c.value = value;
+
+        return xioctl(_fd, VIDIOC_S_CTRL, &c) == 0;
+    }
+    /* ---------------------------------------------------------------------- */
+    bool ExposureControl::start(int fd, float fps, int max_exposure)
+    {
+        stop();
+
+        if (!isvalid()) { return false; }
+
+        _fd = fd;
+        _fps = fps;
+
+        int exposure = 0;
+        if (!query(V4L2_CID_EXPOSURE_ABSOLUTE, _exposure_range, exposure))
+        {
+            set_error_msg("Camera has no absolute exposure control");
+            return false;
+        }
+
+        // the frame rate comes first
+        _exposure_range.max = RVN_MIN(_exposure_range.max, max_exposure);
+        _exposure.store(exposure);
+
+        int gain = 0;
+        _has_gain = query(V4L2_CID_GAIN, _gain_range, gain);
+        _gain.store(gain);
+
+        _pending.store(false);
+        _last_sequence.store(0);
+
+        // the driver counts frames from 0 again on every stream
+        _resume_sequence.store(0);
+
+        _failures = 0;
+        _changes.clear();
+        _cost.reset();
+
+        printf("[EXPOSURE]: auto exposure to a mean luma of %.0f, exposure "
+            "%d - %d (x100 us)%s\n", _target, _exposure_range.min,
+            _exposure_range.max, _has_gain ? " and gain" : "");
+
+        (void)persist();
+        _control_thread = spawn_thread(ThreadRole::IO, "rvn-exposure",
+            &ExposureControl::control_loop, this);
+
+        _running = true;
+
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    void ExposureControl::stop()
+    {
+        if (!_running) { return; }
+
+        _state_continue.clear();
+        if (_control_thread.joinable()) { _control_thread.join(); }
+
+        _running = false;
+
+        const double interval = _fps > 0.0f ? 1e6 / _fps : 0.0;
+
+        printf("[EXPOSURE]: %zu changes (%u failed), histogram %.1f us mean, "
+            "%.1f us max (%.2f%% of the frame interval) over %ld frames\n",
+            _changes.size(), _failures, _cost.mean(), _cost.max(),
+            interval > 0.0 ? 100.0 * _cost.mean() / interval : 0.0,
+            _cost.count());
+    }
+    /* ---------------------------------------------------------------------- */
+    void ExposureControl::observe(const ImagePacket& packet, length_t bytes)
+    {
+        const uint32_t seq = packet.sequence();
+        _last_sequence.store(seq, std::memory_order_relaxed);
+
+        // the last change is still on it's way to (or through) the sensor,
+        // so these frames say nothing new
+        if (!_running || _pending.load(std::memory_order_acquire) ||
+            seq < _resume_sequence.load(std::memory_order_acquire))
+        {
+            return;
+        }
+
+        const FrameBudget::time_point t0 = FrameBudget::now();
+
+        uint32_t hist[256];
+        const uint32_t total = luma_histogram(packet, bytes, _grid, hist);
+
+        uint64_t sum = 0;
+        for (int b = 0; b < 256; ++b) { sum += (uint64_t)b * hist[b]; }
+
+        uint32_t clipped = 0;
+        for (int b = 250; b < 256; ++b) { clipped += hist[b]; }
+
+        _cost.add(std::chrono::duration<double, std::micro>(
+            FrameBudget::now() - t0).count());
+
+        if (total < 1) { return; }
+
+        const float mean = (float)sum / total;
+        const float saturated = (float)clipped / total;
+
+        float ratio = _target / RVN_MAX(mean, 1.0f);
+
+        if (saturated > _max_saturated)
+        {
+            ratio = RVN_MIN(ratio, 0.7f);
+        }
+        else if (fabs(ratio - 1.0f) < _deadband)
+        {
+            return;
+        }
+
+        // at most a doubling / halving per step, the loop settles over a few
+        ratio = RVN_MAX(RVN_MIN(ratio, 2.0f), 0.5f);
+
+        const int exposure = _exposure.load(std::memory_order_relaxed);
+        const int gain = _gain.load(std::memory_order_relaxed);
+
+        const int gain_step = RVN_MAX((_gain_range.max - _gain_range.min) / 16,
+            _gain_range.step);
+
+        const float want = exposure * ratio;
+
+        int new_exposure = exposure;
+        int new_gain = gain;
+
+        if (ratio > 1.0f)
+        {
+            new_exposure = (int)(RVN_MIN(want, (float)_exposure_range.max) + 0.5f);
+
+            // out of exposure, the rest has to come from gain
+            if (want > _exposure_range.max && _has_gain)
+            {
+                new_gain = RVN_MIN(gain + gain_step, _gain_range.max);
+            }
+        }
+        else if (_has_gain && gain > _gain_range.min)
+        {
+            // gain goes first on the way down
+            new_gain = RVN_MAX(gain - gain_step, _gain_range.min);
+        }
+        else
+        {
+            new_exposure = (int)(RVN_MAX(want, (float)_exposure_range.min) + 0.5f);
+        }
+
+        if (new_exposure == exposure && new_gain == gain) { return; }
+
+        _request = {seq, packet.timestamp(), 0, new_exposure, new_gain, mean,
+            saturated};
+
+        _pending.store(true, std::memory_order_release);
+    }
+    /* ---------------------------------------------------------------------- */
+    void ExposureControl::control_loop()
+    {
+        typedef std::chrono::steady_clock clock;
+
+        const clock::duration interval = std::chrono::milliseconds(_interval);
+        clock::time_point last = clock::now() - interval;
+
+        while (persist())
+        {
+            if (!_pending.load(std::memory_order_acquire) ||
+                clock::now() - last < interval)
+            {
+                sleep_ms(1);
+                continue;
+            }
+
+            ExposureChange change = _request;
+
+            const int exposure = _exposure.load(std::memory_order_relaxed);
+            const int gain = _gain.load(std::memory_order_relaxed);
+
+            bool ok = true;
+
+            if (change.exposure != exposure)
+            {
+                ok = set_control(V4L2_CID_EXPOSURE_ABSOLUTE, change.exposure);
+                if (ok) { _exposure.store(change.exposure); }
+            }
+
+            if (ok && change.gain != gain)
+            {
+                ok = set_control(V4L2_CID_GAIN, change.gain);
+                if (ok) { _gain.store(change.gain); }
+            }
+
+            last = clock::now();
+
+            change.applied_after = _last_sequence.load(
+                std::memory_order_relaxed);
+
+            if (ok)
+            {
+                _changes.push_back(change);
+
+                printf("[EXPOSURE]: frame %u (%.3f s, applied after %u): "
+                    "exposure %d -> %d, gain %d -> %d, mean luma %.1f, %.1f%% "
+                    "clipped\n", change.sequence, change.time,
+                    change.applied_after, exposure, change.exposure, gain,
+                    change.gain, change.mean, 100.0f * change.saturated);
+            }
+            else
+            {
+                ++_failures;
+                printf("[EXPOSURE]: frame %u: failed to set exposure %d, gain "
+                    "%d\n", change.sequence, change.exposure, change.gain);
+            }
+
+            // judge the change only on frames captured after it took effect
+            _resume_sequence.store(change.applied_after + _settle_frames,
+                std::memory_order_release);
+            _pending.store(false, std::memory_order_release);
+        }
+    }
+    /* ====================================================================== */
+}
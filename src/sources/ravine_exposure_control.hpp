@@ -0,0 +1,156 @@
+#ifndef RAVINE_EXPOSURE_CONTROL_HPP_
+#define RAVINE_EXPOSURE_CONTROL_HPP_
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+
+#include <cinttypes>
+
+#include "ravine_stats.hpp"
+#include "ravine_packets.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // a 256 bin histogram of the luma of <packet> (any format, see
+    // ImagePacket), sampled every <grid>'th pixel of every <grid>'th row,
+    // pixels at or past <bytes> are skipped. Returns the number of samples
+    uint32_t luma_histogram(const ImagePacket& packet, length_t bytes,
+        int grid, uint32_t* hist);
+    /* ====================================================================== */
+    // one change of the camera's exposure (in v4l2 100us units) and gain,
+    // decided on frame <sequence> (captured at <time>, Clock time base) and
+    // issued after frame <applied_after> had been dequeued, so the first
+    // frame that can show it comes after that
+    struct ExposureChange
+    {
+        uint32_t sequence;
+        double time;
+        uint32_t applied_after;
+        int exposure;
+        int gain;
+        float mean;
+        float saturated;
+    };
+    /* ====================================================================== */
+    // keeps the mean luma of the frames near <target> (a fraction of full
+    // scale): observe() runs on the capture thread for every frame and only
+    // costs a subsampled histogram (and not even that while a change is
+    // pending or settling), the ioctls are issued from the controller's own
+    // thread, at most one change per <interval> ms. Exposure is preferred
+    // over gain, which only adds noise, and never exceeds what the frame
+    // rate allows
+    class ExposureControl
+    {
+    public:
+        ExposureControl(float target = 0.45f, int grid = 4,
+            int interval = 100);
+        ~ExposureControl();
+
+        // take over exposure / gain of the (open) device <fd> running at
+        // <fps>, w/ <max_exposure> as the longest allowed
+        bool start(int fd, float fps, int max_exposure);
+        void stop();
+
+        // capture thread only, w/ a frame the caller holds
+        void observe(const ImagePacket& packet, length_t bytes);
+
+        inline bool is_running() const { return _running; }
+
+        // the current exposure (v4l2 100us units), safe from any thread
+        inline int exposure() const
+        {
+            return _exposure.load(std::memory_order_relaxed);
+        }
+
+        // only valid once stopped
+        inline const std::vector<ExposureChange>& changes() const
+        {
+            return _changes;
+        }
+
+        // us per observed frame
+        inline const RunningStats& cost() const { return _cost; }
+
+        inline const std::string& get_error_msg() const { return _err_msg; }
+        inline bool isvalid() const { return _isvalid; }
+
+    private:
+        struct Range
+        {
+            int min;
+            int max;
+            int step;
+        };
+
+        bool query(uint32_t id, Range& range, int& value);
+        bool set_control(uint32_t id, int value);
+
+        void control_loop();
+
+        inline bool persist()
+        {
+            return _state_continue.test_and_set(std::memory_order_acquire);
+        }
+
+        inline void set_error_msg(const std::string& msg)
+        {
+            if (isvalid())
+            {
+                _err_msg = msg;
+                _isvalid = false;
+            }
+            else
+            {
+                _err_msg.append(" " + msg);
+            }
+        }
+
+    private:
+        const float _target;
+        const int _grid;
+        const int _interval;
+
+        // ratios of target / mean w/in this of 1 are left alone
+        const float _deadband = 0.1f;
+
+        // above this fraction of clipped samples we darken regardless
+        const float _max_saturated = 0.02f;
+
+        // frames to wait after a change before judging it
+        const uint32_t _settle_frames = 2;
+
+        int _fd = -1;
+        float _fps = 0.0f;
+        bool _running = false;
+
+        Range _exposure_range = {0, 0, 1};
+        Range _gain_range = {0, 0, 1};
+        bool _has_gain = false;
+
+        std::atomic<int> _exposure{0};
+        std::atomic<int> _gain{0};
+
+        // the capture thread's request, handed over by _pending
+        ExposureChange _request;
+        std::atomic<bool> _pending{false};
+
+        std::atomic<uint32_t> _last_sequence{0};
+        std::atomic<uint32_t> _resume_sequence{0};
+
+        uint32_t _failures = 0;
+        std::vector<ExposureChange> _changes;
+        RunningStats _cost;
+
+        bool _isvalid;
+        std::string _err_msg;
+
+        std::atomic_flag _state_continue = ATOMIC_FLAG_INIT;
+        std::thread _control_thread;
+    };
+    /* ====================================================================== */
+}
+
+#endif
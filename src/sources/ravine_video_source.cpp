@@ -3,7 +3,8 @@
 #include <cstdio>
 #include <cmath>
 
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/time.h>
@@ -19,6 +20,7 @@
 
 #include "ravine_clock.hpp"
 #include "ravine_utils.hpp"
+#include "ravine_thread_policy.hpp"
 #include "ravine_video_source.hpp"
 
 namespace RVN
@@ -38,7 +40,7 @@ namespace RVN
     /* ====================================================================== */
     MMBuffer::MMBuffer(int fd, uint32_t offset, uint32_t length)
     {
-        // only memmap if the base class (RVN::YUYVImagePacket) can hold a
+        // only memmap if the base class (RVN::ImagePacket) can hold a
         // buffer of this size, in practive this will never fail as webcam
         // frames won't exceede int32_t::max (2^31-1 > 2e9) in bytes-per-frame,
         // but if it does the buffer will be in a valid but empty state, so
@@ -68,7 +70,8 @@ namespace RVN
         // from a temporary instance
         this->_data = other.data();
         this->_length = other.length();
-        this->_width = other.width();
+        set_format(other.format(), other.width(), other.height(),
+            other.luma_stride());
     }
     /* ---------------------------------------------------------------------- */
     MMBuffer::~MMBuffer()
@@ -79,17 +82,38 @@ namespace RVN
             munmap((void*)_data, _length);
         }
     }
+    /* ---------------------------------------------------------------------- */
+    bool MMBuffer::retain()
+    {
+        // only ever called while some other reference is held (at least the
+        // capture thread's), so relaxed is enough
+        _refs.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    void MMBuffer::release()
+    {
+        if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1 &&
+            _owner != nullptr)
+        {
+            _owner->requeue(this);
+        }
+    }
 
     /* ====================================================================== */
-    V4L2::V4L2(const char* dev, int width, int height, int framerate) :
+    V4L2::V4L2(const char* dev, int width, int height, int framerate,
+        PixelFormat format) :
         _dev(dev),
         _width(width),
         _height(height),
         _framerate(framerate),
+        _format(format),
         _isvalid(true) {}
     /* ---------------------------------------------------------------------- */
     V4L2::~V4L2()
     {
+        close_events();
+
         for (int k = 0; k < _buffers.size(); ++k)
         {
             if (_buffers[k] != nullptr)
@@ -99,6 +123,10 @@ namespace RVN
             }
         }
         _buffers.clear();
+
+        if (_decoded != nullptr) { delete _decoded; }
+        if (_jpeg != nullptr) { delete _jpeg; }
+        if (_exposure_ctl != nullptr) { delete _exposure_ctl; }
     }
     /* ---------------------------------------------------------------------- */
     bool V4L2::open_stream()
@@ -110,32 +138,50 @@ namespace RVN
             set_error_msg("Failed to open device");
             perror("[PERROR]: ");
         }
-        else if (verify_capabilities() && set_pixel_format())
+        else if (verify_capabilities())
         {
+            negotiate();
+        }
 
-            // set the framerate as requested, driver may pick a different frame
-            // rate however (<act> below)
-            float actual_fps = 0.0f;
+        return isvalid();
+    }
+    /* ---------------------------------------------------------------------- */
+    bool V4L2::negotiate()
+    {
+        if (!set_pixel_format()) { return false; }
 
-            if (set_framerate(_framerate, actual_fps) || actual_fps > 0.0f)
-            {
-                if (actual_fps != (float)_framerate)
-                {
-                    printf("***********************************************\n");
-                    printf("[WARNING]: failed to set framerate to %d fps",
-                        _framerate);
-                    printf("           using %f fps instead\n",
-                        actual_fps);
-                    printf("***********************************************\n");
-
-                    // set_framerate sets the error state to true if the driver
-                    // chose a different framerate, we must reset to be able to
-                    // to set the exposure
-                    reset_error_state();
-                }
+        // high rates (60 - 120 fps) are often only offered at small
+        // sizes or in some formats, so say why if we won't get one
+        const float max_fps = max_framerate(_width, _height);
+        if (max_fps > 0.0f && max_fps < _framerate)
+        {
+            printf("[VIDEO]: %d x %d %s is limited to %.1f fps\n", _width,
+                _height, format_name(_format), max_fps);
+        }
+
+        // set the framerate as requested, driver may pick a different frame
+        // rate however (<act> below)
+        float actual_fps = 0.0f;
 
-                set_exposure(actual_fps);
+        if (set_framerate(_framerate, actual_fps) || actual_fps > 0.0f)
+        {
+            if (actual_fps != (float)_framerate)
+            {
+                printf("***********************************************\n");
+                printf("[WARNING]: failed to set framerate to %d fps",
+                    _framerate);
+                printf("           using %f fps instead\n",
+                    actual_fps);
+                printf("***********************************************\n");
+
+                // set_framerate sets the error state to true if the driver
+                // chose a different framerate, we must reset to be able to
+                // to set the exposure
+                reset_error_state();
             }
+
+            _actual_fps = actual_fps;
+            set_exposure(actual_fps);
         }
 
         return isvalid();
@@ -164,18 +210,87 @@ namespace RVN
         return isvalid();
     }
     /* ---------------------------------------------------------------------- */
+    // the v4l2 fourcc of each of our formats
+    static uint32_t fourcc(PixelFormat fmt)
+    {
+        switch (fmt)
+        {
+            case PixelFormat::GREY: return V4L2_PIX_FMT_GREY;
+            case PixelFormat::NV12: return V4L2_PIX_FMT_NV12;
+            case PixelFormat::YU12: return V4L2_PIX_FMT_YUV420;
+            case PixelFormat::MJPEG: return V4L2_PIX_FMT_MJPEG;
+            default: return V4L2_PIX_FMT_YUYV;
+        }
+    }
+    /* ---------------------------------------------------------------------- */
     bool V4L2::set_pixel_format()
     {
         if (!isvalid()) { return false; }
 
+        // what the device can give us
+        std::vector<uint32_t> supported;
+
+        v4l2_fmtdesc desc = {};
+        desc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+        while (xioctl(_fd, VIDIOC_ENUM_FMT, &desc) == 0)
+        {
+            supported.push_back(desc.pixelformat);
+            ++desc.index;
+        }
+
+        // the fewer bytes per frame the better: GREY and the planar formats
+        // carry (at most) half as many bytes as YUYV, and the luma is packed.
+        // MJPEG is smaller still, but costs a decode so it has to be asked for
+        std::vector<PixelFormat> wanted;
+        if (_format == PixelFormat::Auto)
+        {
+            wanted = {PixelFormat::GREY, PixelFormat::NV12, PixelFormat::YU12,
+                PixelFormat::YUYV};
+        }
+        else
+        {
+            wanted = {_format};
+        }
+
+        if (_format == PixelFormat::MJPEG && !JpegDecoder::available())
+        {
+            set_error_msg("MJPEG requested but built w/o JPEG support");
+            return false;
+        }
+
+        PixelFormat pick = PixelFormat::Auto;
+        for (size_t k = 0; k < wanted.size() && pick == PixelFormat::Auto; ++k)
+        {
+            for (size_t j = 0; j < supported.size(); ++j)
+            {
+                if (supported[j] == fourcc(wanted[k]))
+                {
+                    pick = wanted[k];
+                    break;
+                }
+            }
+        }
+
+        if (pick == PixelFormat::Auto)
+        {
+            if (_format != PixelFormat::Auto)
+            {
+                set_error_msg(std::string("Device doesn't support ") +
+                    format_name(_format));
+                return false;
+            }
+
+            // driver wouldn't enumerate, try the one format every webcam has
+            pick = PixelFormat::YUYV;
+        }
+
         v4l2_format fmt = {};
 
         fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         fmt.fmt.pix.width = _width;
         fmt.fmt.pix.height = _height;
-
-        // YUV 4:2:2 [Y0,U0,Y1,V0]
-        fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+        fmt.fmt.pix.pixelformat = fourcc(pick);
         fmt.fmt.pix.field = V4L2_FIELD_NONE;
 
         // set / validate the requested image size
@@ -183,11 +298,24 @@ namespace RVN
         {
             set_error_msg("Failed to set pixel format");
         }
+        else if (fmt.fmt.pix.pixelformat != fourcc(pick))
+        {
+            set_error_msg("Driver rejected pixel format");
+        }
         else
         {
             // incase the driver is forcing a different size
+            _format = pick;
             _width = fmt.fmt.pix.width;
             _height = fmt.fmt.pix.height;
+            _stride = fmt.fmt.pix.bytesperline;
+
+            // no crop (yet)
+            _crop = {0, 0, _width, _height};
+            _full_height = _height;
+
+            printf("[VIDEO]: capturing %s @ %d x %d\n", format_name(_format),
+                _width, _height);
         }
 
         return isvalid();
@@ -239,6 +367,19 @@ namespace RVN
         return isvalid();
     }
     /* ---------------------------------------------------------------------- */
+    int V4L2::exposure_limit(float framerate)
+    {
+        // per-frame exposure in v4l2 100us units,
+        // set to framerate limit - 2ms:
+        //  * convert framerate (Hz) to ms-per-frame (- 2)
+        //  * convert to 100us units
+        int exposure = ((int)floor(1000.0f / framerate) - 2) * V4L2_TIME_MS;
+
+        // at high rates the -2 ms no longer leaves much, but keep a whole
+        // ms of exposure at least (~500 fps)
+        return RVN_MAX(exposure, V4L2_TIME_MS);
+    }
+    /* ---------------------------------------------------------------------- */
     bool V4L2::set_exposure(float framerate)
     {
         if (!isvalid()) { return false; }
@@ -253,11 +394,7 @@ namespace RVN
         }
         else
         {
-            // per-frame exposure in v4l2 100us units,
-            // set to framerate limit - 2ms:
-            //  * convert framerate (Hz) to ms-per-frame (- 2)
-            //  * convert to 100us units
-            int exposure = ((int)floor(1000.0f / framerate) - 2) * V4L2_TIME_MS;
+            const int exposure = exposure_limit(framerate);
 
             c.id = V4L2_CID_EXPOSURE_ABSOLUTE;
             c.value = exposure;
@@ -274,6 +411,9 @@ namespace RVN
 
                 if (xioctl(_fd, VIDIOC_G_CTRL, &c) == 0)
                 {
+                    // what the rows are actually exposed for
+                    _exposure_time = c.value;
+
                     if (c.value != exposure)
                     {
                         set_error_msg("Drive rejected exposure duration");
@@ -289,79 +429,219 @@ namespace RVN
         return isvalid();
     }
     /* ---------------------------------------------------------------------- */
-    bool V4L2::set_hardware_crop(const CropWindow& win)
+    float V4L2::max_framerate(int width, int height)
     {
-        return set_hardware_crop(win.col, win.row, win.width, win.height);
+        v4l2_frmivalenum ival = {};
+        ival.pixel_format = fourcc(_format);
+        ival.width = width;
+        ival.height = height;
+
+        float fps = 0.0f;
+
+        while (xioctl(_fd, VIDIOC_ENUM_FRAMEINTERVALS, &ival) == 0)
+        {
+            // the shortest interval is the highest rate
+            const v4l2_fract& f = ival.type == V4L2_FRMIVAL_TYPE_DISCRETE ?
+                ival.discrete : ival.stepwise.min;
+
+            if (f.numerator > 0)
+            {
+                fps = RVN_MAX(fps, (float)f.denominator / f.numerator);
+            }
+
+            if (ival.type != V4L2_FRMIVAL_TYPE_DISCRETE) { break; }
+            ++ival.index;
+        }
+
+        return fps;
     }
     /* ---------------------------------------------------------------------- */
-    bool V4L2::set_hardware_crop(int left, int top, int width, int height)
+    bool V4L2::fit_roi(const CropWindow& roi)
+    {
+        if (!isvalid()) { return false; }
+
+        // RFs can hang off the right / bottom of the frame
+        const int left = RVN_MAX(roi.col, 0);
+        const int top = RVN_MAX(roi.row, 0);
+        const int right = RVN_MIN(roi.col + roi.width, _crop.width);
+        const int bottom = RVN_MIN(roi.row + roi.height, _crop.height);
+
+        if (right <= left || bottom <= top)
+        {
+            set_error_msg("ROI lies outside of the frame");
+            return false;
+        }
+
+        // w/ chroma subsampled in x (and y for the planar formats) the crop
+        // has to start and end on even pixels
+        const int xa = _format == PixelFormat::GREY ? 1 : 2;
+        const int ya = (_format == PixelFormat::NV12 ||
+            _format == PixelFormat::YU12) ? 2 : 1;
+
+        CropWindow win;
+        win.col = left - left % xa;
+        win.row = top - top % ya;
+        win.width = RVN_MIN(right + (xa - right % xa) % xa, _crop.width) -
+            win.col;
+        win.height = RVN_MIN(bottom + (ya - bottom % ya) % ya, _crop.height) -
+            win.row;
+
+        if (win.length() >= _crop.length())
+        {
+            printf("[VIDEO]: ROI covers the whole frame, not cropping\n");
+            return true;
+        }
+
+        if (!set_hardware_crop(win))
+        {
+            // most webcams can't, which just means transfering the full frame
+            printf("[VIDEO]: %s, capturing the full frame\n",
+                get_error_msg().c_str());
+            reset_error_state();
+        }
+
+        printf("[VIDEO]: capturing %d x %d @ (%d, %d) for a %d x %d ROI @ "
+            "(%d, %d)\n", _crop.width, _crop.height, _crop.col, _crop.row,
+            right - left, bottom - top, left, top);
+
+        return isvalid();
+    }
+    /* ---------------------------------------------------------------------- */
+    bool V4L2::set_hardware_crop(const CropWindow& win)
     {
         v4l2_cropcap cap = {};
         cap.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
         if (xioctl(_fd, VIDIOC_CROPCAP, &cap) < 0)
         {
-            if (errno == ENODATA)
+            if (errno == ENODATA || errno == EINVAL || errno == ENOTTY)
             {
-                set_error_msg("Camera does NOT support hardware cropping: 1");
+                set_error_msg("Camera does NOT support hardware cropping");
             }
             else
             {
                 set_error_msg("Failed to query cropping capability");
             }
+            return false;
+        }
+
+        v4l2_crop crop = {};
+        crop.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+        // CROPCAP doesn't (in practice) error if cropping isn't supported, but
+        // G_CROP does
+        if (xioctl(_fd, VIDIOC_G_CROP, &crop) < 0)
+        {
+            set_error_msg("Camera does NOT support hardware cropping");
+            return false;
+        }
+
+        // the (uncropped) frame covers the default rect, which is in sensor
+        // pixels, so scale our window into those
+        const v4l2_rect& def = cap.defrect;
+        const double sx = (double)def.width / _width;
+        const double sy = (double)def.height / _height;
+
+        crop.c.left = def.left + (int)(win.col * sx + 0.5);
+        crop.c.top = def.top + (int)(win.row * sy + 0.5);
+        crop.c.width = (uint32_t)(win.width * sx + 0.5);
+        crop.c.height = (uint32_t)(win.height * sy + 0.5);
+
+        v4l2_format fmt = {};
+        fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+        if (xioctl(_fd, VIDIOC_S_CROP, &crop) < 0 ||
+            xioctl(_fd, VIDIOC_G_CROP, &crop) < 0)
+        {
+            set_error_msg("Failed to set cropping params");
+        }
+        else if (xioctl(_fd, VIDIOC_G_FMT, &fmt) < 0)
+        {
+            set_error_msg("Failed to get format");
         }
         else
         {
-            v4l2_crop crop = {};
-            crop.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-            crop.c = cap.defrect;
+            // ask for the crop at 1:1 so that our window's pixels are the
+            // frame's pixels
+            fmt.fmt.pix.width = win.width;
+            fmt.fmt.pix.height = win.height;
 
-            // query the default cropping setting to get the crop bounds
-            if (xioctl(_fd, VIDIOC_G_CROP, &crop) < 0)
+            if (xioctl(_fd, VIDIOC_S_FMT, &fmt) < 0)
             {
-                if (errno == EINVAL)
-                {
-                    // this should never happen, given the above, right?, but it
-                    // does as CROPCAP doesn't (in practice) error if cropping
-                    // isn't supported
-                    set_error_msg("Camera does NOT support hardware cropping: 2");
-                }
-                else
-                {
-                    set_error_msg("Failed to get cropping params");
-                }
+                set_error_msg("Failed to set the cropped format");
             }
-            else
-            {
-                // make sure our requested rect lies within the devices crop
-                // bounds
-                crop.c.left = RVN_MAX(left, cap.bounds.left);
-                crop.c.top = RVN_MAX(top, cap.bounds.top);
-                crop.c.width = RVN_MIN((uint32_t)width, cap.bounds.width);
-                crop.c.height = RVN_MIN((uint32_t)height, cap.bounds.height);
+        }
 
-                if (xioctl(_fd, VIDIOC_S_CROP, &crop) < 0)
-                {
-                    set_error_msg("Failed to set cropping params");
-                    perror("MSG");
-                }
-                else
-                {
-                    // device is set to crop, so keep track of our new image
-                    // size (width in particular, as the buffers need that info)
-                    _width = crop.c.width;
-                    _height = crop.c.height;
-                }
-            }
+        // what we actually got (the driver may adjust the rect), in frame
+        // pixels, has to still contain the window at the same scale
+        CropWindow got = {
+            (int)((crop.c.left - def.left) / sx + 0.5),
+            (int)((crop.c.top - def.top) / sy + 0.5),
+            (int)fmt.fmt.pix.width,
+            (int)fmt.fmt.pix.height
+        };
+
+        const bool scaled = (int)(crop.c.width / sx + 0.5) != got.width ||
+            (int)(crop.c.height / sy + 0.5) != got.height;
+
+        const bool covers = got.col <= win.col && got.row <= win.row &&
+            got.col + got.width >= win.col + win.width &&
+            got.row + got.height >= win.row + win.height;
+
+        if (isvalid() && (scaled || !covers))
+        {
+            set_error_msg("Driver won't crop w/o scaling");
         }
 
-        return isvalid();
+        if (!isvalid())
+        {
+            // put the uncropped frame back, as best we can
+            crop.c = def;
+            (void)xioctl(_fd, VIDIOC_S_CROP, &crop);
+
+            fmt.fmt.pix.width = _width;
+            fmt.fmt.pix.height = _height;
+            fmt.fmt.pix.pixelformat = fourcc(_format);
+            (void)xioctl(_fd, VIDIOC_S_FMT, &fmt);
+
+            return false;
+        }
+
+        _crop = got;
+        _width = got.width;
+        _height = got.height;
+        _stride = fmt.fmt.pix.bytesperline;
+
+        return true;
     }
     /* ---------------------------------------------------------------------- */
     bool V4L2::initialize_buffers(int count)
     {
         if (!isvalid()) { return false; }
 
+        // a hardware crop may have changed the frame size since
+        // set_pixel_format(), so get the final geometry
+        v4l2_format fmt = {};
+        fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+        if (xioctl(_fd, VIDIOC_G_FMT, &fmt) == 0)
+        {
+            _width = fmt.fmt.pix.width;
+            _height = fmt.fmt.pix.height;
+            _stride = fmt.fmt.pix.bytesperline;
+        }
+
+        // a second call (see reconfigure()) replaces the old buffers
+        free_buffers();
+
+        if (_format == PixelFormat::MJPEG)
+        {
+            // sinks get the decoded luma instead of the compressed frame
+            if (_jpeg == nullptr) { _jpeg = new JpegDecoder(); }
+            if (_decoded != nullptr) { delete _decoded; }
+            _decoded = new DecodedFrame(_width, _height);
+        }
+
         // ask the device to initilize buffer for capture streaming
         v4l2_requestbuffers req = {};
 
@@ -410,10 +690,14 @@ namespace RVN
                 }
                 else
                 {
-                    // the buffer needs to know it's own width (in pixels)
+                    // the buffer needs to know it's own geometry and format
                     // as it is the packet that we'll send to our sink, and sink
                     // requires that information
-                    _buffers[k]->set_width(_width);
+                    _buffers[k]->set_format(_format, _width, _height, _stride);
+
+                    // and who to give it back to once the sink is done
+                    _buffers[k]->_owner = this;
+                    _buffers[k]->_index = k;
                 }
 
             }
@@ -426,7 +710,155 @@ namespace RVN
         return isvalid();
     }
     /* ---------------------------------------------------------------------- */
+    void V4L2::free_buffers()
+    {
+        if (_buffers.empty()) { return; }
+
+        for (size_t k = 0; k < _buffers.size(); ++k)
+        {
+            if (_buffers[k] != nullptr) { delete _buffers[k]; }
+        }
+        _buffers.clear();
+
+        // the driver only lets go of it's buffers once they're all unmapped
+        v4l2_requestbuffers req = {};
+
+        req.count = 0;
+        req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        req.memory = V4L2_MEMORY_MMAP;
+
+        if (xioctl(_fd, VIDIOC_REQBUFS, &req) < 0)
+        {
+            set_error_msg("Failed to free device buffers");
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void V4L2::reset_hardware_crop()
+    {
+        v4l2_cropcap cap = {};
+        cap.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+        if (xioctl(_fd, VIDIOC_CROPCAP, &cap) < 0) { return; }
+
+        // as in set_hardware_crop(), failing just means the camera doesn't
+        // crop, so the frame is already uncropped
+        v4l2_crop crop = {};
+        crop.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        crop.c = cap.defrect;
+
+        (void)xioctl(_fd, VIDIOC_S_CROP, &crop);
+    }
+    /* ---------------------------------------------------------------------- */
+    bool V4L2::reconfigure(int width, int height, int framerate,
+        PixelFormat format, int nbuf, const CropWindow& roi)
+    {
+        if (!isvalid()) { return false; }
+
+        const bool own_thread = _stream_thread.joinable();
+
+        if (_capturing && !own_thread)
+        {
+            set_error_msg("Camera is captured by a CaptureManager, stop it "
+                "first");
+            return false;
+        }
+
+        // pause delivery, the sink stays open
+        if (own_thread) { halt_thread(); }
+
+        // a sink may still hold (retain()ed) frames in buffers that are about
+        // to be unmapped, if so nothing has changed yet and the old
+        // configuration just carries on
+        if (!wait_released())
+        {
+            printf("[VIDEO]: not reconfigured, the sink still holds %d "
+                "frames\n", _held.load());
+
+            if (own_thread)
+            {
+                persist();
+
+                _stream_thread = spawn_thread(ThreadRole::Capture,
+                    "rvn-capture", &V4L2::stream, this);
+            }
+
+            return false;
+        }
+
+        // exposure is set from scratch, and the controller restarted, below
+        if (_exposure_ctl != nullptr) { _exposure_ctl->stop(); }
+
+        if (_capturing)
+        {
+            v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+            if (xioctl(_fd, VIDIOC_STREAMOFF, &type) < 0)
+            {
+                set_error_msg("Failed to stop vidioc stream");
+                end_capture();
+                return false;
+            }
+        }
+
+        // the driver won't change format while it has buffers
+        free_buffers();
+        reset_hardware_crop();
+
+        _width = width;
+        _height = height;
+        _framerate = framerate;
+        _format = format;
+
+        if (negotiate() && (roi.width < 1 || roi.height < 1 || fit_roi(roi))
+            && initialize_buffers(nbuf))
+        {
+            printf("[VIDEO]: reconfigured to %s %d x %d @ (%d, %d), %.1f fps, "
+                "%d buffers\n", format_name(_format), _width, _height,
+                _crop.col, _crop.row, _actual_fps, buffer_count());
+
+            // resume, the sink is told about the new frames before the first
+            // one arrives
+            if (_capturing && begin_capture(false))
+            {
+                persist();
+
+                _stream_thread = spawn_thread(ThreadRole::Capture,
+                    "rvn-capture", &V4L2::stream, this);
+            }
+        }
+
+        // the old buffers are gone, so a failure past here leaves the camera
+        // stopped (sink closed) rather than streaming w/o a capture thread
+        if (!isvalid() && _capturing) { end_capture(); }
+
+        return isvalid();
+    }
+    /* ---------------------------------------------------------------------- */
     bool V4L2::start_stream()
+    {
+        if (!init_events())
+        {
+            set_error_msg("Failed to set up epoll");
+        }
+        else if (begin_capture())
+        {
+            printf("[VIDEO]: launching stream\n");
+
+            // by calling persist() we set the _state_continue flag to true
+            // (reguardless of it's current state which should start false)
+            // so that V4L2::stream will wait for the stop signal (seting
+            // _state_continue to false)
+            persist();
+
+            // launch the actual frame stream
+            _stream_thread = spawn_thread(ThreadRole::Capture, "rvn-capture",
+                &V4L2::stream, this);
+        }
+
+        return isvalid();
+    }
+    /* ---------------------------------------------------------------------- */
+    bool V4L2::begin_capture(bool open_sink)
     {
         if (!isvalid()) { return false; }
 
@@ -436,7 +868,56 @@ namespace RVN
             return false;
         }
 
-        // queue up all the buffers
+        // frames a sink still holds from the last run would be queued again
+        // below while it reads them
+        if (!wait_released())
+        {
+            set_error_msg("Sink did not release it's frames");
+            return false;
+        }
+
+        _max_held = 0;
+        _starved.store(0);
+        _requeue_errors.store(0);
+
+        _dqbuf_latency.reset();
+        _dropped = 0;
+        _decode_errors = 0;
+        _frame_count = 0;
+        _last_sequence = 0;
+        _sequenced = false;
+
+        _skipped = 0;
+        _depth_stats.reset();
+        _age_stats.reset();
+        _queue_depth.store(0);
+        _frame_age.store(0.0f);
+
+        if (_line_time_us > 0.0f)
+        {
+            _line_time = _line_time_us * 1e-6f;
+        }
+        else if (_actual_fps > 0.0f && _full_height > 0)
+        {
+            _line_time = V4L2_READOUT_FRACTION / (_actual_fps * _full_height);
+        }
+        else
+        {
+            _line_time = 0.0f;
+        }
+
+        // every buffer starts in rotation
+        _parked.clear();
+        _nparked.store(0);
+        _to_park.store(0);
+        _clean_frames = 0;
+        _tune_floor = 2;
+
+        // queue up all the buffers, from empty queues (STREAMOFF returns any
+        // left queued to us, and is harmless when not streaming)
+        v4l2_buf_type off = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        (void)xioctl(_fd, VIDIOC_STREAMOFF, &off);
+
         for (int k = 0; k < buffer_count(); ++k)
         {
             v4l2_buffer buf = {};
@@ -456,173 +937,506 @@ namespace RVN
         {
             v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
+            // the sink sizes it's buffers / windows before the first frame
+            notify_sink_format(stream_format());
+
             if (xioctl(_fd, VIDIOC_STREAMON, &type) < 0)
             {
                 set_error_msg("Failed to start streaming");
             }
-            else if(open_sink_stream())
+            else if (open_sink && !open_sink_stream())
             {
-                printf("[VIDEO]: launching stream\n");
+                set_error_msg("Failed to open sink stream");
+            }
+        }
 
-                // by calling persist() we set the _state_continue flag to true
-                // (reguardless of it's current state which should start false)
-                // so that V4L2::stream will wait for the stop signal (seting
-                // _state_continue to false)
-                persist();
+        // w/o the controls the camera just keeps it's fixed exposure
+        if (isvalid() && _exposure_ctl != nullptr &&
+            !_exposure_ctl->start(_fd, _actual_fps,
+                exposure_limit(_actual_fps)))
+        {
+            printf("[VIDEO]: no auto exposure: %s\n",
+                _exposure_ctl->get_error_msg().c_str());
+            delete _exposure_ctl;
+            _exposure_ctl = nullptr;
+        }
 
-                // launch the actual frame stream
-                _stream_thread = std::thread(&V4L2::stream, this);
-            }
-            else
+        _capturing = isvalid();
+
+        return isvalid();
+    }
+    /* ---------------------------------------------------------------------- */
+    bool V4L2::end_capture()
+    {
+        if (_exposure_ctl != nullptr) { _exposure_ctl->stop(); }
+
+        // the frames a sink releases as it closes (a final flush, a drain)
+        // are requeued while the stream is still on
+        if (!close_sink_stream())
+        {
+            set_error_msg("Failed to close sink stream");
+        }
+
+        // any released later just stop being held, see requeue()
+        _capturing = false;
+
+        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+        if (xioctl(_fd, VIDIOC_STREAMOFF, &type) < 0)
+        {
+            set_error_msg("Failed to stop vidioc stream");
+        }
+
+        return isvalid();
+    }
+    /* ---------------------------------------------------------------------- */
+    void V4L2::requeue(MMBuffer* buffer)
+    {
+        // this may well be a sink's thread, so leave it to stream() to
+        // report the failure. Once capture has ended the buffer isn't
+        // queued, begin_capture() queues every buffer
+        if (_capturing && !queue_buffer(buffer->_index))
+        {
+            _requeue_errors.fetch_add(1);
+        }
+
+        _held.fetch_sub(1, std::memory_order_release);
+    }
+    /* ---------------------------------------------------------------------- */
+    bool V4L2::wait_released()
+    {
+        for (int k = 0; k < V4L2_RELEASE_WAIT_MS && _held.load() > 0; ++k)
+        {
+            sleep_ms(1);
+        }
+
+        return _held.load() == 0;
+    }
+    /* ---------------------------------------------------------------------- */
+    bool V4L2::queue_buffer(uint32_t index)
+    {
+        // the tuner asked for one less buffer in rotation, so this one sits
+        // out (see tune_buffers())
+        int park = _to_park.load();
+        while (park > 0)
+        {
+            if (_to_park.compare_exchange_weak(park, park - 1))
             {
-                set_error_msg("Failed to open sink stream");
+                while (wait_flag(_parked_busy)) {/* spin */}
+                _parked.push_back(index);
+                release_flag(_parked_busy);
+
+                _nparked.fetch_add(1);
+                return true;
             }
         }
 
-        return isvalid();
+        v4l2_buffer buf = {};
+
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = index;
+
+        return xioctl(_fd, VIDIOC_QBUF, &buf) == 0;
+    }
+    /* ---------------------------------------------------------------------- */
+    bool V4L2::unpark_buffer()
+    {
+        while (wait_flag(_parked_busy)) {/* spin */}
+
+        if (_parked.empty())
+        {
+            release_flag(_parked_busy);
+            return false;
+        }
+
+        const uint32_t index = _parked.back();
+        _parked.pop_back();
+        release_flag(_parked_busy);
+
+        _nparked.fetch_sub(1);
+
+        if (!queue_buffer(index)) { _requeue_errors.fetch_add(1); }
+
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    void V4L2::tune_buffers(bool dropped)
+    {
+        if (dropped)
+        {
+            _clean_frames = 0;
+
+            // the driver ran out of buffers, put one back in rotation and
+            // never go below that again
+            if (unpark_buffer())
+            {
+                _tune_floor = active_buffers();
+                printf("[VIDEO]: dropped frames, %d buffers in rotation\n",
+                    _tune_floor);
+            }
+        }
+        else if (++_clean_frames >= (uint32_t)(2 * _framerate) &&
+            active_buffers() - _to_park.load() > _tune_floor)
+        {
+            // ~2 s w/o a drop, try one less
+            _clean_frames = 0;
+            _to_park.fetch_add(1);
+        }
     }
     /* ---------------------------------------------------------------------- */
     void V4L2::stream()
     {
         if (!isvalid()) { return; }
 
-        fd_set fds;
+        // at most one event per fd
+        epoll_event events[2];
 
-        timeval timeout;
-        timeout.tv_sec = 5;
-        timeout.tv_usec = 0;
-
-        int kframe = 0;
         bool error = false;
         std::string err_msg;
 
+        timespec t1, t2;
+
         Clock clock;
 
-        timespec t1, t2;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
 
         while (persist() && (!error))
         {
-            bool frame_ready = false;
+            // sleep until a frame is ready or stop_stream() signals us, no
+            // timeout needed as shutdown no longer depends on one
+            int n = epoll_wait(_epoll_fd, events, 2, -1);
 
-            while (!frame_ready)
+            if (n < 0)
             {
-                FD_ZERO(&fds);
-                FD_SET(_fd, &fds);
+                if (errno != EINTR)
+                {
+                    error = true;
+                    err_msg = "Error occured in epoll_wait!";
+                }
+                continue;
+            }
 
-                int r = select(_fd + 1, &fds, NULL, NULL, &timeout);
+            timespec t_ready;
+            clock_gettime(CLOCK_MONOTONIC, &t_ready);
 
-                if (r == 0)
+            for (int k = 0; k < n && !error; ++k)
+            {
+                if (events[k].data.fd == _stop_fd)
                 {
-                    // in testing, timeouts actually apear not to be a big deal,
-                    // occuring ~1 per 8 seconds (@ 15 fps, 360 x 240)
-                    //printf("[TIMEOUT]: %d @ %f\n", kframe, clock.now());
-
-                    // on timeout, the timespec struct is left in a "undefined"
-                    // state, so reset it to avoid another immediate timeout
-                    timeout.tv_sec = 5;
-                    timeout.tv_usec = 0;
-                    break;
+                    // stop_stream() cleared the flag, so the loop ends, but
+                    // drain the counter anyway
+                    uint64_t val;
+                    ssize_t r = read(_stop_fd, &val, sizeof(val));
+                    (void)r;
                 }
-                else if (r == -1 && errno != EINTR)
+                else if (events[k].events & EPOLLERR)
                 {
-                    // something went wrong
                     error = true;
-                    err_msg = "Error occured in select!";
-                    break;
+                    err_msg = "Device reported an error";
                 }
-                else if (r > 0)
+                else if (events[k].events & EPOLLIN)
                 {
-                    frame_ready = true;
-                    if (kframe == 0)
-                    {
-                        clock_gettime(CLOCK_MONOTONIC, &t1);
-                    }
-
-                    break;
+                    error = !dequeue(clock, t_ready, err_msg);
                 }
+            }
+        }
 
-                // sleep for a bit
-                sleep_ms(10);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+
+        if (error)
+        {
+            //printf("[INFO]: an error occured during streaming, will report\n");
+            set_error_msg(err_msg);
+            perror("PERROR: ");
+        }
+        else
+        {
+            printf("[INFO]: ending stream\n");
+            float dur = (float)(t2.tv_sec - t1.tv_sec) * 1000.0f +
+                (float)(t2.tv_nsec - t1.tv_nsec) / 1000000.0f;
+            printf("[INFO]: got %u frames in %f ms, %u dropped\n",
+                _frame_count, dur, _dropped);
+            if (_decode_errors > 0)
+            {
+                printf("[INFO]: %u frames failed to decode: %s\n",
+                    _decode_errors, _jpeg->get_error_msg().c_str());
+            }
+            printf("[INFO]: at most %d of %d buffers held downstream, "
+                "starved %u times\n", _max_held, buffer_count(),
+                _starved.load());
+            printf("[INFO]: ready -> DQBUF latency (ms): mean %.3f, sd %.3f, "
+                "min %.3f, max %.3f\n", _dqbuf_latency.mean(),
+                _dqbuf_latency.sd(), _dqbuf_latency.min(),
+                _dqbuf_latency.max());
+            printf("[INFO]: frame age at delivery (ms): mean %.3f, max %.3f, "
+                "queue depth: mean %.2f, max %.0f\n", _age_stats.mean(),
+                _age_stats.max(), _depth_stats.mean(), _depth_stats.max());
+            if (_latest_only)
+            {
+                printf("[INFO]: latest frame only, %u stale frames skipped\n",
+                    _skipped);
+            }
+            if (_auto_tune)
+            {
+                printf("[INFO]: buffer count tuned to %d of %d\n",
+                    active_buffers(), buffer_count());
             }
+        }
+
+    }
+    /* ---------------------------------------------------------------------- */
+    bool V4L2::dequeue(const Clock& clock, const timespec& t_ready,
+        std::string& err_msg)
+    {
+        if (_requeue_errors.load() > 0)
+        {
+            err_msg = "failed to re-queue frame";
+            return false;
+        }
 
-            if (frame_ready)
+        const FrameBudget::time_point t0 = FrameBudget::now();
+
+        v4l2_buffer buf = {};
+
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+
+        if (xioctl(_fd, VIDIOC_DQBUF, &buf) < 0)
+        {
+            //failed to dequeue frame
+            if (errno != EAGAIN)
             {
-                //printf("[INFO]: got frame %d\n", kframe);
+                err_msg = "Failed to dqueue frame";
+                return false;
+            }
+            return true;
+        }
 
-                v4l2_buffer buf = {};
+        if (buf.index >= _buffers.size()) { return true; }
 
-                buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-                buf.memory = V4L2_MEMORY_MMAP;
+        // frames that were waiting, including this one
+        int depth = 1;
+        uint32_t gap = count_sequence(buf.sequence);
 
-                if (xioctl(_fd, VIDIOC_DQBUF, &buf) < 0)
-                {
-                    //failed to dequeue frame
-                    if (errno != EAGAIN)
-                    {
-                        error = true;
-                        err_msg = "Failed to dqueue frame";
-                    }
+        if (_latest_only)
+        {
+            // take everything the driver has ready, only the newest frame
+            // goes downstream, the rest go straight back to the driver
+            v4l2_buffer next = buf;
 
-                }
-                else if (buf.index < _buffers.size())
+            while (xioctl(_fd, VIDIOC_DQBUF, &next) == 0)
+            {
+                if (next.index >= _buffers.size()) { continue; }
+
+                if (!queue_buffer(buf.index))
                 {
-                    //printf("[INFO]: appears we have a valid buffer at %d\n", buf.index);
+                    err_msg = "failed to re-queue stale frame";
+                    return false;
+                }
 
-                    // in a YUYV frame, every other sample is luminance, so
-                    // total bytes is width x height x 2, so we send width and
-                    // bytesused
+                buf = next;
+                gap += count_sequence(buf.sequence);
+                ++depth;
+                ++_skipped;
+            }
 
-                    // send to sink (this should be synchronous but fast)
-                    //printf("[INFO]: forwrding buffer to sink...\n");
-                    send_sink(_buffers[buf.index], buf.bytesused);
-                    ++kframe;
+            if (errno != EAGAIN)
+            {
+                err_msg = "Failed to dqueue frame";
+                return false;
+            }
+        }
 
-                    if (xioctl(_fd, VIDIOC_QBUF, &buf) < 0)
-                    {
-                        // NOTE TODO FIXME: what do we do here?
-                        // failed to re-queue the frame
-                        error = true;
-                        err_msg = "failed to re-queue frame";
-                    }
+        _queue_depth.store(depth, std::memory_order_relaxed);
+        _depth_stats.add(depth);
+
+        if (_auto_tune) { tune_buffers(gap > 0); }
+
+        timespec t_dq;
+        clock_gettime(CLOCK_MONOTONIC, &t_dq);
+
+        // readiness is when the driver finished the buffer if it's
+        // timestamps are on our clock, otherwise when epoll woke us
+        const bool mono = (buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) ==
+            V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+
+        const double ready = mono ?
+            buf.timestamp.tv_sec * 1e3 + buf.timestamp.tv_usec * 1e-3 :
+            t_ready.tv_sec * 1e3 + t_ready.tv_nsec * 1e-6;
+
+        _dqbuf_latency.add(t_dq.tv_sec * 1e3 + t_dq.tv_nsec * 1e-6 - ready);
+
+        MMBuffer* frame = _buffers[buf.index];
+
+        // capture time in the Clock time base, so that everything downstream
+        // (spikes, audio) can be placed relative to it
+        frame->set_timestamp(mono ?
+            clock.from_monotonic(buf.timestamp.tv_sec,
+                buf.timestamp.tv_usec * 1000L) : clock.now(),
+            buf.sequence);
+
+        set_row_timing(frame, mono && (buf.flags &
+            V4L2_BUF_FLAG_TSTAMP_SRC_MASK) == V4L2_BUF_FLAG_TSTAMP_SRC_SOE);
+
+        const int held = _held.fetch_add(1) + 1;
+        _max_held = RVN_MAX(_max_held, held);
+
+        // every buffer is now downstream so the driver has nothing to
+        // capture into until a sink lets one go
+        if (held >= active_buffers()) { _starved.fetch_add(1); }
+
+        // how old the frame is as it goes downstream
+        const float age = (clock.now() - frame->timestamp()) * 1e3f;
+        _frame_age.store(age, std::memory_order_relaxed);
+        _age_stats.add(age);
+
+        frame->lend();
+
+        if (_decoded != nullptr)
+        {
+            // MJPEG: sinks get the luma, decoded right here, in a buffer they
+            // can't hold on to
+            if (_jpeg->decode_luma(frame->data(), buf.bytesused,
+                _decoded->data(), _width, _height, _width))
+            {
+                _decoded->copy_timestamp(*frame);
+
+                if (_budget != nullptr) { _budget->add(Stage::Capture, t0); }
+
+                send_sink(_decoded, _decoded->length());
+
+                if (_exposure_ctl != nullptr)
+                {
+                    _exposure_ctl->observe(*_decoded, _decoded->length());
                 }
             }
+            else
+            {
+                ++_decode_errors;
+            }
         }
+        else
+        {
+            if (_budget != nullptr) { _budget->add(Stage::Capture, t0); }
 
-        clock_gettime(CLOCK_MONOTONIC, &t2);
+            // send to sink, which either finishes w/ the frame right away or
+            // retain()s it to work on the mmap'd data later
+            send_sink(frame, buf.bytesused);
 
-        if (error)
+            // after the sink has it, so as not to delay it, the frame is ours
+            // until the release() below
+            if (_exposure_ctl != nullptr)
+            {
+                _exposure_ctl->observe(*frame, buf.bytesused);
+            }
+        }
+        ++_frame_count;
+
+        // drop our reference, if no sink kept the frame it goes straight
+        // back to the driver (from this thread)
+        frame->release();
+
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    void V4L2::set_row_timing(MMBuffer* frame, bool soe)
+    {
+        const int exposure = _exposure_ctl != nullptr ?
+            _exposure_ctl->exposure() : _exposure_time;
+
+        // seconds, from 100us units
+        const float half = 0.5f * exposure / (1000.0f * V4L2_TIME_MS);
+
+        // row r is read out at (time of row 0) + r * line time, and exposed
+        // for the <exposure> before that. Start-of-exposure stamps are for
+        // the first row, the usual end-of-frame ones for the last (as is
+        // waking up to the frame), a crop reads out only it's own rows
+        double row0;
+        if (soe)
         {
-            //printf("[INFO]: an error occured during streaming, will report\n");
-            set_error_msg(err_msg);
-            perror("PERROR: ");
+            row0 = frame->timestamp() + half;
         }
         else
         {
-            printf("[INFO]: ending stream\n");
-            float dur = (float)(t2.tv_sec - t1.tv_sec) * 1000.0f +
-                (float)(t2.tv_nsec - t1.tv_nsec) / 1000000.0f;
-            printf("[INFO]: got %d frames in %f ms\n", kframe, dur);
+            row0 = frame->timestamp() - (_height - 1) * _line_time - half;
         }
 
+        frame->set_row_timing(row0, _line_time);
     }
     /* ---------------------------------------------------------------------- */
-    bool V4L2::stop_stream()
+    uint32_t V4L2::count_sequence(uint32_t sequence)
     {
-        send_stop();
-        _stream_thread.join();
-
-        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-
-        if (xioctl(_fd, VIDIOC_STREAMOFF, &type) < 0)
+        // every gap in the driver's sequence is a frame it had nowhere to
+        // put (or that we were too slow to collect)
+        uint32_t gap = 0;
+        if (_sequenced && sequence > _last_sequence + 1)
         {
-            set_error_msg("Failed to stop vidioc stream");
+            gap = sequence - _last_sequence - 1;
         }
 
-        if (!close_sink_stream())
+        _dropped += gap;
+        _last_sequence = sequence;
+        _sequenced = true;
+
+        return gap;
+    }
+    /* ---------------------------------------------------------------------- */
+    bool V4L2::init_events()
+    {
+        close_events();
+
+        _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        _stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (_epoll_fd < 0 || _stop_fd < 0) { return false; }
+
+        epoll_event ev = {};
+
+        ev.events = EPOLLIN;
+        ev.data.fd = _fd;
+
+        if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _fd, &ev) < 0) { return false; }
+
+        ev.events = EPOLLIN;
+        ev.data.fd = _stop_fd;
+
+        return epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _stop_fd, &ev) == 0;
+    }
+    /* ---------------------------------------------------------------------- */
+    void V4L2::close_events()
+    {
+        if (_epoll_fd >= 0) { close(_epoll_fd); }
+        if (_stop_fd >= 0) { close(_stop_fd); }
+
+        _epoll_fd = -1;
+        _stop_fd = -1;
+    }
+    /* ---------------------------------------------------------------------- */
+    void V4L2::halt_thread()
+    {
+        send_stop();
+
+        // wake the stream thread (if it's waiting on epoll) so that it
+        // sees the stop right away
+        if (_stop_fd >= 0)
         {
-            set_error_msg("Failed to close sink stream");
+            uint64_t one = 1;
+            ssize_t r = write(_stop_fd, &one, sizeof(one));
+            (void)r;
         }
 
+        if (_stream_thread.joinable()) { _stream_thread.join(); }
+    }
+    /* ---------------------------------------------------------------------- */
+    bool V4L2::stop_stream()
+    {
+        halt_thread();
+
+        close_events();
+
+        end_capture();
+
         return isvalid();
     }
     /* ---------------------------------------------------------------------- */
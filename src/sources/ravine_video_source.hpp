@@ -8,19 +8,37 @@
 #include <atomic>
 #include <thread>
 
+#include <time.h>
+
+#include "ravine_jpeg.hpp"
+#include "ravine_simd.hpp"
+#include "ravine_stats.hpp"
 #include "ravine_packets.hpp"
+#include "ravine_frame_budget.hpp"
+#include "ravine_exposure_control.hpp"
 #include "ravine_base_sink.hpp"
 #include "ravine_base_source.hpp"
 
 // conversion factor b/t milliseconds and v4l2 100us exposure units
 #define V4L2_TIME_MS 10
+// fraction of the frame period a (rolling shutter) sensor takes to read out
+// all of it's rows, when the line time isn't given, see V4L2::set_line_time()
+#define V4L2_READOUT_FRACTION 0.9f
+// how long reconfigure() / begin_capture() wait for sinks to release frames
+#define V4L2_RELEASE_WAIT_MS 1000
 #define CLEAR(x) (memset(&(x), 0, sizeof(x)))
 
 namespace RVN
 {
     int xioctl(int fh, unsigned long request, void *arg);
+    class V4L2;
+    class Clock;
+    class CaptureManager;
     /* =======================================================================*/
-    class MMBuffer : public YUYVImagePacket
+    // a frame in one of the driver's mmap'd buffers: sinks may hold on to it
+    // past process() (see FramePacket::retain()), the buffer only goes back
+    // to the driver once the last holder releases it
+    class MMBuffer : public ImagePacket
     {
     public:
         MMBuffer() {}
@@ -28,15 +46,43 @@ namespace RVN
         ~MMBuffer();
         void operator=(const RVN::MMBuffer&);
 
-        inline void set_width(int width) { this->_width = width; }
+
+        bool retain() override;
+        void release() override;
+
+    private:
+        friend class V4L2;
+
+        // the capture thread's own reference, held while the frame is
+        // passed down the pipeline
+        inline void lend() { _refs.store(1, std::memory_order_relaxed); }
+
+        V4L2* _owner = nullptr;
+        uint32_t _index = 0;
+        std::atomic<int> _refs{0};
     };
 
     using BufferVec = std::vector<MMBuffer*>;
+
     /* =======================================================================*/
-    class V4L2 : public Source<YUYVImagePacket>
+    // the luma of a compressed (MJPEG) frame, owned by the source and reused
+    // for every frame, so sinks can't retain() it
+    class DecodedFrame : public ImagePacket
     {
     public:
-        V4L2(const char*, int, int, int);
+        DecodedFrame(int width, int height) :
+            ImagePacket(alloc_aligned<uint8_t>(width*height), width*height,
+                width, PixelFormat::GREY, height) {}
+
+        ~DecodedFrame() { free_aligned(this->_data); }
+    };
+    /* =======================================================================*/
+    class V4L2 : public Source<ImagePacket>
+    {
+    public:
+        // <format> Auto picks the cheapest format the device supports, see
+        // set_pixel_format()
+        V4L2(const char*, int, int, int, PixelFormat format = PixelFormat::Auto);
         ~V4L2();
 
         bool open_stream() override;
@@ -51,18 +97,212 @@ namespace RVN
         inline int buffer_count() const { return _buffers.size(); }
 
         inline int get_fd() const { return _fd; }
+        inline const std::string& device() const { return _dev; }
 
-        bool set_hardware_crop(int left, int top, int width, int height);
-        bool set_hardware_crop(const CropWindow& win);
+        // the format actually negotiated w/ the device (once opened), note
+        // that for MJPEG sinks receive GREY frames
+        inline PixelFormat format() const { return _format; }
+
+        // capture only what's needed to cover <roi> (e.g. the union of the
+        // model's RFs, in full frame coordinates): the frame is cropped by
+        // the camera if it can do so w/o scaling, otherwise we keep the full
+        // frame. Call after open_stream() and before initialize_buffers(),
+        // sinks must then be told where their frames start, see crop()
+        bool fit_roi(const CropWindow& roi);
+
+        // change size, rate, format and / or buffer count (and the crop, see
+        // fit_roi(), a <roi> w/ no area means the full frame) w/o closing
+        // the sink: delivery pauses, the buffers are re-mapped, the sink is
+        // told about the new frames (Sink::format_changed()) and capture
+        // resumes. Stream stats restart. Not for cameras on a CaptureManager.
+        // If the sink won't release it's frames the old configuration keeps
+        // running and false is returned (the camera stays valid), any later
+        // failure leaves the camera stopped
+        bool reconfigure(int width, int height, int framerate,
+            PixelFormat format, int nbuf, const CropWindow& roi = {0, 0, 0, 0});
+
+        // the frames sinks get, as they're told by format_changed()
+        inline StreamFormat stream_format() const
+        {
+            // MJPEG frames reach them decoded to (packed) GREY
+            if (_format == PixelFormat::MJPEG)
+            {
+                return {PixelFormat::GREY, _width, _height, _width, _crop,
+                    _actual_fps};
+            }
+            return {_format, _width, _height, _stride, _crop, _actual_fps};
+        }
+
+        // hold the mean luma near <target> (of full scale) by adjusting
+        // exposure and gain while streaming, see ExposureControl, instead of
+        // the fixed exposure set from the frame rate. Set before starting
+        // the stream
+        inline void set_auto_exposure(bool on, float target = 0.45f)
+        {
+            if (_exposure_ctl != nullptr) { delete _exposure_ctl; }
+            _exposure_ctl = on ? new ExposureControl(target) : nullptr;
+        }
+
+        // the changes the controller made during the last stream, only
+        // valid once it has stopped
+        inline const std::vector<ExposureChange>* exposure_changes() const
+        {
+            return _exposure_ctl != nullptr ? &_exposure_ctl->changes() :
+                nullptr;
+        }
+
+        // the sensor's line time (us b/t the readout of one row and the
+        // next), 0 (the default) estimates it as V4L2_READOUT_FRACTION of
+        // the frame period over the full frame's rows. Frames carry the
+        // mid-exposure time of each row, see Timestamped::row_time(). Set
+        // before starting the stream
+        inline void set_line_time(float us) { _line_time_us = us; }
+
+        // the line time (s) in use, once the stream has started
+        inline float line_time() const { return _line_time; }
+
+        // time the capture stage against the frame interval, <budget> must
+        // outlive the stream
+        inline void set_budget(FrameBudget* budget) { _budget = budget; }
+
+        // the rate the device actually runs at (once opened)
+        inline float framerate() const { return _actual_fps; }
+
+        // the part of the full frame that is captured, the whole frame
+        // unless fit_roi() set a hardware crop
+        inline const CropWindow& crop() const { return _crop; }
+
+        // buffers currently dequeued from the driver (i.e. w/ the pipeline)
+        inline int buffers_held() const { return _held.load(); }
+        inline int max_buffers_held() const { return _max_held; }
+
+        // number of times every buffer was held downstream, leaving the
+        // driver nothing to capture into (so frames were dropped)
+        inline uint32_t starvation_count() const { return _starved.load(); }
+
+        // frames delivered, and frames the driver skipped (gaps in the
+        // buffer sequence numbers), only valid once the stream has stopped
+        inline uint32_t frame_count() const { return _frame_count; }
+        inline uint32_t dropped_frames() const { return _dropped; }
+
+        // only deliver the newest frame: on every wake all ready buffers are
+        // dequeued, and all but the last go straight back to the driver, so
+        // sinks never work on a backlog. Set before starting the stream
+        inline void set_latest_only(bool latest) { _latest_only = latest; }
+        inline bool latest_only() const { return _latest_only; }
+
+        // keep as few buffers in rotation as avoids drops: one is taken out
+        // after every ~2 s w/o a drop, and a drop puts one back (and sets the
+        // floor). Set before starting the stream
+        inline void set_auto_tune(bool tune) { _auto_tune = tune; }
+
+        // buffers in rotation w/ the driver and the pipeline (i.e. not set
+        // aside by the tuner)
+        inline int active_buffers() const
+        {
+            return buffer_count() - _nparked.load();
+        }
+
+        // frames that were waiting on the last wake (always 1 unless
+        // latest_only()), and how old (ms) the last frame sent downstream
+        // was when it was sent, safe to read while streaming
+        inline int queue_depth() const { return _queue_depth.load(); }
+        inline float frame_age() const { return _frame_age.load(); }
+
+        // as above, over the whole stream, only valid once it has stopped
+        inline const RunningStats& queue_depth_stats() const
+        {
+            return _depth_stats;
+        }
+        inline const RunningStats& frame_age_stats() const
+        {
+            return _age_stats;
+        }
+
+        // ms from a frame being ready (the driver's timestamp, or epoll
+        // waking us if the driver's clock isn't CLOCK_MONOTONIC) to having
+        // it dequeued, only valid once the stream has stopped
+        inline const RunningStats& dqbuf_latency() const
+        {
+            return _dqbuf_latency;
+        }
 
     private:
+        friend class MMBuffer;
+        friend class CaptureManager;
+
+        // hand <buffer> back to the driver, called from whichever thread
+        // releases the last reference to it
+        void requeue(MMBuffer* buffer);
+
+        // give buffer <index> back to the driver, or set it aside if the
+        // tuner asked for one less, returns false if the QBUF failed
+        bool queue_buffer(uint32_t index);
+
+        // put a buffer that was set aside back in rotation, returns false if
+        // there were none
+        bool unpark_buffer();
+
+        // called for every delivered frame when auto tuning
+        void tune_buffers(bool dropped);
+
+        // account for a dequeued buffer's sequence number, returns the number
+        // of frames the driver dropped just before it
+        uint32_t count_sequence(uint32_t sequence);
+
+        // the mid-exposure time of each of <frame>'s rows from it's
+        // timestamp, which is the start of exposure if <soe>, otherwise the
+        // end of the frame
+        void set_row_timing(MMBuffer* frame, bool soe);
+
         bool verify_capabilities();
+
+        // set the format, size, rate and exposure from the requested values
+        bool negotiate();
+
         bool set_pixel_format();
         bool set_framerate(int, float&);
         bool set_exposure(float);
 
+        // longest exposure (in v4l2 100us units) that leaves time for the
+        // frame rate
+        static int exposure_limit(float framerate);
+
+        float max_framerate(int width, int height);
+
+        // <win> is in (uncropped) frame pixels, fails (and leaves the frame
+        // uncropped) if the driver can't crop it 1:1
+        bool set_hardware_crop(const CropWindow& win);
+        void reset_hardware_crop();
+
+        // unmap our buffers and give the driver's back
+        void free_buffers();
+
+        bool init_events();
+        void close_events();
+
+        // queue every buffer, start streaming and open the sink, or stop
+        // streaming and close the sink. start_stream() / stop_stream() wrap
+        // these w/ our own capture thread, a CaptureManager calls them
+        // directly and captures on it's own thread instead
+        bool begin_capture(bool open_sink = true);
+        bool end_capture();
+
+        // stop (and join) our own capture thread
+        void halt_thread();
+
+        // wait (up to V4L2_RELEASE_WAIT_MS) for the sinks to release every
+        // frame they hold, false if they don't
+        bool wait_released();
+
         void stream();
 
+        // dequeue the frame the driver signaled (at <t_ready>) as ready,
+        // stamp it using <clock> and pass it to the sink. Returns false on
+        // an error, described by <err_msg>
+        bool dequeue(const Clock& clock, const timespec& t_ready,
+            std::string& err_msg);
+
         inline void set_error_msg(const std::string& msg)
         {
             if (isvalid())
@@ -97,11 +337,76 @@ namespace RVN
         int _height;
         int _framerate;
 
+        PixelFormat _format;
+
+        // bytes per row (of the luma plane for planar formats)
+        int _stride = 0;
+
+        CropWindow _crop = {0, 0, 0, 0};
+
+        // rows of the uncropped frame
+        int _full_height = 0;
+
+        // the fixed exposure (v4l2 100us units) w/o auto exposure
+        int _exposure_time = 0;
+
+        float _line_time_us = 0.0f;
+        float _line_time = 0.0f;
+
+        // between begin_capture() and end_capture(), read by requeue() on
+        // the sinks' threads
+        std::atomic<bool> _capturing{false};
+
+        float _actual_fps = 0.0f;
+
+        FrameBudget* _budget = nullptr;
+
+        ExposureControl* _exposure_ctl = nullptr;
+
+        // MJPEG only
+        JpegDecoder* _jpeg = nullptr;
+        DecodedFrame* _decoded = nullptr;
+        uint32_t _decode_errors = 0;
+
         bool _isvalid;
         std::string _err_msg;
 
         BufferVec _buffers;
 
+        std::atomic<int> _held{0};
+        int _max_held = 0;
+        std::atomic<uint32_t> _starved{0};
+        std::atomic<uint32_t> _requeue_errors{0};
+
+        // the stream thread sleeps on epoll, w/ <_stop_fd> (an eventfd) to
+        // wake it for shutdown
+        int _epoll_fd = -1;
+        int _stop_fd = -1;
+
+        RunningStats _dqbuf_latency;
+        uint32_t _frame_count = 0;
+        uint32_t _dropped = 0;
+        uint32_t _last_sequence = 0;
+        bool _sequenced = false;
+
+        bool _latest_only = false;
+        uint32_t _skipped = 0;
+
+        std::atomic<int> _queue_depth{0};
+        std::atomic<float> _frame_age{0.0f};
+        RunningStats _depth_stats;
+        RunningStats _age_stats;
+
+        // buffers the tuner has set aside (w/ _parked_busy as it's lock, as
+        // sinks requeue from their own threads), and how many more it wants
+        bool _auto_tune = false;
+        std::vector<uint32_t> _parked;
+        std::atomic_flag _parked_busy = ATOMIC_FLAG_INIT;
+        std::atomic<int> _nparked{0};
+        std::atomic<int> _to_park{0};
+        uint32_t _clean_frames = 0;
+        int _tune_floor = 2;
+
         std::atomic_flag _state_continue = ATOMIC_FLAG_INIT;
         std::thread _stream_thread;
     };
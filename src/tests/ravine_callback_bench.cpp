@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include "ravine_simd.hpp"
+#include "ravine_packets.hpp"
+#include "ravine_voice_pool.hpp"
+#include "ravine_pink_noise.hpp"
+#include "ravine_spike_waveform.hpp"
+#include "ravine_spike_scheduler.hpp"
+
+#define SAMPLE_RATE 24000
+#define NFRAMES 1024
+
+/* ========================================================================= */
+typedef std::chrono::steady_clock steady_clock;
+
+double elapsed_us(steady_clock::time_point t0)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        steady_clock::now() - t0).count() / 1000.0;
+}
+/* ------------------------------------------------------------------------- */
+// mean, 99.9th percentile and max of <us>
+void report(const char* name, float rate, std::vector<double>& us)
+{
+    double total = 0.0;
+    for (double x : us) { total += x; }
+
+    std::sort(us.begin(), us.end());
+
+    printf("[BENCH]: %-9s %4.0f Hz: mean %6.2f, p99.9 %6.2f, max %7.2f us "
+        "/ callback\n", name, rate, total / us.size(),
+        us[(size_t)(0.999 * (us.size() - 1))], us.back());
+}
+/* ------------------------------------------------------------------------- */
+// spike times (s) of a Poisson process at <rate> Hz over <seconds>
+std::vector<double> poisson_times(float rate, double seconds)
+{
+    std::vector<double> times;
+    if (rate <= 0.0f) { return times; }
+
+    double t = 0.0;
+    while (true)
+    {
+        t -= log((rand() + 1.0) / (RAND_MAX + 1.0)) / rate;
+        if (t >= seconds) { break; }
+
+        times.push_back(t);
+    }
+
+    return times;
+}
+/* ========================================================================= */
+int main(int narg, const char** args)
+{
+    // usage: ravine_callback_bench [nblocks]
+    const int nblocks = narg > 1 ? std::atoi(args[1]) : 20000;
+
+    const double buffer = (double)NFRAMES / SAMPLE_RATE;
+
+    int status = 0;
+
+    RVN::WaveForm wf("./spike.wf");
+    if (!wf.isvalid())
+    {
+        printf("[ERROR]: failed to load ./spike.wf\n");
+        return -1;
+    }
+
+    // a block of noise is the same as that many samples, seeking to a
+    // sample gives the same noise from there on (also across the counter's
+    // 32 bit boundary) and different seeds give different noise
+    {
+        const uint64_t seed = 12345;
+        const int n = 100000;
+
+        RVN::PinkNoise a(16, 0.3f, seed), b(16, 0.3f, seed);
+
+        std::vector<float> x(n), y(n);
+        for (float& v : x) { v = a.next_sample(); }
+        for (int k = 0; k < n; k += 1000) { b.fill(y.data() + k, 1000); }
+
+        double err = 0.0;
+        for (int k = 0; k < n; ++k) { err = RVN_MAX(err, fabs(x[k] - y[k])); }
+
+        RVN::PinkNoise c(16, 0.3f, seed);
+        c.seek(54321);
+        c.fill(y.data(), n - 54321);
+
+        double seek_err = 0.0;
+        for (int k = 54321; k < n; ++k)
+        {
+            seek_err = RVN_MAX(seek_err, fabs(x[k] - y[k - 54321]));
+        }
+
+        RVN::PinkNoise d(16, 0.3f, seed), e(16, 0.3f, seed);
+        d.seek((1ULL << 32) - 70000);
+        e.seek((1ULL << 32) - 300);
+        for (int k = 0; k < 70000 - 300; ++k) { (void)d.next_sample(); }
+        for (int k = 0; k < 1000; ++k)
+        {
+            const float v = d.next_sample();
+            e.fill(y.data(), 1);
+            seek_err = RVN_MAX(seek_err, fabs(v - y[0]));
+        }
+
+        RVN::PinkNoise f(16, 0.3f, seed + 1);
+        f.fill(y.data(), n);
+
+        int same = 0;
+        for (int k = 0; k < n; ++k) { same += x[k] == y[k]; }
+
+        printf("[TEST]: noise: block vs per sample max err %g, seek max err "
+            "%g, %d of %d samples equal w/ another seed\n", err, seek_err,
+            same, n);
+
+        if (err > 0.0 || seek_err > 0.0 || same > n / 100)
+        {
+            printf("[ERROR]: noise mismatch\n");
+            status = -1;
+        }
+
+        // cost per sample
+        const int reps = 200;
+        auto t0 = steady_clock::now();
+        volatile float sink = 0.0f;
+        for (int r = 0; r < reps; ++r)
+        {
+            for (int k = 0; k < NFRAMES; ++k) { sink += a.next_sample(); }
+        }
+        const double per_sample = elapsed_us(t0) * 1000.0 / (reps * NFRAMES);
+
+        t0 = steady_clock::now();
+        for (int r = 0; r < reps; ++r)
+        {
+            b.fill(y.data(), NFRAMES);
+            sink += y[r];
+        }
+        const double per_block = elapsed_us(t0) * 1000.0 / (reps * NFRAMES);
+
+        printf("[BENCH]: noise: %.2f ns / sample one at a time, %.2f ns / "
+            "sample in blocks (%s)\n", per_sample, per_block,
+            RVN::simd_name());
+    }
+
+    // callbacks at several firing rates, before (per sample, w/ an atomic
+    // flag and one waveform) and after (per block, scheduler + voices)
+    const float rates[] = {0.0f, 100.0f, 400.0f};
+
+    for (float rate : rates)
+    {
+        const std::vector<double> times = poisson_times(rate,
+            nblocks * buffer);
+
+        std::vector<float> out(NFRAMES);
+        std::vector<double> us(nblocks);
+
+        // before
+        {
+            RVN::PinkNoise noise(16, 0.3f);
+            std::vector<float> data(wf.data(), wf.data() + wf.length());
+            RVN::WaveForm waveform(data.data(), data.size());
+
+            std::atomic_flag no_spike = ATOMIC_FLAG_INIT;
+            no_spike.test_and_set();
+
+            bool isspiking = false;
+            size_t next = 0;
+
+            for (int b = 0; b < nblocks; ++b)
+            {
+                // the spikes of this block set the flag (once) up front
+                if (next < times.size() && times[next] < (b + 1) * buffer)
+                {
+                    no_spike.clear();
+                    while (next < times.size() &&
+                        times[next] < (b + 1) * buffer) { ++next; }
+                }
+
+                auto t0 = steady_clock::now();
+
+                for (int k = 0; k < NFRAMES; ++k)
+                {
+                    if (!no_spike.test_and_set()) { isspiking = true; }
+
+                    if (isspiking)
+                    {
+                        out[k] = waveform.next_sample(isspiking);
+                    }
+                    else
+                    {
+                        out[k] = noise.next_sample();
+                    }
+                }
+
+                us[b] = elapsed_us(t0);
+            }
+
+            report("per-sample", rate, us);
+        }
+
+        // after
+        {
+            RVN::PinkNoise noise(16, 0.3f);
+            RVN::VoicePool voices(wf.data(), wf.length(), 256, NFRAMES);
+            (void)voices.set_max_voices(32);
+            RVN::SpikeScheduler scheduler(SAMPLE_RATE, 0.0f);
+
+            size_t next = 0;
+
+            for (int b = 0; b < nblocks; ++b)
+            {
+                while (next < times.size() && times[next] < (b + 1) * buffer)
+                {
+                    RVN::Spike spike = {times[next], 0};
+                    (void)scheduler.push(&spike, 1);
+                    ++next;
+                }
+
+                auto t0 = steady_clock::now();
+
+                const int* onsets;
+                const int nonsets = scheduler.schedule(b * buffer, NFRAMES,
+                    onsets);
+
+                noise.fill(out.data(), NFRAMES);
+                voices.render(onsets, nonsets, out.data(), NFRAMES);
+
+                us[b] = elapsed_us(t0);
+            }
+
+            report("per-block", rate, us);
+        }
+    }
+
+    printf("[TEST]: %s\n", status == 0 ? "PASSED" : "FAILED");
+
+    return status;
+}
@@ -0,0 +1,187 @@
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include "ravine_simd.hpp"
+#include "ravine_packets.hpp"
+#include "ravine_receptive_field.hpp"
+
+/* ========================================================================= */
+// NeuronFilter::filter()'s float path
+float float_filter(const RVN::ImagePacket& packet, RVN::length_t bytes,
+    const RVN::ReceptiveField& rf, int col, int row)
+{
+    float xy, frame_mag;
+    float frame_mean = RVN::luma_mean(&packet, bytes);
+
+    rf.correlate(&packet, bytes, col, row, frame_mean, xy, frame_mag);
+
+    const float mx = RVN_MAX(rf.mag(), frame_mag);
+    return xy / mx / sqrt(RVN_MIN(rf.mag(), frame_mag) / mx);
+}
+/* ------------------------------------------------------------------------- */
+// and it's fixed point path
+float fixed_filter(const RVN::ImagePacket& packet, RVN::length_t bytes,
+    const RVN::ReceptiveField& rf, int col, int row)
+{
+    return rf.correlate_fixed(&packet, bytes, col, row,
+        RVN::luma_mean(&packet, bytes));
+}
+/* ------------------------------------------------------------------------- */
+template <class F>
+double ns_per_call(F fn, int niter)
+{
+    volatile float sink = 0.0f;
+
+    auto t1 = std::chrono::steady_clock::now();
+    for (int k = 0; k < niter; ++k) { sink = fn(); }
+    auto t2 = std::chrono::steady_clock::now();
+
+    (void)sink;
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count()
+        / (double)niter;
+}
+/* ------------------------------------------------------------------------- */
+// a repeatable frame: noise, or noise over a smooth pattern so that the RFs
+// see some structure (and responses far from 0)
+void fill_frame(std::vector<uint8_t>& data, int width, int height, int step,
+    bool pattern)
+{
+    srand(1);
+    for (size_t k = 0; k < data.size(); ++k) { data[k] = rand() & 0xff; }
+
+    if (!pattern) { return; }
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const float v = 128.0f + 100.0f * sin(x * 0.05f) * cos(y * 0.07f);
+            const size_t idx = ((size_t)y * width + x) * step;
+            data[idx] = (uint8_t)RVN_MIN(RVN_MAX(v + (rand() % 31) - 15,
+                0.0f), 255.0f);
+        }
+    }
+}
+/* ========================================================================= */
+int main(int narg, const char** args)
+{
+    // usage: ravine_fixed_point_test [niter] [rf files...]
+    int niter = narg > 1 ? std::atoi(args[1]) : 500;
+
+    std::vector<std::string> files;
+    for (int k = 2; k < narg; ++k) { files.push_back(args[k]); }
+
+    if (files.empty())
+    {
+        for (int k = 1; k <= 5; ++k)
+        {
+            files.push_back("./rf/rf-0" + std::to_string(k) + ".pgm");
+        }
+    }
+
+    const int sizes[][2] = {{320, 240}, {640, 480}};
+    const RVN::PixelFormat formats[] = {RVN::PixelFormat::YUYV,
+        RVN::PixelFormat::GREY};
+
+    printf("[TEST]: fixed point vs float correlation, kernel: %s\n",
+        RVN::simd_name());
+
+    int status = 0;
+
+    for (size_t f = 0; f < files.size(); ++f)
+    {
+        RVN::ReceptiveField rf;
+        if (!rf.load(files[f].c_str()))
+        {
+            printf("[ERROR]: failed to load %s\n", files[f].c_str());
+            status = -1;
+            continue;
+        }
+
+        for (const auto& sz : sizes)
+        {
+            const int width = sz[0];
+            const int height = sz[1];
+
+            if (rf.width() > width || rf.height() > height) { continue; }
+
+            for (RVN::PixelFormat fmt : formats)
+            {
+                const int step = fmt == RVN::PixelFormat::YUYV ? 2 : 1;
+                const RVN::length_t bytes = width * height * step;
+
+                std::vector<uint8_t> data(bytes);
+
+                // centered, both corners (the bottom right one hanging off
+                // the frame) and centered in a frame cut short
+                const int pos[][2] = {
+                    {(width - rf.width()) / 2, (height - rf.height()) / 2},
+                    {0, 0},
+                    {width - rf.width() / 2, height - rf.height() / 2},
+                    {(width - rf.width()) / 2, (height - rf.height()) / 2}
+                };
+
+                float err = 0.0f;
+                float max_act = 0.0f;
+
+                for (int pattern = 0; pattern < 2; ++pattern)
+                {
+                    fill_frame(data, width, height, step, pattern == 1);
+
+                    RVN::ImagePacket packet(data.data(), bytes, width, fmt,
+                        height);
+
+                    for (int p = 0; p < 4; ++p)
+                    {
+                        const RVN::length_t used = p == 3 ?
+                            bytes - (height / 3) * width * step - 7 : bytes;
+
+                        const float a = float_filter(packet, used, rf,
+                            pos[p][0], pos[p][1]);
+                        const float b = fixed_filter(packet, used, rf,
+                            pos[p][0], pos[p][1]);
+
+                        err = RVN_MAX(err, (float)fabs(a - b));
+                        max_act = RVN_MAX(max_act, (float)fabs(a));
+                    }
+                }
+
+                RVN::ImagePacket packet(data.data(), bytes, width, fmt, height);
+
+                const int col = pos[0][0];
+                const int row = pos[0][1];
+
+                const double t_float = ns_per_call(
+                    [&]() { return float_filter(packet, bytes, rf, col, row); },
+                    niter
+                );
+                const double t_fixed = ns_per_call(
+                    [&]() { return fixed_filter(packet, bytes, rf, col, row); },
+                    niter
+                );
+
+                printf("    %s (%d x %d) in %d x %d %s: float %.0f ns | fixed "
+                    "%.0f ns | x%.2f | max |act| %.3f, err %g\n",
+                    files[f].c_str(), rf.width(), rf.height(), width, height,
+                    RVN::format_name(fmt), t_float, t_fixed, t_float / t_fixed,
+                    max_act, err);
+
+                if (!(err <= 1e-4f))
+                {
+                    printf("[ERROR]: fixed point mismatch for %s\n",
+                        files[f].c_str());
+                    status = -1;
+                }
+            }
+        }
+    }
+
+    printf("[TEST]: %s\n", status == 0 ? "PASSED" : "FAILED");
+
+    return status;
+}
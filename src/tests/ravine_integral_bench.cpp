@@ -0,0 +1,203 @@
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include "ravine_simd.hpp"
+#include "ravine_packets.hpp"
+#include "ravine_integral_image.hpp"
+#include "ravine_receptive_field.hpp"
+
+/* ========================================================================= */
+// the luma at (x, y), or -1 if it lies at or past <bytes>
+int pixel(const RVN::ImagePacket& packet, RVN::length_t bytes, int x, int y)
+{
+    const RVN::length_t idx = y * packet.luma_stride() + x * packet.luma_step();
+    return idx < packet.luma_bytes(bytes) ? packet.luma()[idx] : -1;
+}
+/* ------------------------------------------------------------------------- */
+// brute force sum, sum of squares and count over <win>
+void window_sums(const RVN::ImagePacket& packet, RVN::length_t bytes,
+    const RVN::CropWindow& win, uint64_t& s, uint64_t& s2, uint32_t& n)
+{
+    s = s2 = 0;
+    n = 0;
+
+    for (int y = RVN_MAX(win.row, 0);
+        y < RVN_MIN(win.row + win.height, packet.height()); ++y)
+    {
+        for (int x = RVN_MAX(win.col, 0);
+            x < RVN_MIN(win.col + win.width, packet.width()); ++x)
+        {
+            const int v = pixel(packet, bytes, x, y);
+            if (v < 0) { continue; }
+
+            s += v;
+            s2 += v * v;
+            ++n;
+        }
+    }
+}
+/* ------------------------------------------------------------------------- */
+// the box DoG correlated pixel by pixel, normalized as NeuronFilter does
+float brute_dog(const RVN::ImagePacket& packet, RVN::length_t bytes,
+    const RVN::CropWindow& center, const RVN::CropWindow& surround,
+    double offset)
+{
+    uint64_t sc, ss, tmp;
+    uint32_t nc, ns;
+    window_sums(packet, bytes, center, sc, tmp, nc);
+    window_sums(packet, bytes, surround, ss, tmp, ns);
+
+    if (nc < 1 || ns <= nc) { return 0.0f; }
+
+    double xy = 0.0, kmag = 0.0, energy = 0.0;
+
+    for (int y = surround.row; y < surround.row + surround.height; ++y)
+    {
+        for (int x = surround.col; x < surround.col + surround.width; ++x)
+        {
+            if (x >= packet.width() || y >= packet.height()) { continue; }
+
+            const int v = pixel(packet, bytes, x, y);
+            if (v < 0) { continue; }
+
+            const bool in_center = x >= center.col && y >= center.row &&
+                x < center.col + center.width && y < center.row + center.height;
+
+            const double k = (in_center ? 1.0 / nc : 0.0) - 1.0 / ns;
+
+            xy += k * (v - offset);
+            kmag += k * k;
+            energy += (v - offset) * (v - offset);
+        }
+    }
+
+    return (float)(xy / sqrt(kmag * energy));
+}
+/* ------------------------------------------------------------------------- */
+template <class F>
+double us_per_call(F fn, int niter)
+{
+    auto t1 = std::chrono::steady_clock::now();
+    for (int k = 0; k < niter; ++k) { fn(); }
+    auto t2 = std::chrono::steady_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count()
+        / (1000.0 * niter);
+}
+/* ========================================================================= */
+int main(int narg, const char** args)
+{
+    // usage: ravine_integral_bench [niter]
+    int niter = narg > 1 ? std::atoi(args[1]) : 200;
+
+    const int sizes[][2] = {{320, 240}, {640, 480}};
+    const RVN::PixelFormat formats[] = {RVN::PixelFormat::YUYV,
+        RVN::PixelFormat::GREY};
+
+    printf("[BENCH]: integral image, %d iterations, kernel: %s\n", niter,
+        RVN::simd_name());
+
+    int status = 0;
+
+    for (const auto& sz : sizes)
+    {
+        const int width = sz[0];
+        const int height = sz[1];
+
+        for (RVN::PixelFormat fmt : formats)
+        {
+            const int step = fmt == RVN::PixelFormat::YUYV ? 2 : 1;
+            const RVN::length_t bytes = width * height * step;
+
+            // a random (but repeatable) frame
+            std::vector<uint8_t> data(bytes);
+
+            srand(1);
+            for (int k = 0; k < bytes; ++k) { data[k] = rand() & 0xff; }
+
+            RVN::ImagePacket packet(data.data(), bytes, width, fmt, height);
+
+            RVN::IntegralImage ii;
+
+            // the whole frame, and one cut short partway along a row
+            const RVN::length_t used[] = {bytes,
+                bytes - (height / 3) * width * step - 7 * step};
+
+            uint64_t err_sum = 0;
+            float err_mean = 0.0f, err_dog = 0.0f;
+
+            for (RVN::length_t b : used)
+            {
+                ii.build(&packet, b);
+
+                err_mean = RVN_MAX(err_mean,
+                    (float)fabs(ii.frame_mean() - RVN::luma_mean(&packet, b)));
+
+                for (int k = 0; k < 200; ++k)
+                {
+                    // some hang off the right / bottom edge
+                    const int w = 1 + rand() % 96;
+                    const int h = 1 + rand() % 96;
+                    const RVN::CropWindow win = {rand() % width,
+                        rand() % height, w, h};
+
+                    uint64_t s, s2;
+                    uint32_t n;
+                    window_sums(packet, b, win, s, s2, n);
+
+                    err_sum = RVN_MAX(err_sum, (uint64_t)
+                        (llabs((long long)(s - ii.sum(win))) +
+                        llabs((long long)(s2 - ii.sum2(win))) +
+                        llabs((long long)n - (long long)ii.count(win))));
+
+                    // a center-surround cell w/ it's center in the middle
+                    const int c = RVN_MAX(w / 3, 1);
+                    const RVN::CropWindow center = {win.col + (w - c) / 2,
+                        win.row + (w - c) / 2, c, c};
+                    const RVN::CropWindow surround = {win.col, win.row, w, w};
+
+                    err_dog = RVN_MAX(err_dog, (float)fabs(
+                        ii.box_dog(center, surround, ii.frame_mean()) -
+                        brute_dog(packet, b, center, surround,
+                            ii.frame_mean())));
+                }
+            }
+
+            const double t_build = us_per_call(
+                [&]() { ii.build(&packet, bytes); }, niter);
+
+            volatile double sink = 0.0;
+
+            const double t_mean = us_per_call(
+                [&]() { sink = RVN::luma_mean(&packet, bytes); }, niter);
+
+            // a population's worth of center-surround cells
+            const double t_dog = us_per_call(
+                [&]() {
+                    for (int k = 0; k < 1000; ++k)
+                    {
+                        const int x = (k * 37) % (width - 48);
+                        const int y = (k * 53) % (height - 48);
+                        sink = ii.box_dog({x + 16, y + 16, 16, 16},
+                            {x, y, 48, 48}, 128.0);
+                    }
+                }, niter);
+
+            printf("    %d x %d %s: build %.1f us (mean alone %.1f us) | "
+                "1000 box DoGs %.1f us | err sums %llu, mean %g, dog %g\n",
+                width, height, RVN::format_name(fmt), t_build, t_mean, t_dog,
+                (unsigned long long)err_sum, err_mean, err_dog);
+
+            if (err_sum != 0 || err_mean > 1e-9f || err_dog > 1e-4f)
+            {
+                printf("[ERROR]: integral image mismatch\n");
+                status = -1;
+            }
+        }
+    }
+
+    return status;
+}
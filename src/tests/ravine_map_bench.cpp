@@ -0,0 +1,206 @@
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include "ravine_simd.hpp"
+#include "ravine_packets.hpp"
+#include "ravine_receptive_field.hpp"
+#include "ravine_correlation_map.hpp"
+
+/* ========================================================================= */
+// the luma of <packet> minus the frame mean, as ResponseMapFilter does it
+void extract_luma(const RVN::ImagePacket& packet, RVN::length_t bytes,
+    int height, std::vector<float>& luma)
+{
+    const int width = packet.width();
+    const float frame_mean = RVN::luma_mean(&packet, bytes);
+
+    luma.assign(width * height, 0.0f);
+    for (int k = 0; k < height; ++k)
+    {
+        RVN::luma_row(packet.luma() + k * packet.luma_stride(),
+            packet.luma_step(), width, frame_mean, luma.data() + k * width);
+    }
+}
+/* ------------------------------------------------------------------------- */
+// what a single NeuronFilter w/ it's window at (col, row) would report
+float neuron_act(const RVN::ImagePacket& packet, RVN::length_t bytes,
+    const RVN::ReceptiveField& rf, int col, int row)
+{
+    float xy, frame_mag;
+    float frame_mean = RVN::luma_mean(&packet, bytes);
+
+    rf.correlate(&packet, bytes, col, row, frame_mean, xy, frame_mag);
+
+    const float mx = RVN_MAX(rf.mag(), frame_mag);
+    return xy / mx / sqrt(RVN_MIN(rf.mag(), frame_mag) / mx);
+}
+/* ------------------------------------------------------------------------- */
+double ms_per_frame(RVN::CorrelationMap& map, const std::vector<float>& luma,
+    int stride, std::vector<float>& out, int niter)
+{
+    auto t1 = std::chrono::steady_clock::now();
+    for (int k = 0; k < niter; ++k)
+    {
+        map.compute(luma.data(), stride, out.data());
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()
+        / (1000.0 * niter);
+}
+/* ------------------------------------------------------------------------- */
+float max_error(const std::vector<float>& a, const std::vector<float>& b)
+{
+    float err = 0.0f;
+    for (size_t k = 0; k < a.size(); ++k)
+    {
+        err = RVN_MAX(err, (float)fabs(a[k] - b[k]));
+    }
+    return err;
+}
+/* ========================================================================= */
+int main(int narg, const char** args)
+{
+    // usage: ravine_map_bench [niter] [step] [tolerance] [rf files...]
+    int niter = narg > 1 ? std::atoi(args[1]) : 10;
+    int step = narg > 2 ? std::atoi(args[2]) : 1;
+    float tolerance = narg > 3 ? std::atof(args[3]) : 0.05f;
+
+    std::vector<std::string> files;
+    for (int k = 4; k < narg; ++k) { files.push_back(args[k]); }
+
+    if (files.empty())
+    {
+        for (int k = 1; k <= 5; ++k)
+        {
+            files.push_back("./rf/rf-0" + std::to_string(k) + ".pgm");
+        }
+    }
+
+    const int sizes[][2] = {{320, 240}, {640, 480}};
+
+    printf("[BENCH]: step %d, %d iterations, separable w/in %.1f%%, "
+        "kernel: %s\n", step, niter, 100.0f * tolerance, RVN::simd_name());
+
+    int status = 0;
+
+    for (const auto& sz : sizes)
+    {
+        const int width = sz[0];
+        const int height = sz[1];
+
+        // a random (but repeatable) YUYV frame
+        const RVN::length_t bytes = width * height * 2;
+        std::vector<uint8_t> data(bytes);
+
+        srand(1);
+        for (int k = 0; k < bytes; ++k) { data[k] = rand() & 0xff; }
+
+        RVN::ImagePacket packet(data.data(), bytes, width);
+
+        std::vector<float> luma;
+        extract_luma(packet, bytes, height, luma);
+
+        printf("[BENCH]: %d x %d frame\n", width, height);
+
+        for (size_t k = 0; k < files.size(); ++k)
+        {
+            RVN::ReceptiveField rf;
+            if (!rf.load(files[k].c_str(), tolerance))
+            {
+                printf("[ERROR]: failed to load %s\n", files[k].c_str());
+                status = -1;
+                continue;
+            }
+
+            RVN::CorrelationMap direct(rf, width, height, step,
+                RVN::MapMethod::Direct);
+            RVN::CorrelationMap fft(rf, width, height, step,
+                RVN::MapMethod::FFT);
+            RVN::CorrelationMap automatic(rf, width, height, step);
+
+            if (!direct.isvalid())
+            {
+                printf("[ERROR]: %s does not fit the frame\n", files[k].c_str());
+                status = -1;
+                continue;
+            }
+
+            const int mw = direct.map_width();
+            const int mh = direct.map_height();
+
+            std::vector<float> out_direct(mw * mh);
+            std::vector<float> out_fft(mw * mh);
+
+            double t_direct = ms_per_frame(direct, luma, width, out_direct,
+                niter);
+            double t_fft = ms_per_frame(fft, luma, width, out_fft, niter);
+
+            // the map must agree w/ a NeuronFilter placed at a few positions
+            float err_neuron = 0.0f;
+            for (int y = 0; y < mh; y += RVN_MAX(mh / 7, 1))
+            {
+                for (int x = 0; x < mw; x += RVN_MAX(mw / 7, 1))
+                {
+                    const float act = neuron_act(packet, bytes, rf, x * step,
+                        y * step);
+                    err_neuron = RVN_MAX(err_neuron,
+                        (float)fabs(act - out_direct[y * mw + x]));
+                }
+            }
+
+            const float err_fft = max_error(out_direct, out_fft);
+
+            // w/ the normalization of NeuronFilter an RF that is off by
+            // <tolerance> (relative 2-norm) moves no activation further
+            // than that (Cauchy-Schwarz)
+            double t_sep = 0.0;
+            float err_sep = 0.0f;
+
+            if (rf.rank() > 0)
+            {
+                RVN::CorrelationMap separable(rf, width, height, step,
+                    RVN::MapMethod::Separable);
+
+                std::vector<float> out_sep(mw * mh);
+                t_sep = ms_per_frame(separable, luma, width, out_sep, niter);
+                err_sep = max_error(out_direct, out_sep);
+
+                printf("    %s: rank %d (%.2f%% error) separable %.2f ms "
+                    "(%.0f fps) | x%.1f vs the best of direct / fft (est. "
+                    "x%.1f) | max act err %g\n", files[k].c_str(), rf.rank(),
+                    100.0f * rf.rank_error(), t_sep, 1000.0 / t_sep,
+                    RVN_MIN(t_direct, t_fft) / t_sep,
+                    separable.separable_gain(), err_sep);
+            }
+
+            // what auto should have picked, on this machine
+            RVN::MapMethod fastest = t_direct < t_fft ? RVN::MapMethod::Direct :
+                RVN::MapMethod::FFT;
+            if (rf.rank() > 0 && t_sep < RVN_MIN(t_direct, t_fft))
+            {
+                fastest = RVN::MapMethod::Separable;
+            }
+
+            printf("    %s (%d x %d) -> %d x %d: direct %.2f ms (%.0f fps) | "
+                "fft %.2f ms (%.0f fps) | auto: %s (fastest: %s) | err neuron "
+                "%g, fft %g\n", files[k].c_str(), rf.width(), rf.height(), mw,
+                mh, t_direct, 1000.0 / t_direct, t_fft, 1000.0 / t_fft,
+                RVN::method_name(automatic.method()),
+                RVN::method_name(fastest), err_neuron, err_fft);
+
+            if (err_neuron > 1e-4f || err_fft > 1e-3f ||
+                err_sep > rf.rank_error() + 1e-4f)
+            {
+                printf("[ERROR]: map mismatch for %s\n", files[k].c_str());
+                status = -1;
+            }
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,142 @@
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include "ravine_clock.hpp"
+#include "ravine_stats.hpp"
+#include "ravine_utils.hpp"
+#include "ravine_packets.hpp"
+#include "ravine_base_sink.hpp"
+#include "ravine_neuron_filter.hpp"
+#include "ravine_video_source.hpp"
+#include "ravine_capture_manager.hpp"
+
+#define FRAMERATE 30
+
+#define WIDTH 320
+#define HEIGHT 240
+
+#define LEFT 96
+#define TOP  56
+
+/* ========================================================================= */
+// the end of a camera's pipeline: counts spikes and how long after capture
+// they arrive
+class SpikeCounter : public RVN::Sink<RVN::SpikeBatch>
+{
+public:
+    bool open_stream() override { return true; }
+    bool close_stream() override { return true; }
+
+    void process(RVN::SpikeBatch* packet, RVN::length_t) override
+    {
+        if (packet->timestamp() >= 0.0)
+        {
+            latency.add(_clock.now() - packet->timestamp());
+        }
+        spikes += packet->size();
+    }
+
+    long spikes = 0;
+
+    RVN::RunningStats latency;
+
+private:
+    RVN::Clock _clock;
+};
+/* ========================================================================= */
+int main(int narg, const char** args)
+{
+    // usage: ravine_multicam_test [seconds] [devices...]
+    const int seconds = narg > 1 ? std::atoi(args[1]) : 10;
+
+    std::vector<std::string> devs;
+    for (int k = 2; k < narg; ++k) { devs.push_back(args[k]); }
+
+    if (devs.empty()) { devs.push_back("/dev/video0"); }
+
+    const int ncam = devs.size();
+
+    std::vector<RVN::V4L2*> cameras;
+    std::vector<RVN::NeuronFilter*> neurons;
+    std::vector<SpikeCounter*> counters;
+
+    RVN::CaptureManager manager;
+
+    int status = 0;
+
+    for (int k = 0; k < ncam && status == 0; ++k)
+    {
+        RVN::V4L2* cam = new RVN::V4L2(devs[k].c_str(), WIDTH, HEIGHT,
+            FRAMERATE);
+        cameras.push_back(cam);
+
+        RVN::NeuronFilter* neuron = new RVN::NeuronFilter("./rf/rf-05.pgm",
+            LEFT, TOP, 8);
+        neurons.push_back(neuron);
+
+        SpikeCounter* counter = new SpikeCounter();
+        counters.push_back(counter);
+
+        if (!cam->open_stream() || !cam->initialize_buffers(4))
+        {
+            printf("[ERROR]: failed to open %s\n", devs[k].c_str());
+            printf("[MSG]: %s\n", cam->get_error_msg().c_str());
+            status = -1;
+        }
+        else if (!neuron->isvalid())
+        {
+            printf("[ERROR]: failed to initialize neuron filter\n");
+            printf("[MSG]: %s\n", neuron->get_error_msg().c_str());
+            status = -1;
+        }
+        else
+        {
+            // one pipeline per camera
+            neuron->register_sink(counter);
+            cam->register_sink(neuron);
+            manager.add_camera(cam);
+        }
+    }
+
+    if (status == 0)
+    {
+        if (!manager.start_stream())
+        {
+            printf("[ERROR]: failed to start stream\n");
+            printf("[MSG]: %s\n", manager.get_error_msg().c_str());
+            status = -1;
+        }
+        else
+        {
+            RVN::sleep_ms(seconds * 1000);
+        }
+
+        if (!manager.stop_stream())
+        {
+            printf("[ERROR]: error during streaming\n");
+            printf("[MSG]: %s\n", manager.get_error_msg().c_str());
+            status = -1;
+        }
+
+        for (int k = 0; k < ncam; ++k)
+        {
+            const RVN::RunningStats& lat = counters[k]->latency;
+            printf("[MULTICAM]: %s: %ld spikes, capture -> spike %.2f ms "
+                "(max %.2f)\n", devs[k].c_str(), counters[k]->spikes,
+                lat.mean() * 1e3, lat.max() * 1e3);
+        }
+    }
+
+    for (int k = 0; k < (int)cameras.size(); ++k)
+    {
+        cameras[k]->close_stream();
+
+        delete neurons[k];
+        delete counters[k];
+        delete cameras[k];
+    }
+
+    return status;
+}
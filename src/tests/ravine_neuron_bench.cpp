@@ -0,0 +1,234 @@
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include "ravine_simd.hpp"
+#include "ravine_packets.hpp"
+#include "ravine_receptive_field.hpp"
+
+#define WIDTH 320
+#define HEIGHT 240
+
+/* ========================================================================= */
+// the original (pre-SIMD) NeuronFilter::filter(), kept as the reference but
+// w/ the frame mean over the luma only (it used to average in the chroma)
+float reference_filter(const RVN::ImagePacket& packet, RVN::length_t bytes,
+    const RVN::CropWindow& win, const RVN::ReceptiveField& rf)
+{
+    int32_t inc = 0;
+
+    float frame_mag = 0.0f;
+    float xy = 0.0f;
+    float yi;
+
+    const int row_length = packet.width() * 2;
+    const uint8_t* data_in = packet.data();
+
+    float frame_mean = 0.0f;
+    for (int k = 0; k < bytes; k += 2) { frame_mean += data_in[k]; }
+    frame_mean /= bytes / 2;
+
+    const int first_col = win.col * 2;
+    const int last_col = first_col + (win.width*2);
+    const int last_row = win.row + win.height;
+
+    for (int k = win.row; k < last_row; ++k)
+    {
+        for (int j = first_col; j < last_col; j+=2, ++inc)
+        {
+            int32_t idx = k * row_length + j;
+            if (idx < bytes)
+            {
+                yi = ((float)data_in[idx]) - frame_mean;
+                frame_mag += yi*yi;
+                xy += yi * (((float)rf.raw()[inc]) - rf.mean());
+            }
+        }
+    }
+
+    const float mx = RVN_MAX(rf.mag(), frame_mag);
+    return xy / mx / sqrt(RVN_MIN(rf.mag(), frame_mag) / mx);
+}
+/* ------------------------------------------------------------------------- */
+// what NeuronFilter::filter() does now
+float simd_filter(const RVN::ImagePacket& packet, RVN::length_t bytes,
+    const RVN::CropWindow& win, const RVN::ReceptiveField& rf)
+{
+    float xy, frame_mag;
+    float frame_mean = RVN::luma_mean(&packet, bytes);
+
+    rf.correlate(&packet, bytes, win.col, win.row, frame_mean, xy, frame_mag);
+
+    const float mx = RVN_MAX(rf.mag(), frame_mag);
+    return xy / mx / sqrt(RVN_MIN(rf.mag(), frame_mag) / mx);
+}
+/* ------------------------------------------------------------------------- */
+// ReceptiveField::correlate() w/o the size specific kernels
+void generic_correlate(const RVN::ImagePacket& packet, RVN::length_t bytes,
+    const RVN::CropWindow& win, const RVN::ReceptiveField& rf, float offset,
+    float& xy, float& energy)
+{
+    RVN::correlate_luma(packet.luma(), packet.luma_step(),
+        packet.luma_stride(), packet.luma_bytes(bytes), win, rf.centered(),
+        rf.stride(), offset, xy, energy);
+}
+/* ------------------------------------------------------------------------- */
+template <class F>
+double ns_per_frame(F fn, int niter, float& out)
+{
+    auto t1 = std::chrono::steady_clock::now();
+    for (int k = 0; k < niter; ++k)
+    {
+        out = fn();
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count()
+        / (double)niter;
+}
+/* ========================================================================= */
+int main(int narg, const char** args)
+{
+    // usage: ravine_neuron_bench [niter] [rf files...]
+    int niter = narg > 1 ? std::atoi(args[1]) : 2000;
+
+    if (niter < 1)
+    {
+        printf("[ERROR]: niter must be at least 1\n");
+        return -1;
+    }
+
+    std::vector<std::string> files;
+    for (int k = 2; k < narg; ++k) { files.push_back(args[k]); }
+
+    if (files.empty())
+    {
+        for (int k = 1; k <= 5; ++k)
+        {
+            files.push_back("./rf/rf-0" + std::to_string(k) + ".pgm");
+        }
+    }
+
+    // a random (but repeatable) YUYV frame
+    const RVN::length_t bytes = WIDTH * HEIGHT * 2;
+    std::vector<uint8_t> data(bytes);
+
+    srand(1);
+    for (int k = 0; k < bytes; ++k) { data[k] = rand() & 0xff; }
+
+    RVN::ImagePacket packet(data.data(), bytes, WIDTH);
+
+    // the same frame's luma as a GREY frame, to check the packed luma path
+    std::vector<uint8_t> grey_data(WIDTH * HEIGHT);
+    for (int k = 0; k < WIDTH * HEIGHT; ++k) { grey_data[k] = data[2*k]; }
+
+    RVN::ImagePacket grey(grey_data.data(), WIDTH * HEIGHT, WIDTH,
+        RVN::PixelFormat::GREY, HEIGHT);
+
+    printf("[BENCH]: %d x %d frame, %d iterations, kernel: %s\n", WIDTH, HEIGHT,
+        niter, RVN::simd_name());
+
+    int status = 0;
+
+    for (size_t k = 0; k < files.size(); ++k)
+    {
+        RVN::ReceptiveField rf;
+        if (!rf.load(files[k].c_str()))
+        {
+            printf("[ERROR]: failed to load %s\n", files[k].c_str());
+            status = -1;
+            continue;
+        }
+
+        // centered in the frame, as in ravine.cpp
+        RVN::CropWindow win = {(WIDTH - rf.width()) / 2,
+            (HEIGHT - rf.height()) / 2, rf.width(), rf.height()};
+
+        float ref = 0.0f, act = 0.0f;
+        double t_ref = ns_per_frame(
+            [&]() { return reference_filter(packet, bytes, win, rf); },
+            niter, ref
+        );
+
+        double t_simd = ns_per_frame(
+            [&]() { return simd_filter(packet, bytes, win, rf); },
+            niter, act
+        );
+
+        // compare the raw dot products of the two frames w/ a common offset
+        const float offset = RVN::luma_mean(&packet, bytes);
+        float xy_yuyv, e_yuyv, xy_grey, e_grey;
+        rf.correlate(&packet, bytes, win.col, win.row, offset, xy_yuyv, e_yuyv);
+
+        float grey_act = 0.0f;
+        double t_grey = ns_per_frame(
+            [&]() {
+                rf.correlate(&grey, WIDTH * HEIGHT, win.col, win.row, offset,
+                    xy_grey, e_grey);
+                return xy_grey;
+            },
+            niter, grey_act
+        );
+
+        const float err_grey = RVN_MAX(fabs(xy_grey - xy_yuyv) / fabs(xy_yuyv),
+            fabs(e_grey - e_yuyv) / e_yuyv);
+
+        const float err = fabs(act - ref);
+
+        // the size specific kernel (if any) vs the generic loop, on both
+        // frames
+        float err_sized = 0.0f;
+        double t_generic[2], t_sized[2];
+
+        const RVN::ImagePacket* frames[2] = {&packet, &grey};
+        const RVN::length_t frame_bytes[2] = {bytes, WIDTH * HEIGHT};
+
+        for (int f = 0; f < 2; ++f)
+        {
+            float xy_g, e_g, xy_s, e_s, dummy = 0.0f;
+
+            t_generic[f] = ns_per_frame(
+                [&]() {
+                    generic_correlate(*frames[f], frame_bytes[f], win, rf,
+                        offset, xy_g, e_g);
+                    return xy_g;
+                },
+                niter, dummy
+            );
+
+            t_sized[f] = ns_per_frame(
+                [&]() {
+                    rf.correlate(frames[f], frame_bytes[f], win.col, win.row,
+                        offset, xy_s, e_s);
+                    return xy_s;
+                },
+                niter, dummy
+            );
+
+            err_sized = RVN_MAX(err_sized, RVN_MAX(
+                fabs(xy_s - xy_g) / fabs(xy_g), fabs(e_s - e_g) / e_g));
+        }
+
+        printf("    %s (%d x %d): ref %.0f ns/frame | %s %.0f ns/frame | "
+            "x%.1f | act %f vs %f (err %g) | grey %.0f ns/frame (err %g)\n",
+            files[k].c_str(), rf.width(), rf.height(), t_ref, RVN::simd_name(),
+            t_simd, t_ref / t_simd, act, ref, err, t_grey, err_grey);
+
+        printf("        %s kernel: yuyv %.0f ns vs %.0f ns generic (x%.2f) | "
+            "grey %.0f ns vs %.0f ns generic (x%.2f) | err %g\n",
+            rf.is_sized() ? "sized" : "no sized", t_sized[0], t_generic[0],
+            t_generic[0] / t_sized[0], t_sized[1], t_generic[1],
+            t_generic[1] / t_sized[1], err_sized);
+
+        if (err > 1e-4f || err_grey > 1e-5f || err_sized > 1e-5f)
+        {
+            printf("[ERROR]: activation mismatch for %s\n", files[k].c_str());
+            status = -1;
+        }
+    }
+
+    return status;
+}
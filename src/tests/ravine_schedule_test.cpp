@@ -0,0 +1,249 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include "ravine_packets.hpp"
+#include "ravine_spike_scheduler.hpp"
+
+#define SAMPLE_RATE 24000
+#define NFRAMES 1024
+
+/* ========================================================================= */
+// <nspikes> spikes at random times b/t <t0> and <t1>, in order
+std::vector<RVN::Spike> random_spikes(int nspikes, double t0, double t1)
+{
+    std::vector<RVN::Spike> spikes(nspikes);
+    for (int k = 0; k < nspikes; ++k)
+    {
+        spikes[k].time = t0 + (t1 - t0) * rand() / RAND_MAX;
+        spikes[k].neuron = k;
+    }
+
+    for (int k = 1; k < nspikes; ++k)
+    {
+        for (int j = k; j > 0 && spikes[j].time < spikes[j-1].time; --j)
+        {
+            std::swap(spikes[j], spikes[j-1]);
+        }
+    }
+
+    return spikes;
+}
+/* ------------------------------------------------------------------------- */
+// a camera at <fps> sends each frame's spikes (spread over the frame before
+// it) as soon as it's captured, and the audio callback runs every buffer w/
+// the DAC <delay> behind it. Returns the number of spikes heard and checks
+// that each one is placed on the sample at which it's time + latency falls
+// (or the first, if that has passed)
+long simulate(RVN::SpikeScheduler& scheduler, float fps, float delay,
+    float seconds, long& nsent, bool& exact)
+{
+    const double buffer = (double)NFRAMES / SAMPLE_RATE;
+
+    // every spike sent, by index, to check the placement against
+    std::vector<RVN::Spike> sent;
+
+    long nheard = 0;
+    int frame = 1;
+    size_t next = 0;
+
+    exact = true;
+
+    for (int b = 0; b * buffer < seconds; ++b)
+    {
+        const double now = b * buffer;
+
+        // frames captured since the last callback
+        while (frame / fps <= now)
+        {
+            std::vector<RVN::Spike> batch = random_spikes(rand() % 40,
+                (frame - 1) / fps, frame / fps);
+
+            (void)scheduler.push(batch.data(), batch.size());
+            sent.insert(sent.end(), batch.begin(), batch.end());
+            ++frame;
+        }
+
+        const double dac = now + delay;
+
+        const int* onsets;
+        const int n = scheduler.schedule(dac, NFRAMES, onsets);
+
+        // the spikes due in this buffer are the next ones sent
+        for (int k = 0; k < n; ++k, ++next)
+        {
+            const double offset = (sent[next].time +
+                scheduler.latency() - dac) * SAMPLE_RATE;
+
+            // late ones are heard as soon as they can be
+            const int expected = RVN_MAX((int)floor(offset), 0);
+
+            if (onsets[k] != expected || onsets[k] >= NFRAMES)
+            {
+                printf("[ERROR]: spike %zu @ %f: onset %d, expected %f\n",
+                    next, sent[next].time, onsets[k], offset);
+                exact = false;
+            }
+        }
+
+        nheard += n;
+    }
+
+    nsent = sent.size();
+
+    return nheard;
+}
+/* ========================================================================= */
+int main(int narg, const char** args)
+{
+    // usage: ravine_schedule_test [seconds]
+    const float seconds = narg > 1 ? std::atof(args[1]) : 60.0f;
+
+    int status = 0;
+
+    // w/ a latency that covers a frame, a buffer and the DAC delay every
+    // spike is heard on it's own sample, at a constant latency
+    {
+        RVN::SpikeScheduler scheduler(SAMPLE_RATE, 0.150f);
+
+        long nsent;
+        bool exact;
+        const long nheard = simulate(scheduler, 15.0f, 0.030f, seconds,
+            nsent, exact);
+
+        const RVN::RunningStats& lat = scheduler.render_latency();
+
+        printf("[TEST]: %ld of %ld spikes heard, %llu late, latency (ms): "
+            "mean %.3f, sd %.3f, min %.3f, max %.3f\n", nheard, nsent,
+            (unsigned long long)scheduler.late(), lat.mean() * 1e3,
+            lat.sd() * 1e3, lat.min() * 1e3, lat.max() * 1e3);
+
+        // the rest are still pending at the end
+        if (!exact || scheduler.late() > 0 || scheduler.dropped() > 0 ||
+            nsent - nheard > 40 * 3 ||
+            lat.min() < scheduler.latency() - 1.0 / SAMPLE_RATE - 1e-6 ||
+            lat.max() > scheduler.latency() + 1e-6)
+        {
+            printf("[ERROR]: spikes misplaced\n");
+            status = -1;
+        }
+    }
+
+    // w/ too short a latency spikes are heard as soon as they can be
+    {
+        RVN::SpikeScheduler scheduler(SAMPLE_RATE, 0.050f);
+
+        long nsent;
+        bool exact;
+        const long nheard = simulate(scheduler, 15.0f, 0.030f, seconds,
+            nsent, exact);
+
+        printf("[TEST]: short latency: %ld of %ld spikes heard, %llu late, "
+            "%llu dropped\n", nheard, nsent,
+            (unsigned long long)scheduler.late(),
+            (unsigned long long)scheduler.dropped());
+
+        if (scheduler.late() == 0 || scheduler.dropped() > 0 ||
+            nheard != nsent)
+        {
+            printf("[ERROR]: late spikes lost\n");
+            status = -1;
+        }
+    }
+
+    // a model thread and an audio thread, every spike comes through once
+    {
+        RVN::SpikeScheduler scheduler(SAMPLE_RATE, 0.0f, 1024);
+
+        const int nspikes = 200000;
+        long nheard = 0;
+
+        std::thread producer([&scheduler]() {
+            for (int k = 0; k < nspikes; )
+            {
+                RVN::Spike batch[64];
+                const int n = RVN_MIN(64, nspikes - k);
+                for (int j = 0; j < n; ++j)
+                {
+                    batch[j].time = (k + j) * 1e-4f;
+                    batch[j].neuron = k + j;
+                }
+
+                // never more than the queue holds at once
+                k += scheduler.push(batch, n);
+                std::this_thread::sleep_for(std::chrono::microseconds(20));
+            }
+        });
+
+        // one buffer at a time, each starting at the first spike not yet
+        // heard so that none is late
+        while (nheard < nspikes)
+        {
+            const int* onsets;
+            nheard += scheduler.schedule(nheard * 1e-4, NFRAMES, onsets);
+
+            std::this_thread::sleep_for(std::chrono::microseconds(10));
+        }
+
+        producer.join();
+
+        printf("[TEST]: threaded: %ld of %d spikes heard, %llu dropped\n",
+            nheard, nspikes, (unsigned long long)scheduler.dropped());
+
+        if (nheard != nspikes)
+        {
+            printf("[ERROR]: spikes lost\n");
+            status = -1;
+        }
+    }
+
+    // cost of a callback's scheduling w/ spikes pending
+    const int pending[] = {10, 100, 1000};
+
+    for (int npending : pending)
+    {
+        RVN::SpikeScheduler scheduler(SAMPLE_RATE, 0.150f);
+
+        // spikes that aren't due for a while, all of which are looked at
+        std::vector<RVN::Spike> spikes = random_spikes(npending, 100.0f,
+            101.0f);
+        (void)scheduler.push(spikes.data(), spikes.size());
+
+        const int nbuffers = 1000;
+        const double buffer = (double)NFRAMES / SAMPLE_RATE;
+
+        long nheard = 0;
+
+        auto t1 = std::chrono::steady_clock::now();
+
+        for (int b = 0; b < nbuffers; ++b)
+        {
+            // and a frame's worth due in each buffer
+            RVN::Spike batch[16];
+            for (int k = 0; k < 16; ++k)
+            {
+                batch[k].time = b * buffer + k * buffer / 16 - 0.150;
+                batch[k].neuron = k;
+            }
+            (void)scheduler.push(batch, 16);
+
+            const int* onsets;
+            nheard += scheduler.schedule(b * buffer, NFRAMES, onsets);
+        }
+
+        auto t2 = std::chrono::steady_clock::now();
+
+        const double us = std::chrono::duration_cast<
+            std::chrono::nanoseconds>(t2 - t1).count() / (1000.0 * nbuffers);
+
+        printf("[BENCH]: %4d spikes pending: %.2f us / callback (%.1f "
+            "heard)\n", npending, us, (double)nheard / nbuffers);
+    }
+
+    printf("[TEST]: %s\n", status == 0 ? "PASSED" : "FAILED");
+
+    return status;
+}
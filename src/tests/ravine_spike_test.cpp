@@ -0,0 +1,192 @@
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include "ravine_packets.hpp"
+#include "ravine_stats.hpp"
+#include "ravine_spike_generator.hpp"
+
+/* ========================================================================= */
+// drive <gen>'s neurons w/ a constant activation <act> for <seconds> of
+// frames at <fps>, returns the ISI stats of neuron 0 and checks that the
+// batches are in order, w/in their interval and respect the refractory period
+bool run(RVN::SpikeGenerator& gen, float act, float fps, float seconds,
+    RVN::RunningStats& isi, long& nspikes)
+{
+    const int n = gen.size();
+    const float d = gen.params().refractory;
+
+    std::vector<float> a(n, act);
+    std::vector<double> time(n), last(n, -1.0);
+
+    RVN::SpikeBatch batch;
+    bool ok = true;
+
+    nspikes = 0;
+
+    const int nframes = seconds * fps;
+    for (int f = 0; f <= nframes; ++f)
+    {
+        const double t1 = (double)f / fps;
+        for (int k = 0; k < n; ++k) { time[k] = t1; }
+
+        batch.clear();
+        gen.generate(a.data(), time.data(), batch);
+
+        for (int j = 0; j < batch.size(); ++j)
+        {
+            const RVN::Spike& s = batch[j];
+
+            // times are double seconds, good to a few ulp
+            const double eps = 1e-9;
+
+            const bool inside = s.time >= t1 - 1.0 / fps - eps &&
+                s.time <= t1 + eps;
+            const bool sorted = j == 0 || batch[j - 1].time <= s.time;
+            const bool refractory = last[s.neuron] < 0.0 ||
+                s.time - last[s.neuron] >= d - eps;
+
+            if (!inside || !sorted || !refractory)
+            {
+                printf("[ERROR]: spike %d of frame %d @ %f (neuron %d): "
+                    "inside %d, sorted %d, refractory %d\n", j, f, s.time,
+                    s.neuron, inside, sorted, refractory);
+                ok = false;
+            }
+
+            if (s.neuron == 0 && last[0] >= 0.0)
+            {
+                isi.add(s.time - last[0]);
+            }
+            last[s.neuron] = s.time;
+        }
+
+        nspikes += batch.size();
+    }
+
+    return ok;
+}
+/* ========================================================================= */
+int main(int narg, const char** args)
+{
+    // usage: ravine_spike_test [seconds]
+    const float seconds = narg > 1 ? std::atof(args[1]) : 200.0f;
+    const float fps = 15.0f;
+
+    int status = 0;
+
+    const RVN::SpikeMode modes[] = {RVN::SpikeMode::Poisson,
+        RVN::SpikeMode::LIF};
+    const float acts[] = {0.06f, 0.1f, 0.2f, 0.4f};
+
+    for (RVN::SpikeMode mode : modes)
+    {
+        for (float act : acts)
+        {
+            RVN::SpikeParams params;
+            params.mode = mode;
+
+            RVN::SpikeGenerator gen(1, params, 12345);
+
+            RVN::RunningStats isi;
+            long nspikes;
+            if (!run(gen, act, fps, seconds, isi, nspikes)) { status = -1; }
+
+            // the first frame only marks the time
+            const float rate = nspikes / seconds;
+            const float target = gen.rate(act);
+
+            // w/ a dead time d the ISI is d + an exponential of mean 1 /
+            // rate - d, so it's CV is 1 - rate d, and 0 for the LIF
+            const float cv = isi.sd() / isi.mean();
+            const float cv_ref = mode == RVN::SpikeMode::Poisson ?
+                1.0f - target * params.refractory : 0.0f;
+
+            // Poisson counts are off by ~sqrt(n), LIF spike times by the
+            // float rounding of the membrane update
+            const float tol = mode == RVN::SpikeMode::Poisson ?
+                4.0f / sqrt(target * seconds) + 1e-3f : 1e-3f;
+
+            printf("[TEST]: %-7s act %.2f: %.2f Hz (target %.2f, %.1f per "
+                "frame), ISI CV %.3f (expected %.3f)\n",
+                RVN::mode_name(mode), act, rate, target, rate / fps, cv,
+                cv_ref);
+
+            if (fabs(rate - target) > tol * target ||
+                fabs(cv - cv_ref) > 0.05f)
+            {
+                printf("[ERROR]: rate / CV mismatch\n");
+                status = -1;
+            }
+        }
+    }
+
+    // the default, at most one spike per frame, at the frame's time
+    {
+        RVN::SpikeGenerator gen;
+
+        RVN::RunningStats isi;
+        long nspikes;
+
+        if (!run(gen, 0.5f, fps, 10.0f, isi, nspikes) ||
+            nspikes > 10.0f * fps + 1)
+        {
+            printf("[ERROR]: threshold mode\n");
+            status = -1;
+        }
+
+        printf("[TEST]: threshold act 0.50: %ld spikes in %d frames\n",
+            nspikes, (int)(10.0f * fps) + 1);
+    }
+
+    // cost per frame for a population
+    const int sizes[] = {100, 1000};
+
+    for (int n : sizes)
+    {
+        for (RVN::SpikeMode mode : modes)
+        {
+            RVN::SpikeParams params;
+            params.mode = mode;
+
+            RVN::SpikeGenerator gen(n, params, 777);
+
+            std::vector<float> act(n);
+            std::vector<double> time(n);
+            for (int k = 0; k < n; ++k)
+            {
+                act[k] = (float)rand() / RAND_MAX * 0.4f;
+            }
+
+            RVN::SpikeBatch batch;
+            const int nframes = 300;
+            long nspikes = 0;
+
+            auto t1 = std::chrono::steady_clock::now();
+
+            for (int f = 0; f < nframes; ++f)
+            {
+                for (int k = 0; k < n; ++k) { time[k] = f / fps; }
+
+                batch.clear();
+                gen.generate(act.data(), time.data(), batch);
+                nspikes += batch.size();
+            }
+
+            auto t2 = std::chrono::steady_clock::now();
+
+            const double us = std::chrono::duration_cast<
+                std::chrono::nanoseconds>(t2 - t1).count() / (1000.0 * nframes);
+
+            printf("[BENCH]: %4d %-7s neurons: %.1f us / frame, %.0f spikes "
+                "/ frame\n", n, RVN::mode_name(mode), us,
+                (double)nspikes / nframes);
+        }
+    }
+
+    printf("[TEST]: %s\n", status == 0 ? "PASSED" : "FAILED");
+
+    return status;
+}
@@ -0,0 +1,207 @@
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include "ravine_packets.hpp"
+#include "ravine_temporal_filter.hpp"
+
+/* ========================================================================= */
+// response of an <order> stage cascade of unit gain low-passes (time
+// constant <tau>) to a unit step, <t> after it (the gamma CDF)
+double gamma_step(double t, double tau, int order)
+{
+    double term = 1.0, sum = 0.0;
+    for (int m = 0; m < order; ++m)
+    {
+        sum += term;
+        term *= (t / tau) / (m + 1);
+    }
+    return 1.0 - exp(-t / tau) * sum;
+}
+/* ------------------------------------------------------------------------- */
+float randf()
+{
+    return 2.0f * rand() / RAND_MAX - 1.0f;
+}
+/* ========================================================================= */
+int main(int narg, const char** args)
+{
+    // usage: ravine_temporal_test [niter]
+    int niter = narg > 1 ? std::atoi(args[1]) : 10000;
+
+    const float period = 1.0f / 60.0f;
+    int status = 0;
+
+    // the step response of a biphasic kernel, sampled at the frames, is
+    // exactly that of the continuous kernel
+    for (int order = 1; order <= 4; ++order)
+    {
+        RVN::TemporalKernel kernel;
+        if (!RVN::parse_temporal_kernel("biphasic:15,60,0.8," +
+            std::to_string(order), kernel))
+        {
+            printf("[ERROR]: failed to parse kernel\n");
+            return -1;
+        }
+
+        RVN::TemporalFilter filter;
+        (void)filter.add(kernel);
+
+        float act = 0.0f;
+        filter.step(0.0f, &act);
+
+        double err = 0.0, peak = 0.0;
+        for (int k = 1; k < 60; ++k)
+        {
+            act = 1.0f;
+            filter.step(k * period, &act);
+
+            const double t = k * period;
+            const double ref = gamma_step(t, kernel.tau_fast, order) -
+                kernel.weight * gamma_step(t, kernel.tau_slow, order);
+
+            err = RVN_MAX(err, fabs(act - ref));
+            peak = RVN_MAX(peak, act);
+        }
+
+        printf("[TEST]: %s: step response peak %.3f, settles to %.3f "
+            "(1 - weight = %.3f), max err %g\n",
+            RVN::kernel_name(kernel).c_str(), peak, act, 1.0f - kernel.weight,
+            err);
+
+        if (err > 1e-5 || fabs(act - (1.0f - kernel.weight)) > 1e-3)
+        {
+            printf("[ERROR]: step response mismatch\n");
+            status = -1;
+        }
+    }
+
+    // a dropped frame (twice the interval, the response held over it) gives
+    // the same state as two frames w/ the same response
+    {
+        RVN::TemporalKernel kernel;
+        (void)RVN::parse_temporal_kernel("biphasic:10,40,1,3", kernel);
+
+        RVN::TemporalFilter every, dropped;
+        (void)every.add(kernel);
+        (void)dropped.add(kernel);
+
+        float a = 0.3f, b = 0.3f;
+        every.step(0.0f, &a);
+        dropped.step(0.0f, &b);
+
+        double err = 0.0;
+        for (int k = 1; k < 200; ++k)
+        {
+            const float x = randf();
+
+            a = x;
+            every.step((2*k - 1) * period, &a);
+            a = x;
+            every.step(2*k * period, &a);
+
+            b = x;
+            dropped.step(2*k * period, &b);
+
+            err = RVN_MAX(err, fabs(a - b));
+        }
+
+        printf("[TEST]: every frame vs every other frame: max err %g\n", err);
+
+        if (err > 1e-5)
+        {
+            printf("[ERROR]: dropped frames change the response\n");
+            status = -1;
+        }
+    }
+
+    // an FIR kernel is the convolution of the responses w/ it's taps, the
+    // responses before the first taken as equal to it
+    {
+        RVN::TemporalKernel kernel;
+        (void)RVN::parse_temporal_kernel("fir:0.5,0.3,-0.2,-0.4,-0.2", kernel);
+
+        RVN::TemporalFilter filter;
+        (void)filter.add(kernel);
+
+        const int ntaps = kernel.taps.size();
+
+        std::vector<float> x(100);
+        for (size_t k = 0; k < x.size(); ++k) { x[k] = randf(); }
+
+        double err = 0.0;
+        for (int k = 0; k < (int)x.size(); ++k)
+        {
+            float act = x[k];
+            filter.step(k * period, &act);
+
+            float ref = 0.0f;
+            for (int i = 0; i < ntaps; ++i)
+            {
+                ref += kernel.taps[i] * x[RVN_MAX(k - i, 0)];
+            }
+
+            err = RVN_MAX(err, fabs(act - ref));
+        }
+
+        printf("[TEST]: %s: max err %g\n", RVN::kernel_name(kernel).c_str(),
+            err);
+
+        if (err > 1e-5)
+        {
+            printf("[ERROR]: FIR mismatch\n");
+            status = -1;
+        }
+    }
+
+    // cost per frame for a population, w/ one kernel for all and w/ a
+    // different one for each neuron
+    const int sizes[] = {100, 1000, 10000};
+
+    for (int n : sizes)
+    {
+        for (int shared = 1; shared >= 0; --shared)
+        {
+            RVN::TemporalFilter filter;
+
+            for (int k = 0; k < n; ++k)
+            {
+                RVN::TemporalKernel kernel;
+                kernel.type = RVN::TemporalKernel::Type::Biphasic;
+                kernel.tau_fast = shared ? 0.015f : 0.010f + 0.00001f * k;
+                kernel.tau_slow = 4.0f * kernel.tau_fast;
+                kernel.weight = 0.9f;
+                kernel.order = 3;
+
+                (void)filter.add(kernel);
+            }
+
+            std::vector<float> act(n);
+            for (int k = 0; k < n; ++k) { act[k] = randf(); }
+
+            const int nframes = RVN_MAX(niter / n, 10) * 10;
+
+            auto t1 = std::chrono::steady_clock::now();
+
+            for (int k = 0; k < nframes; ++k)
+            {
+                filter.step(k * period, act.data());
+            }
+
+            auto t2 = std::chrono::steady_clock::now();
+
+            const double us = std::chrono::duration_cast<
+                std::chrono::nanoseconds>(t2 - t1).count() / (1000.0 * nframes);
+
+            printf("[BENCH]: %5d neurons, %s kernels: %.1f us / frame "
+                "(%.1f ns / neuron)\n", n, shared ? "shared  " : "distinct",
+                us, 1000.0 * us / n);
+        }
+    }
+
+    printf("[TEST]: %s\n", status == 0 ? "PASSED" : "FAILED");
+
+    return status;
+}
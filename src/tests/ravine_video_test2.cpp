@@ -66,7 +66,20 @@ int main(int narg, const char** args)
         return -1;
     }
 
-    RVN::sleep_ms(6000);
+    RVN::sleep_ms(3000);
+
+    // switch sizes mid-stream, the sink follows w/o being closed
+    if (!source.reconfigure(2 * WIDTH, 2 * HEIGHT, FRAMERATE, source.format(),
+        4))
+    {
+        printf("[ERROR]: failed to reconfigure stream\n");
+        printf("[MSG]: %s\n", source.get_error_msg().c_str());
+        source.stop_stream();
+        source.close_stream();
+        return -1;
+    }
+
+    RVN::sleep_ms(3000);
 
     if (!source.stop_stream())
     {
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include "ravine_packets.hpp"
+#include "ravine_voice_pool.hpp"
+#include "ravine_pink_noise.hpp"
+#include "ravine_spike_waveform.hpp"
+
+#define SAMPLE_RATE 24000
+#define NFRAMES 1024
+
+/* ========================================================================= */
+// onsets of a Poisson process at <rate> Hz over <nblocks> blocks, per block
+std::vector<std::vector<int>> poisson_onsets(float rate, int nblocks)
+{
+    std::vector<std::vector<int>> onsets(nblocks);
+    if (rate <= 0.0f) { return onsets; }
+
+    double t = 0.0;
+    while (true)
+    {
+        t -= log((rand() + 1.0) / (RAND_MAX + 1.0)) * SAMPLE_RATE / rate;
+
+        const long sample = (long)t;
+        if (sample >= (long)nblocks * NFRAMES) { break; }
+
+        onsets[sample / NFRAMES].push_back(sample % NFRAMES);
+    }
+
+    return onsets;
+}
+/* ------------------------------------------------------------------------- */
+// every spike's waveform added up where any is playing, <background>
+// everywhere else, over <nblocks> blocks
+std::vector<float> reference(const std::vector<std::vector<int>>& onsets,
+    const float* wf, int length, float background)
+{
+    const long n = (long)onsets.size() * NFRAMES;
+    std::vector<float> out(n, 0.0f);
+    std::vector<bool> covered(n, false);
+
+    for (size_t b = 0; b < onsets.size(); ++b)
+    {
+        for (int onset : onsets[b])
+        {
+            const long start = b * NFRAMES + onset;
+            for (long k = start; k < RVN_MIN(start + length, n); ++k)
+            {
+                out[k] += wf[k - start];
+                covered[k] = true;
+            }
+        }
+    }
+
+    for (long k = 0; k < n; ++k)
+    {
+        if (!covered[k]) { out[k] = background; }
+    }
+
+    return out;
+}
+/* ========================================================================= */
+int main(int narg, const char** args)
+{
+    // usage: ravine_voice_bench [nblocks]
+    const int nblocks = narg > 1 ? std::atoi(args[1]) : 2000;
+
+    int status = 0;
+
+    // the real waveform if it's around, a 64 sample sine burst if not
+    std::vector<float> synth(64);
+    for (int k = 0; k < 64; ++k)
+    {
+        synth[k] = sin(2.0 * M_PI * k / 16.0) * (1.0 - k / 64.0);
+    }
+
+    RVN::WaveForm file("./spike.wf");
+    const float* wf = file.isvalid() ? file.data() : synth.data();
+    const int length = file.isvalid() ? file.length() : 64;
+
+    printf("[INFO]: %d sample waveform (%s), %d sample blocks @ %d Hz\n",
+        length, file.isvalid() ? "./spike.wf" : "synthetic", NFRAMES,
+        SAMPLE_RATE);
+
+    // w/ enough voices every spike is heard in full, added to any it
+    // overlaps w/, and the background only where there are none
+    {
+        const int nb = 200;
+        std::vector<std::vector<int>> onsets = poisson_onsets(3000.0f, nb);
+        std::vector<float> ref = reference(onsets, wf, length, 0.5f);
+
+        RVN::VoicePool pool(wf, length, 256, NFRAMES);
+
+        std::vector<float> out(NFRAMES);
+        double err = 0.0;
+        int most = 0;
+
+        for (int b = 0; b < nb; ++b)
+        {
+            std::fill(out.begin(), out.end(), 0.5f);
+            pool.render(onsets[b].data(), onsets[b].size(), out.data(),
+                NFRAMES);
+
+            most = RVN_MAX(most, pool.active());
+
+            for (int k = 0; k < NFRAMES; ++k)
+            {
+                err = RVN_MAX(err, fabs(out[k] - ref[b * NFRAMES + k]));
+            }
+        }
+
+        printf("[TEST]: 3000 Hz, up to %d voices at a block's end: max err "
+            "%g, %llu stolen\n", most, err,
+            (unsigned long long)pool.stolen());
+
+        if (err > 1e-5 || pool.stolen() > 0)
+        {
+            printf("[ERROR]: mix mismatch\n");
+            status = -1;
+        }
+    }
+
+    // w/ one voice a spike cuts the one before it short, even across blocks
+    {
+        RVN::VoicePool pool(wf, length, 256, NFRAMES);
+        (void)pool.set_max_voices(1);
+
+        const int gap = length / 2;
+        std::vector<int> first = {NFRAMES - gap / 2};
+        std::vector<int> second = {gap / 2};
+
+        std::vector<float> out(2 * NFRAMES, 0.5f);
+        pool.render(first.data(), 1, out.data(), NFRAMES);
+        pool.render(second.data(), 1, out.data() + NFRAMES, NFRAMES);
+
+        double err = 0.0;
+        for (int k = 0; k < 2 * NFRAMES; ++k)
+        {
+            const int a = k - first[0], b = k - NFRAMES - second[0];
+
+            float expected = 0.5f;
+            if (b >= 0 && b < length) { expected = wf[b]; }
+            else if (a >= 0 && a < gap) { expected = wf[a]; }
+
+            err = RVN_MAX(err, fabs(out[k] - expected));
+        }
+
+        printf("[TEST]: 1 voice: max err %g, %llu stolen\n", err,
+            (unsigned long long)pool.stolen());
+
+        if (err > 1e-6 || pool.stolen() != 1)
+        {
+            printf("[ERROR]: voice stealing\n");
+            status = -1;
+        }
+    }
+
+    // callback cost (noise + voices) vs firing rate
+    const float rates[] = {0.0f, 50.0f, 100.0f, 200.0f, 400.0f, 800.0f,
+        1600.0f, 10000.0f};
+
+    for (float rate : rates)
+    {
+        std::vector<std::vector<int>> onsets = poisson_onsets(rate, nblocks);
+
+        RVN::PinkNoise noise(16, 0.3f);
+        RVN::VoicePool pool(wf, length, 256, NFRAMES);
+        (void)pool.set_max_voices(32);
+
+        std::vector<float> out(NFRAMES);
+        double us = 0.0, worst = 0.0;
+
+        for (int b = 0; b < nblocks; ++b)
+        {
+            auto t1 = std::chrono::steady_clock::now();
+
+            for (int k = 0; k < NFRAMES; ++k) { out[k] = noise.next_sample(); }
+            pool.render(onsets[b].data(), onsets[b].size(), out.data(),
+                NFRAMES);
+
+            auto t2 = std::chrono::steady_clock::now();
+
+            const double dt = std::chrono::duration_cast<
+                std::chrono::nanoseconds>(t2 - t1).count() / 1000.0;
+            us += dt;
+            worst = RVN_MAX(worst, dt);
+        }
+
+        printf("[BENCH]: %6.0f Hz: %.2f us / block (worst %.2f), %llu "
+            "stolen\n", rate, us / nblocks, worst,
+            (unsigned long long)pool.stolen());
+    }
+
+    printf("[TEST]: %s\n", status == 0 ? "PASSED" : "FAILED");
+
+    return status;
+}
@@ -2,6 +2,7 @@
 #define RAVINE_ARGPARSE_HPP_
 
 #include <string>
+#include <vector>
 #include <cstdio>
 #include <cstdlib>
 
@@ -9,15 +10,30 @@ namespace RVN
 {
     /* ---------------------------------------------------------------------- */
     int arg_parse(const char** args, int narg,
-        std::string& dev, std::string& rffile, std::string& ofile, int& port,
-        bool& save, bool& listen)
+        std::vector<std::string>& devs, std::string& rffile,
+        std::string& popfile, std::string& ofile, std::string& format,
+        int& port, int& fps,
+        bool& save, bool& listen, bool& latest, bool& autoexp, bool& fixed,
+        std::string& temporal, std::string& spikes, float& delay, int& voices,
+        std::vector<std::string>& threads)
     {
-        dev = "/dev/video0";
+        devs.clear();
+        format = "auto";
         rffile = "./rf/rf-05.pgm";
+        popfile = "";
         ofile = "";
         port = -1;
+        fps = 15;
         save = false;
         listen = false;
+        latest = false;
+        autoexp = false;
+        fixed = false;
+        temporal = "none";
+        spikes = "threshold";
+        delay = 150.0f;
+        voices = 32;
+        threads.clear();
 
         int k = 1;
         while (k < narg)
@@ -28,6 +44,21 @@ namespace RVN
             {
                 return -1;
             }
+            else if (tmp == "-L")
+            {
+                latest = true;
+                ++k;
+            }
+            else if (tmp == "-A")
+            {
+                autoexp = true;
+                ++k;
+            }
+            else if (tmp == "-I")
+            {
+                fixed = true;
+                ++k;
+            }
             else if (tmp == "-p")
             {
                 if (narg > (k + 1))
@@ -54,11 +85,75 @@ namespace RVN
                     k += 2;
                 }
             }
+            else if (tmp == "-P")
+            {
+                if (narg > (k + 1))
+                {
+                    popfile.assign(args[k+1]);
+                    k += 2;
+                }
+            }
+            else if (tmp == "-F")
+            {
+                if (narg > (k + 1))
+                {
+                    format.assign(args[k+1]);
+                    k += 2;
+                }
+            }
+            else if (tmp == "-R")
+            {
+                if (narg > (k + 1))
+                {
+                    fps = std::atoi(args[k+1]);
+                    k += 2;
+                }
+            }
+            else if (tmp == "-K")
+            {
+                if (narg > (k + 1))
+                {
+                    temporal.assign(args[k+1]);
+                    k += 2;
+                }
+            }
+            else if (tmp == "-S")
+            {
+                if (narg > (k + 1))
+                {
+                    spikes.assign(args[k+1]);
+                    k += 2;
+                }
+            }
+            else if (tmp == "-D")
+            {
+                if (narg > (k + 1))
+                {
+                    delay = std::atof(args[k+1]);
+                    k += 2;
+                }
+            }
+            else if (tmp == "-V")
+            {
+                if (narg > (k + 1))
+                {
+                    voices = std::atoi(args[k+1]);
+                    k += 2;
+                }
+            }
+            else if (tmp == "-T")
+            {
+                if (narg > (k + 1))
+                {
+                    threads.push_back(args[k+1]);
+                    k += 2;
+                }
+            }
             else if (tmp == "-d")
             {
                 if (narg > (k + 1))
                 {
-                    dev.assign(args[k+1]);
+                    devs.push_back(args[k+1]);
                     k += 2;
                 }
             }
@@ -69,8 +164,18 @@ namespace RVN
             }
         }
 
-        printf("Port: %d | save: %d | listen: %d | ofile: %s | rffile: %s\n",
-            port, save, listen, ofile.c_str(), rffile.c_str());
+        if (devs.empty()) { devs.push_back("/dev/video0"); }
+
+        std::string devices = devs[0];
+        for (size_t j = 1; j < devs.size(); ++j) { devices += "," + devs[j]; }
+
+        printf("Devices: %s | Port: %d | save: %d | listen: %d | ofile: %s | "
+            "rffile: %s | popfile: %s | format: %s | fps: %d | latest: %d | "
+            "auto exposure: %d | fixed point: %d | temporal: %s | spikes: %s "
+            "| delay: %.1f ms | voices: %d\n", devices.c_str(), port, save,
+            listen, ofile.c_str(), rffile.c_str(), popfile.c_str(),
+            format.c_str(), fps, latest, autoexp, fixed, temporal.c_str(),
+            spikes.c_str(), delay, voices);
 
         if (listen && (port < 1 || port > 65535))
         {
@@ -78,6 +183,30 @@ namespace RVN
             return -1;
         }
 
+        for (size_t j = 0; j < devs.size(); ++j)
+        {
+            for (size_t i = 0; i < j; ++i)
+            {
+                if (devs[i] == devs[j])
+                {
+                    printf("[ERROR]: %s given twice\n", devs[j].c_str());
+                    return -1;
+                }
+            }
+        }
+
+        if (fps < 1 || fps > 240)
+        {
+            printf("[ERROR]: invalid frame rate %d\n", fps);
+            return -1;
+        }
+
+        if (delay < 0.0f || delay > 2000.0f)
+        {
+            printf("[ERROR]: invalid spike delay %.1f ms\n", delay);
+            return -1;
+        }
+
         if (save && ofile.empty())
         {
             printf("[ERROR]: cannot set save to true with out valid output file (-f)\n");
@@ -1,6 +1,22 @@
+#include <time.h>
+
 #include "ravine_clock.hpp"
 
 namespace RVN
 {
     const steady_clock::time_point Clock::_timebase = steady_clock::now();
+    /* ---------------------------------------------------------------------- */
+    double Clock::from_monotonic(long sec, long nsec) const
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        const double t = now();
+
+        // how long ago <sec, nsec> was
+        const double ago = (double)(ts.tv_sec - sec) +
+            (double)(ts.tv_nsec - nsec) * 1e-9;
+
+        return t - ago;
+    }
 }
@@ -12,16 +12,23 @@ namespace RVN
     {
     public:
         Clock() {}
-        inline float now() const
+        // s since the time base, as a double so that it resolves well under a
+        // us (i.e. an audio sample) however long we've been running
+        inline double now() const
         {
-            return std::chrono::duration_cast<std::chrono::microseconds>(
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
                 steady_clock::now() - _timebase
-            ).count() * usec2sec;
+            ).count() * nsec2sec;
         }
 
+        // a CLOCK_MONOTONIC time (e.g. a V4L2 buffer timestamp) in our time
+        // base, the two clocks are sampled together on every call so this
+        // makes no assumption about what steady_clock is built on
+        double from_monotonic(long sec, long nsec) const;
+
     public:
         static const steady_clock::time_point _timebase;
-        static constexpr float usec2sec = 1e-6f;
+        static constexpr double nsec2sec = 1e-9;
     };
     /* ---------------------------------------------------------------------- */
 }
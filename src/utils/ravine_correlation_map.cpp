@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <cmath>
+
+#include "ravine_simd.hpp"
+#include "ravine_correlation_map.hpp"
+
+// a transform flop takes ~2.7x as long as a multiply-add of the direct and
+// separable kernels (~0.65 vs ~0.24 ns, map_bench on SSE2, both about the
+// same across RF sizes, frame sizes and steps)
+#define MAP_FFT_COST 2.7
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // y[0..n) += a * x[0..n)
+    static inline void axpy(float a, const float* x, float* y, int n)
+    {
+        int k = 0;
+#if defined(RVN_SIMD_AVX2)
+        const __m256 va = _mm256_set1_ps(a);
+        for (; k + 8 <= n; k += 8)
+        {
+            _mm256_storeu_ps(y + k, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + k),
+                _mm256_loadu_ps(y + k)));
+        }
+#elif defined(RVN_SIMD_SSE2)
+        const __m128 va = _mm_set1_ps(a);
+        for (; k + 4 <= n; k += 4)
+        {
+            _mm_storeu_ps(y + k, _mm_add_ps(_mm_loadu_ps(y + k),
+                _mm_mul_ps(va, _mm_loadu_ps(x + k))));
+        }
+#elif defined(RVN_SIMD_NEON)
+        const float32x4_t va = vdupq_n_f32(a);
+        for (; k + 4 <= n; k += 4)
+        {
+            vst1q_f32(y + k, vmlaq_f32(vld1q_f32(y + k), va, vld1q_f32(x + k)));
+        }
+#endif
+        for (; k < n; ++k) { y[k] += a * x[k]; }
+    }
+    /* ====================================================================== */
+    CorrelationMap::CorrelationMap(const ReceptiveField& rf, int width,
+        int height, int step, MapMethod method) :
+        _rf(rf), _width(width), _height(height), _step(RVN_MAX(step, 1)),
+        _method(method)
+    {
+        if (!rf.isvalid() || width < rf.width() || height < rf.height())
+        {
+            return;
+        }
+
+        _map_width = (width - rf.width()) / _step + 1;
+        _map_height = (height - rf.height()) / _step + 1;
+
+        _sum2.resize((width + 1) * (height + 1));
+
+        const int fft_width = next_pow2(width);
+        const int fft_height = next_pow2(height);
+
+        // frame rows the map covers
+        const int rows = (_map_height - 1) * _step + rf.height();
+
+        if (_method == MapMethod::Separable && rf.rank() < 1)
+        {
+            _method = MapMethod::Auto;
+        }
+
+        // multiply-adds for the direct path vs. a (rough) count of the flops
+        // in the forward + inverse transforms and the product, each weighted
+        // by what it costs in time (see MAP_FFT_COST), the crossover for a
+        // 320 x 240 frame at step 1 is around a 15 x 15 RF
+        const double direct = ((double)_map_width) * _map_height *
+            rf.width() * rf.height();
+
+        const double npx = ((double)fft_width) * fft_height;
+        const double fft = MAP_FFT_COST * 2.5 * npx * log2(npx);
+
+        // multiply-adds of the row and column passes
+        const double separable = ((double)rf.rank()) * _map_width *
+            (((double)rows) * rf.width() + ((double)_map_height) *
+            rf.height());
+
+        if (rf.rank() > 0)
+        {
+            _separable_gain = (float)(RVN_MIN(direct, fft) / separable);
+        }
+
+        if (_method == MapMethod::Auto)
+        {
+            _method = direct < fft ? MapMethod::Direct : MapMethod::FFT;
+
+            if (rf.rank() > 0 && separable < RVN_MIN(direct, fft))
+            {
+                _method = MapMethod::Separable;
+            }
+        }
+
+        if (_method == MapMethod::Separable)
+        {
+            _sep.resize(rows * _map_width);
+        }
+
+        if (_method == MapMethod::FFT)
+        {
+            _fft = new RealFFT2D(fft_width, fft_height);
+
+            const int ns = _fft->spectrum_size();
+            _rf_re.resize(ns);
+            _rf_im.resize(ns);
+            _re.resize(ns);
+            _im.resize(ns);
+            _dense.resize(width * height);
+
+            _fft->forward(rf.centered(), rf.width(), rf.height(), rf.stride(),
+                _rf_re.data(), _rf_im.data());
+
+            // correlation is multiplication by the *conjugate* spectrum
+            for (int k = 0; k < ns; ++k) { _rf_im[k] = -_rf_im[k]; }
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    CorrelationMap::~CorrelationMap()
+    {
+        if (_fft != nullptr)
+        {
+            delete _fft;
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void CorrelationMap::compute(const float* luma, int stride, float* out)
+    {
+        if (!isvalid()) { return; }
+
+        if (_method == MapMethod::Direct)
+        {
+            correlate_direct(luma, stride, out);
+        }
+        else if (_method == MapMethod::Separable)
+        {
+            correlate_separable(luma, stride, out);
+        }
+        else
+        {
+            correlate_fft(luma, stride, out);
+        }
+
+        integral_energy(luma, stride);
+
+        // normalize exactly as NeuronFilter::filter() does, w/ the energy of
+        // the frame under each window from the integral image
+        const int w1 = _width + 1;
+        const int kw = _rf.width();
+        const int kh = _rf.height();
+        const float rf_mag = _rf.mag();
+
+        for (int y = 0; y < _map_height; ++y)
+        {
+            const double* top = &_sum2[(y * _step) * w1];
+            const double* bottom = &_sum2[(y * _step + kh) * w1];
+            float* row = out + y * _map_width;
+
+            for (int x = 0; x < _map_width; ++x)
+            {
+                const int left = x * _step;
+                const float energy = (float)(bottom[left + kw] - bottom[left] -
+                    top[left + kw] + top[left]);
+
+                const float mx = RVN_MAX(rf_mag, energy);
+                row[x] = row[x] / mx / sqrt(RVN_MIN(rf_mag, energy) / mx);
+            }
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void CorrelationMap::correlate_direct(const float* luma, int stride,
+        float* out)
+    {
+        const int kw = _rf.width();
+        const int kh = _rf.height();
+        const int rf_stride = _rf.stride();
+        const float* rf = _rf.centered();
+
+        if (_step == 1)
+        {
+            // a tile of map columns is accumulated together: each RF weight
+            // is broadcast and multiplied into a contiguous run of luma, so
+            // the inner loop is a vectorized axpy and the tile plus the luma
+            // it touches stays in L1
+            alignas(RVN_SIMD_ALIGN) float acc[_tile];
+
+            for (int y = 0; y < _map_height; ++y)
+            {
+                for (int x0 = 0; x0 < _map_width; x0 += _tile)
+                {
+                    const int n = RVN_MIN(_tile, _map_width - x0);
+                    std::fill(acc, acc + n, 0.0f);
+
+                    for (int i = 0; i < kh; ++i)
+                    {
+                        const float* src = luma + (y + i) * stride + x0;
+                        const float* weights = rf + i * rf_stride;
+
+                        for (int j = 0; j < kw; ++j)
+                        {
+                            axpy(weights[j], src + j, acc, n);
+                        }
+                    }
+
+                    std::copy(acc, acc + n, out + y * _map_width + x0);
+                }
+            }
+        }
+        else
+        {
+            // strided positions don't share a contiguous run of luma, so
+            // just do a dot product per row of the RF
+            for (int y = 0; y < _map_height; ++y)
+            {
+                for (int x = 0; x < _map_width; ++x)
+                {
+                    const float* src = luma + (y * _step) * stride + x * _step;
+
+                    float xy = 0.0f;
+                    for (int i = 0; i < kh; ++i)
+                    {
+                        xy += dot(src + i * stride, rf + i * rf_stride, kw);
+                    }
+                    out[y * _map_width + x] = xy;
+                }
+            }
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void CorrelationMap::correlate_fft(const float* luma, int stride, float* out)
+    {
+        _fft->forward(luma, _width, _height, stride, _re.data(), _im.data());
+
+        float* re = _re.data();
+        float* im = _im.data();
+        const float* rf_re = _rf_re.data();
+        const float* rf_im = _rf_im.data();
+
+        const int ns = _fft->spectrum_size();
+        for (int k = 0; k < ns; ++k)
+        {
+            const float r = re[k] * rf_re[k] - im[k] * rf_im[k];
+            const float i = re[k] * rf_im[k] + im[k] * rf_re[k];
+            re[k] = r;
+            im[k] = i;
+        }
+
+        // only the rows / columns that land on the map are transformed back,
+        // none of them wrap around (as the transform is at least as big as
+        // the frame) so the circular correlation is the linear one
+        const int rows = (_map_height - 1) * _step + 1;
+        const int cols = (_map_width - 1) * _step + 1;
+
+        _fft->inverse(re, im, cols, rows, _width, _dense.data());
+
+        for (int y = 0; y < _map_height; ++y)
+        {
+            const float* src = _dense.data() + (y * _step) * _width;
+            float* dst = out + y * _map_width;
+
+            for (int x = 0; x < _map_width; ++x)
+            {
+                dst[x] = src[x * _step];
+            }
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void CorrelationMap::correlate_separable(const float* luma, int stride,
+        float* out)
+    {
+        const int kw = _rf.width();
+        const int kh = _rf.height();
+        const int rows = (_map_height - 1) * _step + kh;
+
+        float* tmp = _sep.data();
+
+        std::fill(out, out + _map_width * _map_height, 0.0f);
+
+        for (int c = 0; c < _rf.rank(); ++c)
+        {
+            const float* row_filter = _rf.sep_row(c);
+            const float* col_filter = _rf.sep_col(c);
+
+            // every frame row against the component's row, as in the direct
+            // path: axpys over a contiguous run of luma at step 1 and a dot
+            // product per position otherwise
+            for (int y = 0; y < rows; ++y)
+            {
+                const float* src = luma + y * stride;
+                float* dst = tmp + y * _map_width;
+
+                if (_step == 1)
+                {
+                    std::fill(dst, dst + _map_width, 0.0f);
+                    for (int j = 0; j < kw; ++j)
+                    {
+                        axpy(row_filter[j], src + j, dst, _map_width);
+                    }
+                }
+                else
+                {
+                    for (int x = 0; x < _map_width; ++x)
+                    {
+                        dst[x] = dot(src + x * _step, row_filter, kw);
+                    }
+                }
+            }
+
+            // ...and the columns of that against the component's column
+            for (int y = 0; y < _map_height; ++y)
+            {
+                float* dst = out + y * _map_width;
+                const float* src = tmp + (y * _step) * _map_width;
+
+                for (int i = 0; i < kh; ++i)
+                {
+                    axpy(col_filter[i], src + i * _map_width, dst, _map_width);
+                }
+            }
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void CorrelationMap::integral_energy(const float* luma, int stride)
+    {
+        const int w1 = _width + 1;
+
+        std::fill(_sum2.begin(), _sum2.begin() + w1, 0.0);
+
+        for (int y = 0; y < _height; ++y)
+        {
+            const float* src = luma + y * stride;
+            const double* above = &_sum2[y * w1];
+            double* row = &_sum2[(y + 1) * w1];
+
+            double run = 0.0;
+            row[0] = 0.0;
+
+            for (int x = 0; x < _width; ++x)
+            {
+                run += ((double)src[x]) * src[x];
+                row[x + 1] = above[x + 1] + run;
+            }
+        }
+    }
+    /* ====================================================================== */
+}
@@ -0,0 +1,104 @@
+#ifndef RAVINE_CORRELATION_MAP_HPP_
+#define RAVINE_CORRELATION_MAP_HPP_
+
+#include <vector>
+
+#include "ravine_fft.hpp"
+#include "ravine_receptive_field.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    enum class MapMethod { Auto, Direct, FFT, Separable };
+
+    inline const char* method_name(MapMethod m)
+    {
+        switch (m)
+        {
+            case MapMethod::Direct: return "direct";
+            case MapMethod::FFT: return "fft";
+            case MapMethod::Separable: return "separable";
+            default: return "auto";
+        }
+    }
+    /* ====================================================================== */
+    // the NeuronFilter activation of an RF placed at every <step>'th position
+    // of a width x height frame: map pixel (x, y) is the response of the RF
+    // w/ it's top-left corner at (x * step, y * step)
+    //
+    // the zero-mean dot products come from either a tiled direct correlation
+    // (small RFs), an FFT (large RFs) or, for RFs w/ a separable
+    // approximation (see ReceptiveField::separate()), a row and a column pass
+    // per component. The frame energy under each window comes from an
+    // integral image of the squared luma
+    class CorrelationMap
+    {
+    public:
+        CorrelationMap(const ReceptiveField& rf, int width, int height,
+            int step, MapMethod method = MapMethod::Auto);
+        ~CorrelationMap();
+
+        CorrelationMap(const CorrelationMap&) = delete;
+        CorrelationMap& operator=(const CorrelationMap&) = delete;
+
+        // <luma> is the frame's luma (as floats, w/ the frame mean already
+        // subtracted), <stride> floats per row, <out> receives
+        // map_width() x map_height() activations
+        void compute(const float* luma, int stride, float* out);
+
+        inline bool isvalid() const { return _map_width > 0 && _map_height > 0; }
+
+        inline int map_width() const { return _map_width; }
+        inline int map_height() const { return _map_height; }
+        inline int step() const { return _step; }
+
+        // the method actually in use (never MapMethod::Auto)
+        inline MapMethod method() const { return _method; }
+
+        // estimated speedup of the separable path over the better of direct
+        // and FFT for this frame size and step (the cost model Auto uses),
+        // below 1 if it's slower, 0 if the RF has no separable approximation
+        inline float separable_gain() const { return _separable_gain; }
+
+    private:
+        void correlate_direct(const float* luma, int stride, float* out);
+        void correlate_fft(const float* luma, int stride, float* out);
+        void correlate_separable(const float* luma, int stride, float* out);
+        void integral_energy(const float* luma, int stride);
+
+    private:
+        const ReceptiveField& _rf;
+
+        int _width;
+        int _height;
+        int _step;
+
+        int _map_width = 0;
+        int _map_height = 0;
+
+        MapMethod _method;
+
+        float _separable_gain = 0.0f;
+
+        // integral image of luma^2, (width + 1) x (height + 1)
+        std::vector<double> _sum2;
+
+        // FFT path: the conjugate spectrum of the RF, scratch for the frame's
+        // spectrum and the full (dense) correlation
+        RealFFT2D* _fft = nullptr;
+        std::vector<float> _rf_re;
+        std::vector<float> _rf_im;
+        std::vector<float> _re;
+        std::vector<float> _im;
+        std::vector<float> _dense;
+
+        // separable path: the row pass of one component, for every frame
+        // row the map covers
+        std::vector<float> _sep;
+
+        // number of map columns computed together by the direct path
+        static constexpr int _tile = 64;
+    };
+    /* ====================================================================== */
+}
+#endif
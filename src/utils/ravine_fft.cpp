@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cmath>
+
+#include "ravine_fft.hpp"
+
+namespace RVN
+{
+    static const double pi = 3.14159265358979323846;
+    /* ====================================================================== */
+    FFT::FFT(int n) : _n(n)
+    {
+        int nbit = 0;
+        while ((1 << nbit) < n) { ++nbit; }
+
+        for (int k = 0; k < n; ++k)
+        {
+            int rev = 0;
+            for (int b = 0; b < nbit; ++b)
+            {
+                rev |= ((k >> b) & 1) << (nbit - 1 - b);
+            }
+
+            if (k < rev)
+            {
+                _swap.push_back(k);
+                _swap.push_back(rev);
+            }
+        }
+
+        _cos.resize(std::max(n - 1, 1));
+        _sin.resize(std::max(n - 1, 1));
+
+        for (int half = 1; half < n; half <<= 1)
+        {
+            for (int j = 0; j < half; ++j)
+            {
+                const double theta = pi * j / half;
+                _cos[half - 1 + j] = (float)cos(theta);
+                _sin[half - 1 + j] = (float)sin(theta);
+            }
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void FFT::transform(float* re, float* im, bool inverse) const
+    {
+        for (size_t k = 0; k < _swap.size(); k += 2)
+        {
+            std::swap(re[_swap[k]], re[_swap[k+1]]);
+            std::swap(im[_swap[k]], im[_swap[k+1]]);
+        }
+
+        // e^(-i*theta) for the forward transform, e^(+i*theta) for inverse
+        const float sign = inverse ? 1.0f : -1.0f;
+
+        for (int half = 1; half < _n; half <<= 1)
+        {
+            const float* wc = &_cos[half - 1];
+            const float* ws = &_sin[half - 1];
+
+            for (int k = 0; k < _n; k += 2*half)
+            {
+                float* ar = re + k;
+                float* ai = im + k;
+                float* br = re + k + half;
+                float* bi = im + k + half;
+
+                for (int j = 0; j < half; ++j)
+                {
+                    const float wr = wc[j];
+                    const float wi = sign * ws[j];
+
+                    const float xr = br[j] * wr - bi[j] * wi;
+                    const float xi = br[j] * wi + bi[j] * wr;
+
+                    br[j] = ar[j] - xr;
+                    bi[j] = ai[j] - xi;
+                    ar[j] += xr;
+                    ai[j] += xi;
+                }
+            }
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void FFT::transform_batch(float* re, float* im, int count, int stride,
+        bool inverse) const
+    {
+        for (size_t k = 0; k < _swap.size(); k += 2)
+        {
+            std::swap_ranges(re + _swap[k] * stride,
+                re + _swap[k] * stride + count, re + _swap[k+1] * stride);
+            std::swap_ranges(im + _swap[k] * stride,
+                im + _swap[k] * stride + count, im + _swap[k+1] * stride);
+        }
+
+        const float sign = inverse ? 1.0f : -1.0f;
+
+        for (int half = 1; half < _n; half <<= 1)
+        {
+            for (int k = 0; k < _n; k += 2*half)
+            {
+                for (int j = 0; j < half; ++j)
+                {
+                    const float wr = _cos[half - 1 + j];
+                    const float wi = sign * _sin[half - 1 + j];
+
+                    float* ar = re + (k + j) * stride;
+                    float* ai = im + (k + j) * stride;
+                    float* br = re + (k + j + half) * stride;
+                    float* bi = im + (k + j + half) * stride;
+
+                    // same twiddle for every sequence
+                    for (int c = 0; c < count; ++c)
+                    {
+                        const float xr = br[c] * wr - bi[c] * wi;
+                        const float xi = br[c] * wi + bi[c] * wr;
+
+                        br[c] = ar[c] - xr;
+                        bi[c] = ai[c] - xi;
+                        ar[c] += xr;
+                        ai[c] += xi;
+                    }
+                }
+            }
+        }
+    }
+    /* ====================================================================== */
+    RealFFT2D::RealFFT2D(int width, int height) :
+        _width(width),
+        _height(height),
+        _row_fft(width),
+        _col_fft(height),
+        _zre(width),
+        _zim(width) {}
+    /* ---------------------------------------------------------------------- */
+    void RealFFT2D::forward(const float* in, int in_width, int in_height,
+        int in_stride, float* re, float* im)
+    {
+        const int ns = spectrum_width();
+        const int mask = _width - 1;
+
+        in_width = std::min(in_width, _width);
+        in_height = std::min(in_height, _height);
+
+        // rows are transformed in pairs: as both are real, one complex FFT
+        // of (row a + i * row b) holds both spectra
+        for (int r = 0; r < in_height; r += 2)
+        {
+            std::fill(_zre.begin(), _zre.end(), 0.0f);
+            std::fill(_zim.begin(), _zim.end(), 0.0f);
+
+            std::copy(in + r * in_stride, in + r * in_stride + in_width,
+                _zre.begin());
+
+            if (r + 1 < in_height)
+            {
+                std::copy(in + (r + 1) * in_stride,
+                    in + (r + 1) * in_stride + in_width, _zim.begin());
+            }
+
+            _row_fft.forward(_zre.data(), _zim.data());
+
+            float* are = re + r * ns;
+            float* aim = im + r * ns;
+            float* bre = are + ns;
+            float* bim = aim + ns;
+
+            const bool second = r + 1 < _height;
+
+            for (int k = 0; k < ns; ++k)
+            {
+                const int nk = (_width - k) & mask;
+
+                // A = (Z[k] + conj(Z[-k])) / 2, B = (Z[k] - conj(Z[-k])) / 2i
+                are[k] = 0.5f * (_zre[k] + _zre[nk]);
+                aim[k] = 0.5f * (_zim[k] - _zim[nk]);
+
+                if (second)
+                {
+                    bre[k] = 0.5f * (_zim[k] + _zim[nk]);
+                    bim[k] = -0.5f * (_zre[k] - _zre[nk]);
+                }
+            }
+        }
+
+        // rows past the input are all 0, and so are their spectra
+        const int done = std::min(_height, in_height + (in_height & 1));
+        std::fill(re + done * ns, re + _height * ns, 0.0f);
+        std::fill(im + done * ns, im + _height * ns, 0.0f);
+
+        _col_fft.forward_batch(re, im, ns, ns);
+    }
+    /* ---------------------------------------------------------------------- */
+    void RealFFT2D::inverse(float* re, float* im, int out_width,
+        int out_height, int out_stride, float* out)
+    {
+        const int ns = spectrum_width();
+        const int half = _width / 2;
+        const float scale = 1.0f / (((float)_width) * ((float)_height));
+
+        out_width = std::min(out_width, _width);
+        out_height = std::min(out_height, _height);
+
+        _col_fft.inverse_batch(re, im, ns, ns);
+
+        // again two rows at a time, only for the rows that are wanted
+        for (int r = 0; r < out_height; r += 2)
+        {
+            const float* are = re + r * ns;
+            const float* aim = im + r * ns;
+
+            const bool second = r + 1 < _height;
+            const float* bre = second ? are + ns : nullptr;
+            const float* bim = second ? aim + ns : nullptr;
+
+            // Z = A + iB, using the hermitian symmetry of A and B to fill in
+            // the negative frequencies
+            for (int k = 0; k <= half; ++k)
+            {
+                const float br = second ? bre[k] : 0.0f;
+                const float bi = second ? bim[k] : 0.0f;
+                _zre[k] = are[k] - bi;
+                _zim[k] = aim[k] + br;
+            }
+
+            for (int k = half + 1; k < _width; ++k)
+            {
+                const int m = _width - k;
+                const float br = second ? bre[m] : 0.0f;
+                const float bi = second ? bim[m] : 0.0f;
+                _zre[k] = are[m] + bi;
+                _zim[k] = br - aim[m];
+            }
+
+            _row_fft.inverse(_zre.data(), _zim.data());
+
+            float* row = out + r * out_stride;
+            for (int k = 0; k < out_width; ++k) { row[k] = _zre[k] * scale; }
+
+            if (r + 1 < out_height)
+            {
+                row += out_stride;
+                for (int k = 0; k < out_width; ++k)
+                {
+                    row[k] = _zim[k] * scale;
+                }
+            }
+        }
+    }
+    /* ====================================================================== */
+}
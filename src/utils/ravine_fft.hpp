@@ -0,0 +1,103 @@
+#ifndef RAVINE_FFT_HPP_
+#define RAVINE_FFT_HPP_
+
+#include <vector>
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // true iff <n> is a (positive) power of 2
+    inline bool is_pow2(int n) { return n > 0 && (n & (n - 1)) == 0; }
+
+    // smallest power of 2 >= <n>
+    inline int next_pow2(int n)
+    {
+        int p = 1;
+        while (p < n) { p <<= 1; }
+        return p;
+    }
+    /* ====================================================================== */
+    // in-place radix-2 complex FFT on split (separate real / imaginary)
+    // arrays, the inverse is *NOT* scaled by 1/n
+    class FFT
+    {
+    public:
+        FFT(int n);
+
+        inline int size() const { return _n; }
+
+        // transform a single contiguous sequence of size() elements
+        void forward(float* re, float* im) const { transform(re, im, false); }
+        void inverse(float* re, float* im) const { transform(re, im, true); }
+
+        // transform <count> sequences at once, element k of sequence j is at
+        // [k * stride + j] (i.e. the columns of a row-major 2D array), the
+        // inner loop runs along the rows so this vectorizes and stays cache
+        // friendly
+        void forward_batch(float* re, float* im, int count, int stride) const
+        {
+            transform_batch(re, im, count, stride, false);
+        }
+
+        void inverse_batch(float* re, float* im, int count, int stride) const
+        {
+            transform_batch(re, im, count, stride, true);
+        }
+
+    private:
+        void transform(float* re, float* im, bool inverse) const;
+        void transform_batch(float* re, float* im, int count, int stride,
+            bool inverse) const;
+
+    private:
+        int _n;
+
+        // bit reversal permutation, as a list of pairs to swap
+        std::vector<int> _swap;
+
+        // twiddle factors for each stage, stored contiguously: stage w/
+        // butterfly span <half> starts at index <half - 1>
+        std::vector<float> _cos;
+        std::vector<float> _sin;
+    };
+    /* ====================================================================== */
+    // 2D FFT of real data, of size width x height (both powers of 2). The
+    // spectrum holds only the non-negative horizontal frequencies, so it is
+    // height rows of spectrum_width() = width/2 + 1 complex values (split
+    // into real and imaginary planes)
+    class RealFFT2D
+    {
+    public:
+        RealFFT2D(int width, int height);
+
+        inline int width() const { return _width; }
+        inline int height() const { return _height; }
+        inline int spectrum_width() const { return _width / 2 + 1; }
+        inline int spectrum_size() const { return spectrum_width() * _height; }
+
+        // <in> is <in_height> rows of <in_width> floats, <in_stride> apart,
+        // everything outside of that is treated as 0
+        void forward(const float* in, int in_width, int in_height,
+            int in_stride, float* re, float* im);
+
+        // inverse transform (scaled by 1/(width*height), so that
+        // inverse(forward(x)) == x), only the first <out_height> rows and
+        // <out_width> columns are written to <out> (<out_stride> apart), the
+        // spectrum is used as scratch space and so is destroyed
+        void inverse(float* re, float* im, int out_width, int out_height,
+            int out_stride, float* out);
+
+    private:
+        int _width;
+        int _height;
+
+        FFT _row_fft;
+        FFT _col_fft;
+
+        // one row of complex scratch for packing pairs of real rows
+        std::vector<float> _zre;
+        std::vector<float> _zim;
+    };
+    /* ====================================================================== */
+}
+#endif
@@ -0,0 +1,102 @@
+#include <cstdio>
+
+#include "ravine_frame_budget.hpp"
+
+#define NSTAGE 4
+
+namespace RVN
+{
+    /* ====================================================================== */
+    const char* stage_name(Stage stage)
+    {
+        switch (stage)
+        {
+            case Stage::Capture: return "capture";
+            case Stage::Luma: return "luma";
+            case Stage::Neuron: return "neuron";
+            default: return "dispatch";
+        }
+    }
+    /* ====================================================================== */
+    bool FrameBudget::report()
+    {
+        bool fits = true;
+        double sum = 0.0;
+
+        printf("[BUDGET]: %.2f ms per frame (%.1f fps)\n", _interval,
+            1000.0f / _interval);
+
+        for (int k = 0; k < NSTAGE; ++k)
+        {
+            Counter& c = _stages[k];
+
+            const int64_t n = c.count.exchange(0);
+            const int64_t total = c.total.exchange(0);
+            const int64_t mx = c.max.exchange(0);
+            const int64_t over = c.over.exchange(0);
+
+            const char* name = stage_name((Stage)k);
+
+            if (n < 1)
+            {
+                printf("    %-8s: no frames\n", name);
+                continue;
+            }
+
+            const double mean = total * 1e-3 / n;
+            sum += mean;
+
+            const bool ok = mean <= _interval;
+            fits = fits && ok;
+
+            printf("    %-8s: mean %7.3f ms (%5.1f%%), max %7.3f ms, %lld of "
+                "%lld over -> %s\n", name, mean, 100.0 * mean / _interval,
+                mx * 1e-3, (long long)over, (long long)n,
+                ok ? "fits" : "DOES NOT FIT");
+        }
+
+        printf("    all stages: %.3f ms (%.1f%%) if run back to back\n", sum,
+            100.0 * sum / _interval);
+
+        return fits;
+    }
+    /* ---------------------------------------------------------------------- */
+    uint64_t FrameBudget::report_overruns()
+    {
+        uint64_t total_over = 0;
+
+        int64_t over[NSTAGE];
+        int64_t mx[NSTAGE];
+
+        for (int k = 0; k < NSTAGE; ++k)
+        {
+            Counter& c = _stages[k];
+
+            c.count.store(0);
+            c.total.store(0);
+            mx[k] = c.max.exchange(0);
+            over[k] = c.over.exchange(0);
+
+            total_over += over[k];
+        }
+
+        if (total_over > 0)
+        {
+            printf("[BUDGET]: %llu overruns of %.2f ms:",
+                (unsigned long long)total_over, _interval);
+
+            for (int k = 0; k < NSTAGE; ++k)
+            {
+                if (over[k] > 0)
+                {
+                    printf(" %s %lld (max %.3f ms)", stage_name((Stage)k),
+                        (long long)over[k], mx[k] * 1e-3);
+                }
+            }
+            printf("\n");
+        }
+
+        return total_over;
+    }
+    /* ====================================================================== */
+}
@@ -0,0 +1,85 @@
+#ifndef RAVINE_FRAME_BUDGET_HPP_
+#define RAVINE_FRAME_BUDGET_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // the per-frame stages of the pipeline:
+    //      Capture  - dequeue, timestamp (and decode) a frame
+    //      Luma     - the pass over the frame's luma for it's mean
+    //      Neuron   - correlating the RF(s) w/ the frame
+    //      Dispatch - thresholding the response(s) and sending the spikes
+    enum class Stage { Capture, Luma, Neuron, Dispatch };
+
+    const char* stage_name(Stage stage);
+    /* ====================================================================== */
+    // how long each stage takes per frame, compared to the frame interval:
+    // every stage has to fit in one interval to keep up (the stages on
+    // different threads run in parallel, each on a different frame).
+    // add() is called by whichever thread runs a stage (one thread per
+    // stage), the reports can be made from any thread
+    class FrameBudget
+    {
+    public:
+        typedef std::chrono::steady_clock::time_point time_point;
+
+        FrameBudget(float fps) { set_framerate(fps); }
+
+        inline void set_framerate(float fps) { _interval = 1000.0f / fps; }
+        inline float interval() const { return _interval; }
+
+        static inline time_point now()
+        {
+            return std::chrono::steady_clock::now();
+        }
+
+        // record that <stage> took from <t0> to now
+        inline void add(Stage stage, time_point t0)
+        {
+            const int64_t us = std::chrono::duration_cast<
+                std::chrono::microseconds>(now() - t0).count();
+
+            Counter& c = _stages[(int)stage];
+
+            c.count.fetch_add(1, std::memory_order_relaxed);
+            c.total.fetch_add(us, std::memory_order_relaxed);
+
+            int64_t mx = c.max.load(std::memory_order_relaxed);
+            while (us > mx && !c.max.compare_exchange_weak(mx, us)) {}
+
+            if (us > _interval * 1000.0f)
+            {
+                c.over.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        // print every stage's mean and max vs. the frame interval (for the
+        // time since the last report), returns false if any stage doesn't
+        // fit on average
+        bool report();
+
+        // print the stages that went over the interval since the last
+        // report, if any, returns the number of overruns
+        uint64_t report_overruns();
+
+    private:
+        struct Counter
+        {
+            std::atomic<int64_t> count{0};
+            std::atomic<int64_t> total{0};
+            std::atomic<int64_t> max{0};
+            std::atomic<int64_t> over{0};
+        };
+
+        // ms
+        float _interval;
+
+        Counter _stages[4];
+    };
+    /* ====================================================================== */
+}
+#endif
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <cmath>
+
+#include "ravine_simd.hpp"
+#include "ravine_integral_image.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // running sums along one row: <run>[k] = sum of the first k + 1 of the
+    // <n> luma samples (<step> bytes apart) of <src>, <run2> the same for
+    // their squares, positions past <n> repeat the last sum
+    static void prefix_row(const uint8_t* src, int step, int n, int width,
+        uint32_t* run, uint32_t* run2)
+    {
+        int k = 0;
+        uint32_t a = 0, a2 = 0;
+
+#if defined(RVN_SIMD_AVX2) || defined(RVN_SIMD_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i mask = _mm_set1_epi16(0x00ff);
+
+        __m128i carry = zero, carry2 = zero;
+
+        // 16 samples per iteration as 4 x 4 uint32, each scanned in register
+        // (two shifted adds) and offset by the last sum of the one before
+        for (; k + 16 <= n; k += 16)
+        {
+            __m128i y8;
+            if (step == 2)
+            {
+                const __m128i lo = _mm_loadu_si128((const __m128i*)(src + 2*k));
+                const __m128i hi = _mm_loadu_si128(
+                    (const __m128i*)(src + 2*k + 16));
+                y8 = _mm_packus_epi16(_mm_and_si128(lo, mask),
+                    _mm_and_si128(hi, mask));
+            }
+            else
+            {
+                y8 = _mm_loadu_si128((const __m128i*)(src + k));
+            }
+
+            const __m128i lo16 = _mm_unpacklo_epi8(y8, zero);
+            const __m128i hi16 = _mm_unpackhi_epi8(y8, zero);
+
+            // 255^2 still fits in 16 bits
+            const __m128i sq_lo = _mm_mullo_epi16(lo16, lo16);
+            const __m128i sq_hi = _mm_mullo_epi16(hi16, hi16);
+
+            __m128i v[4] = {
+                _mm_unpacklo_epi16(lo16, zero), _mm_unpackhi_epi16(lo16, zero),
+                _mm_unpacklo_epi16(hi16, zero), _mm_unpackhi_epi16(hi16, zero)
+            };
+            __m128i v2[4] = {
+                _mm_unpacklo_epi16(sq_lo, zero),
+                _mm_unpackhi_epi16(sq_lo, zero),
+                _mm_unpacklo_epi16(sq_hi, zero),
+                _mm_unpackhi_epi16(sq_hi, zero)
+            };
+
+            for (int j = 0; j < 4; ++j)
+            {
+                v[j] = _mm_add_epi32(v[j], _mm_slli_si128(v[j], 4));
+                v[j] = _mm_add_epi32(v[j], _mm_slli_si128(v[j], 8));
+                v[j] = _mm_add_epi32(v[j], carry);
+                carry = _mm_shuffle_epi32(v[j], 0xff);
+                _mm_storeu_si128((__m128i*)(run + k + 4*j), v[j]);
+
+                v2[j] = _mm_add_epi32(v2[j], _mm_slli_si128(v2[j], 4));
+                v2[j] = _mm_add_epi32(v2[j], _mm_slli_si128(v2[j], 8));
+                v2[j] = _mm_add_epi32(v2[j], carry2);
+                carry2 = _mm_shuffle_epi32(v2[j], 0xff);
+                _mm_storeu_si128((__m128i*)(run2 + k + 4*j), v2[j]);
+            }
+        }
+
+        if (k > 0)
+        {
+            a = run[k - 1];
+            a2 = run2[k - 1];
+        }
+
+#elif defined(RVN_SIMD_NEON)
+        const uint32x4_t zero = vdupq_n_u32(0);
+
+        uint32x4_t carry = zero, carry2 = zero;
+
+        for (; k + 16 <= n; k += 16)
+        {
+            const uint8x16_t y8 = step == 2 ? vld2q_u8(src + 2*k).val[0] :
+                vld1q_u8(src + k);
+
+            const uint16x8_t lo16 = vmovl_u8(vget_low_u8(y8));
+            const uint16x8_t hi16 = vmovl_u8(vget_high_u8(y8));
+
+            const uint16x8_t sq_lo = vmulq_u16(lo16, lo16);
+            const uint16x8_t sq_hi = vmulq_u16(hi16, hi16);
+
+            uint32x4_t v[4] = {
+                vmovl_u16(vget_low_u16(lo16)), vmovl_u16(vget_high_u16(lo16)),
+                vmovl_u16(vget_low_u16(hi16)), vmovl_u16(vget_high_u16(hi16))
+            };
+            uint32x4_t v2[4] = {
+                vmovl_u16(vget_low_u16(sq_lo)), vmovl_u16(vget_high_u16(sq_lo)),
+                vmovl_u16(vget_low_u16(sq_hi)), vmovl_u16(vget_high_u16(sq_hi))
+            };
+
+            for (int j = 0; j < 4; ++j)
+            {
+                v[j] = vaddq_u32(v[j], vextq_u32(zero, v[j], 3));
+                v[j] = vaddq_u32(v[j], vextq_u32(zero, v[j], 2));
+                v[j] = vaddq_u32(v[j], carry);
+                carry = vdupq_n_u32(vgetq_lane_u32(v[j], 3));
+                vst1q_u32(run + k + 4*j, v[j]);
+
+                v2[j] = vaddq_u32(v2[j], vextq_u32(zero, v2[j], 3));
+                v2[j] = vaddq_u32(v2[j], vextq_u32(zero, v2[j], 2));
+                v2[j] = vaddq_u32(v2[j], carry2);
+                carry2 = vdupq_n_u32(vgetq_lane_u32(v2[j], 3));
+                vst1q_u32(run2 + k + 4*j, v2[j]);
+            }
+        }
+
+        if (k > 0)
+        {
+            a = run[k - 1];
+            a2 = run2[k - 1];
+        }
+#endif
+
+        for (; k < n; ++k)
+        {
+            const uint32_t yi = src[k * step];
+            a += yi;
+            a2 += yi * yi;
+            run[k] = a;
+            run2[k] = a2;
+        }
+
+        for (; k < width; ++k)
+        {
+            run[k] = a;
+            run2[k] = a2;
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    // <row> = <above> + <run> (and the same for the squares, widened to 64
+    // bits) over <n> columns
+    static void add_row(const uint32_t* above, const uint32_t* run,
+        const uint64_t* above2, const uint32_t* run2, int n, uint32_t* row,
+        uint64_t* row2)
+    {
+        int k = 0;
+
+#if defined(RVN_SIMD_AVX2) || defined(RVN_SIMD_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        for (; k + 4 <= n; k += 4)
+        {
+            _mm_storeu_si128((__m128i*)(row + k), _mm_add_epi32(
+                _mm_loadu_si128((const __m128i*)(above + k)),
+                _mm_loadu_si128((const __m128i*)(run + k))));
+
+            const __m128i r2 = _mm_loadu_si128((const __m128i*)(run2 + k));
+
+            _mm_storeu_si128((__m128i*)(row2 + k), _mm_add_epi64(
+                _mm_loadu_si128((const __m128i*)(above2 + k)),
+                _mm_unpacklo_epi32(r2, zero)));
+            _mm_storeu_si128((__m128i*)(row2 + k + 2), _mm_add_epi64(
+                _mm_loadu_si128((const __m128i*)(above2 + k + 2)),
+                _mm_unpackhi_epi32(r2, zero)));
+        }
+#elif defined(RVN_SIMD_NEON)
+        for (; k + 4 <= n; k += 4)
+        {
+            vst1q_u32(row + k, vaddq_u32(vld1q_u32(above + k),
+                vld1q_u32(run + k)));
+
+            const uint32x4_t r2 = vld1q_u32(run2 + k);
+
+            vst1q_u64(row2 + k, vaddw_u32(vld1q_u64(above2 + k),
+                vget_low_u32(r2)));
+            vst1q_u64(row2 + k + 2, vaddw_u32(vld1q_u64(above2 + k + 2),
+                vget_high_u32(r2)));
+        }
+#endif
+
+        for (; k < n; ++k)
+        {
+            row[k] = above[k] + run[k];
+            row2[k] = above2[k] + run2[k];
+        }
+    }
+    /* ====================================================================== */
+    void IntegralImage::build(const ImagePacket* packet, length_t bytes)
+    {
+        const int width = packet->width();
+        const int height = packet->height();
+        const int step = packet->luma_step();
+        const int stride = packet->luma_stride();
+        const uint8_t* luma = packet->luma();
+
+        bytes = packet->luma_bytes(bytes);
+
+        const int w1 = width + 1;
+
+        if (width != _width || height != _height)
+        {
+            _width = width;
+            _height = height;
+
+            // the first row and column are never written after this
+            _sum.assign(w1 * (height + 1), 0);
+            _sum2.assign(w1 * (height + 1), 0);
+            _run.resize(width);
+            _run2.resize(width);
+        }
+
+        _full_rows = 0;
+        _partial = 0;
+
+        bool whole = true;
+
+        for (int y = 0; y < height; ++y)
+        {
+            const length_t start = y * stride;
+
+            // as in correlate_luma(), samples at or past <bytes> are skipped
+            const int n = start < bytes ? RVN_MIN(width,
+                (int)((bytes - start + step - 1) / step)) : 0;
+
+            if (whole && n == width)
+            {
+                ++_full_rows;
+            }
+            else if (whole)
+            {
+                _partial = n;
+                whole = false;
+            }
+
+            prefix_row(luma + start, step, n, width, _run.data(),
+                _run2.data());
+
+            add_row(&_sum[y * w1 + 1], _run.data(), &_sum2[y * w1 + 1],
+                _run2.data(), width, &_sum[(y + 1) * w1 + 1],
+                &_sum2[(y + 1) * w1 + 1]);
+        }
+
+        const CropWindow all = {0, 0, width, height};
+        const uint32_t n = count(all);
+
+        _frame_mean = n > 0 ? ((double)sum(all)) / n : 0.0;
+    }
+    /* ---------------------------------------------------------------------- */
+    inline CropWindow IntegralImage::clip(const CropWindow& win) const
+    {
+        const int x0 = RVN_MAX(win.col, 0);
+        const int y0 = RVN_MAX(win.row, 0);
+        const int x1 = RVN_MIN(win.col + win.width, _width);
+        const int y1 = RVN_MIN(win.row + win.height, _height);
+
+        return {x0, y0, RVN_MAX(x1 - x0, 0), RVN_MAX(y1 - y0, 0)};
+    }
+    /* ---------------------------------------------------------------------- */
+    uint64_t IntegralImage::sum(const CropWindow& win) const
+    {
+        // the table wraps around past 2^32, the difference is still exact
+        // for any rectangle whose sum fits
+        return (uint32_t)lookup(_sum, clip(win));
+    }
+    /* ---------------------------------------------------------------------- */
+    uint64_t IntegralImage::sum2(const CropWindow& win) const
+    {
+        return lookup(_sum2, clip(win));
+    }
+    /* ---------------------------------------------------------------------- */
+    uint32_t IntegralImage::count(const CropWindow& win) const
+    {
+        const CropWindow c = clip(win);
+
+        if (c.width < 1 || c.height < 1) { return 0; }
+
+        const int y1 = c.row + c.height;
+
+        uint32_t n = RVN_MAX(RVN_MIN(y1, _full_rows) - c.row, 0) * c.width;
+
+        if (_full_rows >= c.row && _full_rows < y1)
+        {
+            n += RVN_MAX(RVN_MIN(c.col + c.width, _partial) - c.col, 0);
+        }
+
+        return n;
+    }
+    /* ---------------------------------------------------------------------- */
+    double IntegralImage::mean(const CropWindow& win) const
+    {
+        const uint32_t n = count(win);
+        return n > 0 ? ((double)sum(win)) / n : 0.0;
+    }
+    /* ---------------------------------------------------------------------- */
+    double IntegralImage::energy(const CropWindow& win, double offset) const
+    {
+        const double e = (double)sum2(win) - offset * (2.0 * sum(win) -
+            offset * count(win));
+
+        return RVN_MAX(e, 0.0);
+    }
+    /* ---------------------------------------------------------------------- */
+    float IntegralImage::box_dog(const CropWindow& center,
+        const CropWindow& surround, double offset) const
+    {
+        const uint32_t nc = count(center);
+        const uint32_t ns = count(surround);
+
+        if (nc < 1 || ns <= nc) { return 0.0f; }
+
+        // the kernel sums to 0, so the offset drops out of the product, and
+        // it's squared norm is 1 / nc - 1 / ns
+        const double xy = ((double)sum(center)) / nc -
+            ((double)sum(surround)) / ns;
+        const double mag = 1.0 / nc - 1.0 / ns;
+        const double e = energy(surround, offset);
+
+        return e > 0.0 ? (float)(xy / sqrt(mag * e)) : 0.0f;
+    }
+    /* ====================================================================== */
+}
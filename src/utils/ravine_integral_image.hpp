@@ -0,0 +1,86 @@
+#ifndef RAVINE_INTEGRAL_IMAGE_HPP_
+#define RAVINE_INTEGRAL_IMAGE_HPP_
+
+#include <vector>
+
+#include <cinttypes>
+
+#include "ravine_packets.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // summed-area tables of a frame's luma and of it's square, built once per
+    // frame (see IntegralFilter) so that the sum, mean and energy of any
+    // rectangle cost 4 lookups each. Rectangles are in luma pixels, clipped
+    // to the frame, and (as everywhere else) pixels at or past the <bytes>
+    // the frame was built w/ don't count
+    class IntegralImage
+    {
+    public:
+        // (re)build the tables for the first <bytes> bytes of <packet>
+        void build(const ImagePacket* packet, length_t bytes);
+
+        inline int width() const { return _width; }
+        inline int height() const { return _height; }
+
+        uint64_t sum(const CropWindow& win) const;
+        uint64_t sum2(const CropWindow& win) const;
+
+        // number of (valid) pixels w/in <win>
+        uint32_t count(const CropWindow& win) const;
+
+        double mean(const CropWindow& win) const;
+
+        // sum((y - <offset>)^2) over <win>, w/ the frame mean as <offset>
+        // this is the energy the neuron models normalize by
+        double energy(const CropWindow& win, double offset) const;
+
+        // luma mean of the whole frame
+        inline double frame_mean() const { return _frame_mean; }
+
+        // the normalized correlation (as for an RF, see NeuronFilter) of a
+        // box difference-of-Gaussians: +1 / area over <center> minus 1 /
+        // area over <surround> (which should contain it), i.e. the
+        // difference of their means over the square root of the kernel's
+        // and the surround's energies. <offset> is the frame mean
+        float box_dog(const CropWindow& center, const CropWindow& surround,
+            double offset) const;
+
+    private:
+        inline CropWindow clip(const CropWindow& win) const;
+
+        template <class T>
+        inline T lookup(const std::vector<T>& table, const CropWindow& win)
+            const
+        {
+            const int w1 = _width + 1;
+            const int x0 = win.col, x1 = win.col + win.width;
+            const int y0 = win.row, y1 = win.row + win.height;
+
+            return table[y1 * w1 + x1] - table[y1 * w1 + x0] -
+                table[y0 * w1 + x1] + table[y0 * w1 + x0];
+        }
+
+    private:
+        int _width = 0;
+        int _height = 0;
+
+        // rows [0, _full_rows) are whole, row _full_rows has the first
+        // _partial pixels, later rows have none
+        int _full_rows = 0;
+        int _partial = 0;
+
+        double _frame_mean = 0.0;
+
+        // (width + 1) x (height + 1), the first row and column are 0
+        std::vector<uint32_t> _sum;
+        std::vector<uint64_t> _sum2;
+
+        // one row's running sums
+        std::vector<uint32_t> _run;
+        std::vector<uint32_t> _run2;
+    };
+    /* ====================================================================== */
+}
+#endif
@@ -0,0 +1,121 @@
+#include "ravine_jpeg.hpp"
+
+#if defined(RVN_USE_JPEG)
+#include <csetjmp>
+#include <cstdio>
+
+extern "C"
+{
+#include <jpeglib.h>
+}
+#endif
+
+namespace RVN
+{
+#if defined(RVN_USE_JPEG)
+    /* ====================================================================== */
+    struct JpegDecoder::State
+    {
+        jpeg_decompress_struct cinfo;
+
+        // libjpeg's default error handler exit()s, so we jump back to
+        // decode_luma() instead
+        jpeg_error_mgr err;
+        jmp_buf jump;
+        char msg[JMSG_LENGTH_MAX];
+    };
+    /* ---------------------------------------------------------------------- */
+    static void jpeg_error_exit(j_common_ptr cinfo)
+    {
+        JpegDecoder::State* state = (JpegDecoder::State*)cinfo->client_data;
+        (*cinfo->err->format_message)(cinfo, state->msg);
+        longjmp(state->jump, 1);
+    }
+    /* ---------------------------------------------------------------------- */
+    static void jpeg_no_output(j_common_ptr /* cinfo */) {}
+    /* ====================================================================== */
+    JpegDecoder::JpegDecoder() : _state(new State)
+    {
+        _state->cinfo.err = jpeg_std_error(&_state->err);
+        _state->err.error_exit = &jpeg_error_exit;
+
+        // corrupt-data warnings are common w/ webcam MJPEG and not fatal
+        _state->err.output_message = &jpeg_no_output;
+
+        _state->cinfo.client_data = _state;
+
+        jpeg_create_decompress(&_state->cinfo);
+    }
+    /* ---------------------------------------------------------------------- */
+    JpegDecoder::~JpegDecoder()
+    {
+        jpeg_destroy_decompress(&_state->cinfo);
+        delete _state;
+    }
+    /* ---------------------------------------------------------------------- */
+    bool JpegDecoder::available() { return true; }
+    /* ---------------------------------------------------------------------- */
+    bool JpegDecoder::decode_luma(const uint8_t* src, uint32_t bytes,
+        uint8_t* dst, int width, int height, int stride)
+    {
+        jpeg_decompress_struct* cinfo = &_state->cinfo;
+
+        if (setjmp(_state->jump))
+        {
+            _err_msg = _state->msg;
+            jpeg_abort_decompress(cinfo);
+            return false;
+        }
+
+        jpeg_mem_src(cinfo, (unsigned char*)src, bytes);
+
+        // NOTE: MJPEG frames usually leave out the (standard) huffman tables,
+        // libjpeg-turbo fills them in for us
+        (void)jpeg_read_header(cinfo, TRUE);
+
+        // asking for grayscale output from a YCbCr image is what skips all
+        // of the chroma work
+        cinfo->out_color_space = JCS_GRAYSCALE;
+        cinfo->dct_method = JDCT_IFAST;
+        cinfo->do_fancy_upsampling = FALSE;
+        cinfo->do_block_smoothing = FALSE;
+
+        (void)jpeg_start_decompress(cinfo);
+
+        if ((int)cinfo->output_width != width ||
+            (int)cinfo->output_height != height)
+        {
+            _err_msg = "Unexpected JPEG frame size";
+            jpeg_abort_decompress(cinfo);
+            return false;
+        }
+
+        while (cinfo->output_scanline < cinfo->output_height)
+        {
+            JSAMPROW row = dst + cinfo->output_scanline * stride;
+            (void)jpeg_read_scanlines(cinfo, &row, 1);
+        }
+
+        (void)jpeg_finish_decompress(cinfo);
+
+        return true;
+    }
+#else
+    /* ====================================================================== */
+    struct JpegDecoder::State {};
+    /* ---------------------------------------------------------------------- */
+    JpegDecoder::JpegDecoder() {}
+    /* ---------------------------------------------------------------------- */
+    JpegDecoder::~JpegDecoder() {}
+    /* ---------------------------------------------------------------------- */
+    bool JpegDecoder::available() { return false; }
+    /* ---------------------------------------------------------------------- */
+    bool JpegDecoder::decode_luma(const uint8_t*, uint32_t, uint8_t*, int, int,
+        int)
+    {
+        _err_msg = "Built w/o JPEG support (make JPEG=1)";
+        return false;
+    }
+#endif
+    /* ====================================================================== */
+}
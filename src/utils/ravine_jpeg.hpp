@@ -0,0 +1,45 @@
+#ifndef RAVINE_JPEG_HPP_
+#define RAVINE_JPEG_HPP_
+
+#include <cinttypes>
+#include <string>
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // decodes only the luma of (M)JPEG frames: the chroma components are
+    // entropy decoded (they have to be, to get to the next block) but never
+    // inverse transformed, upsampled or color converted
+    //
+    // only available when built w/ RVN_USE_JPEG (make JPEG=1), otherwise
+    // available() is false and decode_luma() always fails
+    class JpegDecoder
+    {
+    public:
+        JpegDecoder();
+        ~JpegDecoder();
+
+        JpegDecoder(const JpegDecoder&) = delete;
+        JpegDecoder& operator=(const JpegDecoder&) = delete;
+
+        static bool available();
+
+        // decode the <bytes> of compressed data at <src> into the 8-bit luma
+        // image <dst> (<stride> bytes per row), which must be exactly
+        // <width> x <height>
+        bool decode_luma(const uint8_t* src, uint32_t bytes, uint8_t* dst,
+            int width, int height, int stride);
+
+        inline const std::string& get_error_msg() const { return _err_msg; }
+
+        // libjpeg state, kept out of the header
+        struct State;
+
+    private:
+        State* _state = nullptr;
+
+        std::string _err_msg;
+    };
+    /* ====================================================================== */
+}
+#endif
@@ -1,72 +1,309 @@
+#include "ravine_simd.hpp"
 #include "ravine_pink_noise.hpp"
 
 #define PINK_RANDOM_BITS       (24)
-#define PINK_RANDOM_SHIFT      ((sizeof(long)*8)-PINK_RANDOM_BITS)
+#define PINK_RANDOM_SHIFT      (32-PINK_RANDOM_BITS)
+
+// samples hashed / summed at a time by fill()
+#define PINK_CHUNK             (256)
 
 namespace RVN
 {
     /* ====================================================================== */
-    static unsigned long random_sample()
+    static inline uint64_t splitmix64(uint64_t& state)
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+    /* ---------------------------------------------------------------------- */
+    // a 32 bit integer hash (Wellons' "lowbias32"), a bijection w/ good
+    // avalanche, that only needs shifts, xors and 32 bit multiplies
+    static inline uint32_t lowbias32(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+    /* ---------------------------------------------------------------------- */
+    // the signed 24 bit random value for counter <i> of the stream keyed by
+    // <k0>, <k1>: two rounds of the hash, the counter's high word folded into
+    // the second round's key
+    static inline int32_t random_value(uint64_t i, uint32_t k0, uint32_t k1)
+    {
+        const uint32_t key = k1 ^ ((uint32_t)(i >> 32) * 0x9e3779b9U);
+        const uint32_t h = lowbias32(lowbias32((uint32_t)i ^ k0) + key);
+        return (int32_t)h >> PINK_RANDOM_SHIFT;
+    }
+    /* ---------------------------------------------------------------------- */
+#if defined(RVN_SIMD_SSE2)
+    // SSE2 has no 32 bit multiply (low half), so the even and odd lanes go
+    // through the 32 x 32 -> 64 one and are put back together
+    static inline __m128i mullo32(__m128i a, __m128i b)
     {
-        /* Change this seed for different random sequences. */
-        static unsigned long seed = 22222;
-        seed = (seed * 196314165) + 907633515;
-        return seed;
+        const __m128i even = _mm_mul_epu32(a, b);
+        const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32),
+            _mm_srli_epi64(b, 32));
+        return _mm_unpacklo_epi32(
+            _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+    /* ---------------------------------------------------------------------- */
+#endif
+    // random_value() for the counters <lo> ... <lo> + <n> - 1, which share a
+    // high word (folded into <k1> by the caller)
+    static void random_values(int32_t* out, uint32_t lo, int n, uint32_t k0,
+        uint32_t k1)
+    {
+        int k = 0;
+
+#if defined(RVN_SIMD_AVX2)
+        const __m256i m1 = _mm256_set1_epi32(0x7feb352d);
+        const __m256i m2 = _mm256_set1_epi32((int32_t)0x846ca68bU);
+        const __m256i key0 = _mm256_set1_epi32(k0);
+        const __m256i key1 = _mm256_set1_epi32(k1);
+        __m256i i = _mm256_add_epi32(_mm256_set1_epi32(lo),
+            _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+        for (; k + 8 <= n; k += 8)
+        {
+            __m256i x = _mm256_xor_si256(i, key0);
+            for (int round = 0; round < 2; ++round)
+            {
+                x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+                x = _mm256_mullo_epi32(x, m1);
+                x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+                x = _mm256_mullo_epi32(x, m2);
+                x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+
+                if (round == 0) { x = _mm256_add_epi32(x, key1); }
+            }
+
+            _mm256_storeu_si256((__m256i*)(out + k),
+                _mm256_srai_epi32(x, PINK_RANDOM_SHIFT));
+            i = _mm256_add_epi32(i, _mm256_set1_epi32(8));
+        }
+#elif defined(RVN_SIMD_SSE2)
+        const __m128i m1 = _mm_set1_epi32(0x7feb352d);
+        const __m128i m2 = _mm_set1_epi32((int32_t)0x846ca68bU);
+        const __m128i key0 = _mm_set1_epi32(k0);
+        const __m128i key1 = _mm_set1_epi32(k1);
+        __m128i i = _mm_add_epi32(_mm_set1_epi32(lo),
+            _mm_setr_epi32(0, 1, 2, 3));
+
+        for (; k + 4 <= n; k += 4)
+        {
+            __m128i x = _mm_xor_si128(i, key0);
+            for (int round = 0; round < 2; ++round)
+            {
+                x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+                x = mullo32(x, m1);
+                x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+                x = mullo32(x, m2);
+                x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+
+                if (round == 0) { x = _mm_add_epi32(x, key1); }
+            }
+
+            _mm_storeu_si128((__m128i*)(out + k),
+                _mm_srai_epi32(x, PINK_RANDOM_SHIFT));
+            i = _mm_add_epi32(i, _mm_set1_epi32(4));
+        }
+#elif defined(RVN_SIMD_NEON)
+        const uint32x4_t m1 = vdupq_n_u32(0x7feb352dU);
+        const uint32x4_t m2 = vdupq_n_u32(0x846ca68bU);
+        const uint32x4_t key0 = vdupq_n_u32(k0);
+        const uint32x4_t key1 = vdupq_n_u32(k1);
+        const uint32_t step[4] = {0, 1, 2, 3};
+        uint32x4_t i = vaddq_u32(vdupq_n_u32(lo), vld1q_u32(step));
+
+        for (; k + 4 <= n; k += 4)
+        {
+            uint32x4_t x = veorq_u32(i, key0);
+            for (int round = 0; round < 2; ++round)
+            {
+                x = veorq_u32(x, vshrq_n_u32(x, 16));
+                x = vmulq_u32(x, m1);
+                x = veorq_u32(x, vshrq_n_u32(x, 15));
+                x = vmulq_u32(x, m2);
+                x = veorq_u32(x, vshrq_n_u32(x, 16));
+
+                if (round == 0) { x = vaddq_u32(x, key1); }
+            }
+
+            vst1q_s32(out + k,
+                vshrq_n_s32(vreinterpretq_s32_u32(x), PINK_RANDOM_SHIFT));
+            i = vaddq_u32(i, vdupq_n_u32(4));
+        }
+#endif
+
+        for (; k < n; ++k)
+        {
+            const uint32_t h = lowbias32(lowbias32((lo + k) ^ k0) + k1);
+            out[k] = (int32_t)h >> PINK_RANDOM_SHIFT;
+        }
     }
     /* ====================================================================== */
-    PinkNoise::PinkNoise(int nrow, float noise_level) :
-        _sum(0),
-        _index(0),
-        _index_mask((1<<nrow) - 1)
+    PinkNoise::PinkNoise(int nrow, float noise_level, uint64_t seed) :
+        _seed(seed),
+        _nrow(nrow),
+        _index_mask((1u << nrow) - 1)
     {
-        long pmax;
+        // one pair of keys for the rows' stream and one for the white noise
+        uint64_t state = seed;
+        for (int k = 0; k < 4; k += 2)
+        {
+            const uint64_t z = splitmix64(state);
+            _key[k] = (uint32_t)z;
+            _key[k + 1] = (uint32_t)(z >> 32);
+        }
 
         /* Calculate maximum possible signed random value.
          * Extra 1 for white noise always added.
          * */
-        pmax = (nrow + 1) * (1 << (PINK_RANDOM_BITS - 1));
+        const long pmax = (nrow + 1) * (1L << (PINK_RANDOM_BITS - 1));
         _scalar = noise_level / pmax;
 
-        /* Initialize rows. */
-        for(int k = 0; k < nrow; ++k) { _rows[k] = 0; }
+        seek(0);
     }
     /* ---------------------------------------------------------------------- */
-    float PinkNoise::next_sample()
+    int32_t PinkNoise::row_value(uint64_t i) const
     {
-        long new_sample;
-        long sum;
-
-        /* Increment and mask index. */
-        int idx = next_index();
+        return random_value(i, _key[0], _key[1]);
+    }
+    /* ---------------------------------------------------------------------- */
+    int32_t PinkNoise::white_value(uint64_t i) const
+    {
+        return random_value(i, _key[2], _key[3]);
+    }
+    /* ---------------------------------------------------------------------- */
+    void PinkNoise::seek(uint64_t sample)
+    {
+        // sample n is made w/ counter n + 1, and row r was last drawn at the
+        // latest counter <= n w/ r trailing zeros, i.e. 2^r (mod 2^(r+1))
+        _count = sample;
+        _sum = 0;
 
-        /* If index is zero, don't update any random values. */
-        if(idx != 0 )
+        for (int r = 0; r < _nrow; ++r)
         {
-            /* Determine how many trailing zeros in _index. */
-            /* This algorithm will hang if idx==0 so test first. */
-            int nzero = 0;
-            while((idx & 1) == 0)
+            const uint64_t p = 1ULL << r;
+
+            _rows[r] = 0;
+            if (sample >= p)
             {
-                idx = idx >> 1;
-                ++nzero;
+                _rows[r] = row_value(((sample - p) & ~(2 * p - 1)) + p);
             }
 
+            _sum += _rows[r];
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    float PinkNoise::next_sample()
+    {
+        const uint64_t i = ++_count;
+
+        /* If index is zero, don't update any random values. */
+        const uint32_t idx = (uint32_t)i & _index_mask;
+        if (idx != 0)
+        {
             /* Replace the indexed ROWS random value.
              * Subtract and add back to _sum instead of adding all the random
              * values together. Only one changes each time.
              */
-            _sum -= _rows[nzero];
-            new_sample = ((long)random_sample()) >> PINK_RANDOM_SHIFT;
-            _sum += new_sample;
-            _rows[nzero] = new_sample;
+            const int nzero = __builtin_ctz(idx);
+            const int32_t value = row_value(i);
+
+            _sum += value - _rows[nzero];
+            _rows[nzero] = value;
+        }
+
+        /* Add extra white noise value, scale to range of -1.0 to 0.9999. */
+        return _scalar * (float)(_sum + white_value(i));
+    }
+    /* ---------------------------------------------------------------------- */
+    void PinkNoise::sums(int32_t* out, int n)
+    {
+        int32_t rows[PINK_CHUNK];
+
+        const uint64_t first = _count + 1;
+        const uint32_t lo = (uint32_t)first;
+        const uint32_t hi = (uint32_t)(first >> 32) * 0x9e3779b9U;
+
+        // every random value of the chunk at once, vectorized
+        random_values(rows, lo, n, _key[0], _key[1] ^ hi);
+        random_values(out, lo, n, _key[2], _key[3] ^ hi);
+
+        // then the (serial, but cheap) running sum of the rows
+        int32_t total = _sum;
+        for (int k = 0; k < n; ++k)
+        {
+            const uint32_t idx = (lo + k) & _index_mask;
+            if (idx != 0)
+            {
+                const int nzero = __builtin_ctz(idx);
+
+                total += rows[k] - _rows[nzero];
+                _rows[nzero] = rows[k];
+            }
+
+            out[k] += total;
         }
 
-        /* Add extra white noise value. */
-        new_sample = ((long)random_sample()) >> PINK_RANDOM_SHIFT;
-        sum = _sum + new_sample;
+        _sum = total;
+        _count += n;
+    }
+    /* ---------------------------------------------------------------------- */
+    void PinkNoise::fill(float* out, int n)
+    {
+        int32_t values[PINK_CHUNK];
+
+        for (int k0 = 0; k0 < n; )
+        {
+            // a chunk never spans a change in the counter's high word
+            const uint64_t span = (1ULL << 32) - ((_count + 1) & 0xffffffffULL);
+
+            int len = n - k0 < PINK_CHUNK ? n - k0 : PINK_CHUNK;
+            if ((uint64_t)len > span) { len = (int)span; }
 
-        /* Scale to range of -1.0 to 0.9999. */
-        return _scalar * (float)sum;
+            sums(values, len);
+
+            // w/in +/- (nrow + 1) 2^23, which can be past 2^24 and so round
+            // when converted, but the same way next_sample() does
+            float* dst = out + k0;
+            int k = 0;
+
+#if defined(RVN_SIMD_AVX2)
+            const __m256 scale = _mm256_set1_ps(_scalar);
+            for (; k + 8 <= len; k += 8)
+            {
+                __m256i v = _mm256_loadu_si256((const __m256i*)(values + k));
+                _mm256_storeu_ps(dst + k,
+                    _mm256_mul_ps(scale, _mm256_cvtepi32_ps(v)));
+            }
+#elif defined(RVN_SIMD_SSE2)
+            const __m128 scale = _mm_set1_ps(_scalar);
+            for (; k + 4 <= len; k += 4)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)(values + k));
+                _mm_storeu_ps(dst + k, _mm_mul_ps(scale, _mm_cvtepi32_ps(v)));
+            }
+#elif defined(RVN_SIMD_NEON)
+            const float32x4_t scale = vdupq_n_f32(_scalar);
+            for (; k + 4 <= len; k += 4)
+            {
+                vst1q_f32(dst + k,
+                    vmulq_f32(scale, vcvtq_f32_s32(vld1q_s32(values + k))));
+            }
+#endif
+
+            for (; k < len; ++k) { dst[k] = _scalar * (float)values[k]; }
+
+            k0 += len;
+        }
     }
     /* ====================================================================== */
 }
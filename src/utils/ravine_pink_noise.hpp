@@ -1,28 +1,59 @@
 #ifndef RAVINE_PINK_NOISE_HPP_
 #define RAVINE_PINK_NOISE_HPP_
 
+#include <cinttypes>
+
 #define PINK_MAX_RANDOM_ROWS   (30)
 
 namespace RVN
 {
+    /* ====================================================================== */
+    // Voss-McCartney pink noise: <nrow> white noise rows, row r updated every
+    // 2^(r+1) samples, summed w/ one more white sample each sample. Every
+    // random value is a hash of the generator's seed and the index of the
+    // sample it's drawn for (a counter-based RNG), so each instance has it's
+    // own stream that can be started from any sample: the noise of a run can
+    // be regenerated offline from it's seed and sample index alone
     class PinkNoise
     {
     public:
-        PinkNoise(int nrow, float noise_level);
+        PinkNoise(int nrow, float noise_level,
+            uint64_t seed = 0x2545f4914f6cdd1dULL);
+
         float next_sample();
 
-        inline int next_index()
-        {
-            _index = (_index + 1) & _index_mask;
-            return _index;
-        }
+        // the next <n> samples into <out>, as a block (much cheaper than <n>
+        // calls to next_sample())
+        void fill(float* out, int n);
+
+        // make <sample> the next one produced, O(nrow) for any <sample>
+        void seek(uint64_t sample);
+
+        // index of the next sample
+        inline uint64_t position() const { return _count; }
+        inline uint64_t seed() const { return _seed; }
 
     private:
-        long      _rows[PINK_MAX_RANDOM_ROWS];
-        long      _sum;          /* Used to optimize summing of generators. */
-        int       _index;        /* Incremented each sample. */
-        int       _index_mask;   /* Index wrapped by ANDing with this mask. */
-        float     _scalar;       /* Used to scale within range of -1.0 to +1.0 */
+        // the random values of the rows / the white noise for sample
+        // counter <i>, signed 24 bit
+        int32_t row_value(uint64_t i) const;
+        int32_t white_value(uint64_t i) const;
+
+        // the sums of the next <n> (at most 256, w/in one 2^32 span of the
+        // counter) samples
+        void sums(int32_t* out, int n);
+
+    private:
+        uint64_t  _seed;
+        uint32_t  _key[4];       /* Per stream hash keys, from the seed. */
+
+        int       _nrow;
+        int32_t   _rows[PINK_MAX_RANDOM_ROWS];
+        int32_t   _sum;          /* Used to optimize summing of generators. */
+        uint64_t  _count;        /* Samples produced so far. */
+        uint32_t  _index_mask;   /* Index wrapped by ANDing with this mask. */
+        float     _scalar;       /* Scales the sum to w/in -1.0 to +1.0 */
     };
+    /* ====================================================================== */
 }
 #endif
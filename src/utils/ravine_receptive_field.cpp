@@ -0,0 +1,1191 @@
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cmath>
+
+#include "ravine_simd.hpp"
+#include "ravine_receptive_field.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    uint64_t sum_bytes(const uint8_t* data, int length)
+    {
+        uint64_t total = 0;
+        int k = 0;
+
+#if defined(RVN_SIMD_AVX2)
+        // sad against 0 sums each group of 8 bytes into a 64-bit lane
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i acc = _mm256_setzero_si256();
+        for (; k + 32 <= length; k += 32)
+        {
+            __m256i raw = _mm256_loadu_si256((const __m256i*)(data + k));
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(raw, zero));
+        }
+
+        uint64_t tmp[4];
+        _mm256_storeu_si256((__m256i*)tmp, acc);
+        total = tmp[0] + tmp[1] + tmp[2] + tmp[3];
+
+#elif defined(RVN_SIMD_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_setzero_si128();
+        for (; k + 16 <= length; k += 16)
+        {
+            __m128i raw = _mm_loadu_si128((const __m128i*)(data + k));
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(raw, zero));
+        }
+
+        uint64_t tmp[2];
+        _mm_storeu_si128((__m128i*)tmp, acc);
+        total = tmp[0] + tmp[1];
+
+#elif defined(RVN_SIMD_NEON)
+        // pairwise widening adds: u8 -> u16 -> u32 -> u64, the u16 stage
+        // can't overflow as it only ever holds the sum of 2 bytes
+        uint64x2_t acc = vdupq_n_u64(0);
+        for (; k + 16 <= length; k += 16)
+        {
+            uint16x8_t s16 = vpaddlq_u8(vld1q_u8(data + k));
+            acc = vpadalq_u32(acc, vpaddlq_u16(s16));
+        }
+        total = vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+#endif
+
+        for (; k < length; ++k) { total += data[k]; }
+
+        return total;
+    }
+    /* ---------------------------------------------------------------------- */
+    float mean(const uint8_t* data, int length)
+    {
+        // integer accumulation is exact (unlike summing 100k+ floats)
+        return ((float)sum_bytes(data, length)) / length;
+    }
+    /* ---------------------------------------------------------------------- */
+    float two_norm(const uint8_t* data, int length, float& mn)
+    {
+        mn = mean(data, length);
+        float mag = 0.0f;
+        for (int k = 0; k < length; ++k)
+        {
+            float tmp = ((float)data[k]) - mn;
+            mag += tmp*tmp;
+        }
+
+        return mag;
+    }
+    /* ---------------------------------------------------------------------- */
+    // sum of the even bytes of <data> (the Y of YUYV)
+    static uint64_t sum_even_bytes(const uint8_t* data, int length)
+    {
+        uint64_t total = 0;
+        int k = 0;
+
+#if defined(RVN_SIMD_AVX2)
+        // masking off the odd bytes leaves sad w/ only the luma to sum
+        const __m256i mask = _mm256_set1_epi16(0x00ff);
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i acc = _mm256_setzero_si256();
+        for (; k + 32 <= length; k += 32)
+        {
+            __m256i raw = _mm256_loadu_si256((const __m256i*)(data + k));
+            acc = _mm256_add_epi64(acc,
+                _mm256_sad_epu8(_mm256_and_si256(raw, mask), zero));
+        }
+
+        uint64_t tmp[4];
+        _mm256_storeu_si256((__m256i*)tmp, acc);
+        total = tmp[0] + tmp[1] + tmp[2] + tmp[3];
+
+#elif defined(RVN_SIMD_SSE2)
+        const __m128i mask = _mm_set1_epi16(0x00ff);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_setzero_si128();
+        for (; k + 16 <= length; k += 16)
+        {
+            __m128i raw = _mm_loadu_si128((const __m128i*)(data + k));
+            acc = _mm_add_epi64(acc,
+                _mm_sad_epu8(_mm_and_si128(raw, mask), zero));
+        }
+
+        uint64_t tmp[2];
+        _mm_storeu_si128((__m128i*)tmp, acc);
+        total = tmp[0] + tmp[1];
+
+#elif defined(RVN_SIMD_NEON)
+        uint64x2_t acc = vdupq_n_u64(0);
+        for (; k + 32 <= length; k += 32)
+        {
+            uint16x8_t s16 = vpaddlq_u8(vld2q_u8(data + k).val[0]);
+            acc = vpadalq_u32(acc, vpaddlq_u16(s16));
+        }
+        total = vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+#endif
+
+        for (; k < length; k += 2) { total += data[k]; }
+
+        return total;
+    }
+    /* ---------------------------------------------------------------------- */
+    uint64_t sum_luma(const ImagePacket* packet, length_t bytes, uint32_t& n)
+    {
+        bytes = packet->luma_bytes(bytes);
+
+        if (packet->luma_step() == 2)
+        {
+            n = (bytes + 1) / 2;
+            return sum_even_bytes(packet->luma(), bytes);
+        }
+
+        n = bytes;
+        return sum_bytes(packet->luma(), bytes);
+    }
+    /* ---------------------------------------------------------------------- */
+    double luma_mean(const ImagePacket* packet, length_t bytes)
+    {
+        uint32_t n = 0;
+        const uint64_t total = sum_luma(packet, bytes, n);
+
+        return n > 0 ? ((double)total) / n : 0.0;
+    }
+    /* ====================================================================== */
+    // accumulate one row of <n> YUYV luma samples (every other byte of <src>)
+    static inline void correlate_row(const uint8_t* src, const float* rf, int n,
+        float offset, float& xy, float& energy)
+    {
+        int k = 0;
+
+#if defined(RVN_SIMD_AVX2)
+        const __m128i mask = _mm_set1_epi16(0x00ff);
+        const __m256 off = _mm256_set1_ps(offset);
+
+        __m256 acc_xy = _mm256_setzero_ps();
+        __m256 acc_e = _mm256_setzero_ps();
+
+        // 8 pixels (16 bytes) per iteration, masking off the chroma bytes
+        // leaves the luma as 8 x uint16
+        for (; k + 8 <= n; k += 8)
+        {
+            __m128i raw = _mm_loadu_si128((const __m128i*)(src + 2*k));
+            __m256i y32 = _mm256_cvtepu16_epi32(_mm_and_si128(raw, mask));
+            __m256 y = _mm256_sub_ps(_mm256_cvtepi32_ps(y32), off);
+
+            acc_xy = _mm256_fmadd_ps(y, _mm256_load_ps(rf + k), acc_xy);
+            acc_e = _mm256_fmadd_ps(y, y, acc_e);
+        }
+
+        // fold down to 4 lanes and reduce
+        __m128 sxy = _mm_add_ps(_mm256_castps256_ps128(acc_xy),
+            _mm256_extractf128_ps(acc_xy, 1));
+        __m128 se = _mm_add_ps(_mm256_castps256_ps128(acc_e),
+            _mm256_extractf128_ps(acc_e, 1));
+
+        float tmp[4];
+        _mm_storeu_ps(tmp, sxy);
+        xy += (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+        _mm_storeu_ps(tmp, se);
+        energy += (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+
+#elif defined(RVN_SIMD_SSE2)
+        const __m128i mask = _mm_set1_epi16(0x00ff);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 off = _mm_set1_ps(offset);
+
+        __m128 acc_xy = _mm_setzero_ps();
+        __m128 acc_e = _mm_setzero_ps();
+
+        for (; k + 8 <= n; k += 8)
+        {
+            __m128i raw = _mm_loadu_si128((const __m128i*)(src + 2*k));
+            __m128i y16 = _mm_and_si128(raw, mask);
+
+            __m128 y0 = _mm_sub_ps(
+                _mm_cvtepi32_ps(_mm_unpacklo_epi16(y16, zero)), off);
+            __m128 y1 = _mm_sub_ps(
+                _mm_cvtepi32_ps(_mm_unpackhi_epi16(y16, zero)), off);
+
+            acc_xy = _mm_add_ps(acc_xy, _mm_mul_ps(y0, _mm_load_ps(rf + k)));
+            acc_xy = _mm_add_ps(acc_xy, _mm_mul_ps(y1, _mm_load_ps(rf + k + 4)));
+
+            acc_e = _mm_add_ps(acc_e, _mm_mul_ps(y0, y0));
+            acc_e = _mm_add_ps(acc_e, _mm_mul_ps(y1, y1));
+        }
+
+        float tmp[4];
+        _mm_storeu_ps(tmp, acc_xy);
+        xy += (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+        _mm_storeu_ps(tmp, acc_e);
+        energy += (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+
+#elif defined(RVN_SIMD_NEON)
+        const float32x4_t off = vdupq_n_f32(offset);
+
+        float32x4_t acc_xy = vdupq_n_f32(0.0f);
+        float32x4_t acc_e = vdupq_n_f32(0.0f);
+
+        // vld2 de-interleaves for us: val[0] is 16 luma, val[1] 16 chroma
+        for (; k + 16 <= n; k += 16)
+        {
+            uint8x16x2_t raw = vld2q_u8(src + 2*k);
+
+            uint16x8_t lo = vmovl_u8(vget_low_u8(raw.val[0]));
+            uint16x8_t hi = vmovl_u8(vget_high_u8(raw.val[0]));
+
+            float32x4_t y[4] = {
+                vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), off),
+                vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), off),
+                vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), off),
+                vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), off)
+            };
+
+            for (int j = 0; j < 4; ++j)
+            {
+                acc_xy = vmlaq_f32(acc_xy, y[j], vld1q_f32(rf + k + 4*j));
+                acc_e = vmlaq_f32(acc_e, y[j], y[j]);
+            }
+        }
+
+        float tmp[4];
+        vst1q_f32(tmp, acc_xy);
+        xy += (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+        vst1q_f32(tmp, acc_e);
+        energy += (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+#endif
+
+        // whatever is left over (or everything if no SIMD available)
+        for (; k < n; ++k)
+        {
+            const float yi = ((float)src[2*k]) - offset;
+            xy += yi * rf[k];
+            energy += yi * yi;
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void correlate_luma(const uint8_t* luma, int step, int stride,
+        length_t bytes, const CropWindow& win, const float* rf, int rf_stride,
+        float offset, float& xy, float& energy)
+    {
+        xy = 0.0f;
+        energy = 0.0f;
+
+        const int first_col = win.col * step;
+
+        // packed luma has no fused kernel, rows are converted a chunk at a
+        // time (small enough to stay in L1) and then dotted w/ the RF
+        alignas(RVN_SIMD_ALIGN) float chunk[256];
+
+        for (int k = 0; k < win.height; ++k)
+        {
+            const length_t start = (win.row + k) * stride + first_col;
+
+            // the bounds check is done once per row rather than per pixel:
+            // pixels that begin at or past <bytes> are skipped (and as rows
+            // only get further along, so is every row after this one)
+            if (start >= bytes) { break; }
+
+            const int n = RVN_MIN(win.width,
+                (int)((bytes - start + step - 1) / step));
+
+            const uint8_t* src = luma + start;
+            const float* weights = rf + k * rf_stride;
+
+            if (step == 2)
+            {
+                correlate_row(src, weights, n, offset, xy, energy);
+            }
+            else
+            {
+                // 256 is a multiple of every SIMD width, so each chunk of the
+                // RF row stays aligned
+                for (int j = 0; j < n; j += 256)
+                {
+                    const int m = RVN_MIN(256, n - j);
+                    luma_row(src + j * step, step, m, offset, chunk);
+                    dot_energy(chunk, weights + j, m, xy, energy);
+                }
+            }
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    // 8 luma samples, <STEP> bytes apart, from <src> as floats
+#if defined(RVN_SIMD_AVX2)
+    template <int STEP>
+    static inline __m256 load_luma8(const uint8_t* src)
+    {
+        if (STEP == 2)
+        {
+            const __m128i raw = _mm_loadu_si128((const __m128i*)src);
+            return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(
+                _mm_and_si128(raw, _mm_set1_epi16(0x00ff))));
+        }
+        return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+            _mm_loadl_epi64((const __m128i*)src)));
+    }
+#elif defined(RVN_SIMD_SSE2)
+    template <int STEP>
+    static inline void load_luma8(const uint8_t* src, __m128& lo, __m128& hi)
+    {
+        const __m128i zero = _mm_setzero_si128();
+
+        __m128i y16;
+        if (STEP == 2)
+        {
+            y16 = _mm_and_si128(_mm_loadu_si128((const __m128i*)src),
+                _mm_set1_epi16(0x00ff));
+        }
+        else
+        {
+            y16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)src),
+                zero);
+        }
+
+        lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(y16, zero));
+        hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(y16, zero));
+    }
+#elif defined(RVN_SIMD_NEON)
+    template <int STEP>
+    static inline void load_luma8(const uint8_t* src, float32x4_t& lo,
+        float32x4_t& hi)
+    {
+        const uint16x8_t y16 = vmovl_u8(STEP == 2 ? vld2_u8(src).val[0] :
+            vld1_u8(src));
+
+        lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(y16)));
+        hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(y16)));
+    }
+#endif
+    /* ---------------------------------------------------------------------- */
+    // correlate_luma() w/ every loop bound a constant: no per row bounds
+    // check or tail, the RF rows are contiguous (W is a multiple of the SIMD
+    // width, so it's stride is W) and the accumulators are only reduced
+    // once per window rather than once per row. 16 pixels per iteration in
+    // two independent chains (to hide the latency of the adds)
+    template <int W, int H, int STEP>
+    static void correlate_sized(const uint8_t* luma, int stride,
+        const float* rf, float offset, float& xy, float& energy)
+    {
+        static_assert(W % 16 == 0, "sized RF rows must be a multiple of 16");
+
+        float tmp[8];
+
+#if defined(RVN_SIMD_AVX2)
+        const __m256 off = _mm256_set1_ps(offset);
+
+        __m256 axy0 = _mm256_setzero_ps(), axy1 = _mm256_setzero_ps();
+        __m256 ae0 = _mm256_setzero_ps(), ae1 = _mm256_setzero_ps();
+
+        for (int k = 0; k < H; ++k, luma += stride, rf += W)
+        {
+            for (int j = 0; j < W; j += 16)
+            {
+                const __m256 y0 = _mm256_sub_ps(
+                    load_luma8<STEP>(luma + j * STEP), off);
+                const __m256 y1 = _mm256_sub_ps(
+                    load_luma8<STEP>(luma + (j + 8) * STEP), off);
+
+                axy0 = _mm256_fmadd_ps(y0, _mm256_load_ps(rf + j), axy0);
+                axy1 = _mm256_fmadd_ps(y1, _mm256_load_ps(rf + j + 8), axy1);
+                ae0 = _mm256_fmadd_ps(y0, y0, ae0);
+                ae1 = _mm256_fmadd_ps(y1, y1, ae1);
+            }
+        }
+
+        _mm256_storeu_ps(tmp, _mm256_add_ps(axy0, axy1));
+        xy = ((tmp[0] + tmp[1]) + (tmp[2] + tmp[3])) +
+            ((tmp[4] + tmp[5]) + (tmp[6] + tmp[7]));
+        _mm256_storeu_ps(tmp, _mm256_add_ps(ae0, ae1));
+        energy = ((tmp[0] + tmp[1]) + (tmp[2] + tmp[3])) +
+            ((tmp[4] + tmp[5]) + (tmp[6] + tmp[7]));
+
+#elif defined(RVN_SIMD_SSE2) || defined(RVN_SIMD_NEON)
+    #if defined(RVN_SIMD_SSE2)
+        typedef __m128 vec;
+        #define RVN_VSUB(a, b) _mm_sub_ps(a, b)
+        #define RVN_VMLA(acc, a, b) _mm_add_ps(acc, _mm_mul_ps(a, b))
+        #define RVN_VLOAD(p) _mm_load_ps(p)
+        const vec off = _mm_set1_ps(offset);
+        vec axy0 = _mm_setzero_ps(), axy1 = axy0, ae0 = axy0, ae1 = axy0;
+    #else
+        typedef float32x4_t vec;
+        #define RVN_VSUB(a, b) vsubq_f32(a, b)
+        #define RVN_VMLA(acc, a, b) vmlaq_f32(acc, a, b)
+        #define RVN_VLOAD(p) vld1q_f32(p)
+        const vec off = vdupq_n_f32(offset);
+        vec axy0 = vdupq_n_f32(0.0f), axy1 = axy0, ae0 = axy0, ae1 = axy0;
+    #endif
+
+        for (int k = 0; k < H; ++k, luma += stride, rf += W)
+        {
+            for (int j = 0; j < W; j += 8)
+            {
+                vec y0, y1;
+                load_luma8<STEP>(luma + j * STEP, y0, y1);
+
+                y0 = RVN_VSUB(y0, off);
+                y1 = RVN_VSUB(y1, off);
+
+                axy0 = RVN_VMLA(axy0, y0, RVN_VLOAD(rf + j));
+                axy1 = RVN_VMLA(axy1, y1, RVN_VLOAD(rf + j + 4));
+                ae0 = RVN_VMLA(ae0, y0, y0);
+                ae1 = RVN_VMLA(ae1, y1, y1);
+            }
+        }
+
+    #if defined(RVN_SIMD_SSE2)
+        _mm_storeu_ps(tmp, _mm_add_ps(axy0, axy1));
+        _mm_storeu_ps(tmp + 4, _mm_add_ps(ae0, ae1));
+    #else
+        vst1q_f32(tmp, vaddq_f32(axy0, axy1));
+        vst1q_f32(tmp + 4, vaddq_f32(ae0, ae1));
+    #endif
+
+        #undef RVN_VSUB
+        #undef RVN_VMLA
+        #undef RVN_VLOAD
+
+        xy = (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+        energy = (tmp[4] + tmp[5]) + (tmp[6] + tmp[7]);
+
+#else
+        // constant bounds are enough for the compiler to vectorize this
+        (void)tmp;
+
+        xy = 0.0f;
+        energy = 0.0f;
+
+        for (int k = 0; k < H; ++k, luma += stride, rf += W)
+        {
+            for (int j = 0; j < W; ++j)
+            {
+                const float yi = ((float)luma[j * STEP]) - offset;
+                xy += yi * rf[j];
+                energy += yi * yi;
+            }
+        }
+#endif
+    }
+    /* ---------------------------------------------------------------------- */
+    template <int N>
+    static inline SizedKernel sized_kernel(int step)
+    {
+        if (step == 1) { return &correlate_sized<N, N, 1>; }
+        if (step == 2) { return &correlate_sized<N, N, 2>; }
+        return nullptr;
+    }
+    /* ---------------------------------------------------------------------- */
+    SizedKernel sized_kernel(int width, int height, int rf_stride, int step)
+    {
+        // the kernels assume contiguous RF rows
+        if (width != height || rf_stride != width) { return nullptr; }
+
+        switch (width)
+        {
+            case 32: return sized_kernel<32>(step);
+            case 64: return sized_kernel<64>(step);
+            case 128: return sized_kernel<128>(step);
+            case 256: return sized_kernel<256>(step);
+            default: return nullptr;
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    // accumulate one row of <n> luma samples (<step> 1 or 2 bytes apart)
+    // against the raw RF row <rf> into <sx>, <sxx> and <sxr>. Products of
+    // two bytes fit in 16 bits (unsigned) and pairs of them in 32 (signed),
+    // so the lanes can't overflow over a row of up to ~16k pixels
+    static inline void correlate_row_fixed(const uint8_t* src, int step,
+        const uint8_t* rf, int n, uint64_t& sx, uint64_t& sxx, uint64_t& sxr)
+    {
+        int k = 0;
+        uint32_t x = 0, xx = 0, xr = 0;
+
+#if defined(RVN_SIMD_AVX2)
+        const __m256i mask = _mm256_set1_epi16(0x00ff);
+        const __m256i ones = _mm256_set1_epi16(1);
+
+        __m256i ax = _mm256_setzero_si256();
+        __m256i axx = _mm256_setzero_si256();
+        __m256i axr = _mm256_setzero_si256();
+
+        // 16 pixels per iteration as 16 x int16, madd then sums adjacent
+        // products into 8 x int32
+        for (; k + 16 <= n; k += 16)
+        {
+            __m256i y;
+            if (step == 2)
+            {
+                y = _mm256_and_si256(
+                    _mm256_loadu_si256((const __m256i*)(src + 2*k)), mask);
+            }
+            else
+            {
+                y = _mm256_cvtepu8_epi16(
+                    _mm_loadu_si128((const __m128i*)(src + k)));
+            }
+
+            const __m256i r = _mm256_cvtepu8_epi16(
+                _mm_loadu_si128((const __m128i*)(rf + k)));
+
+            ax = _mm256_add_epi32(ax, _mm256_madd_epi16(y, ones));
+            axx = _mm256_add_epi32(axx, _mm256_madd_epi16(y, y));
+            axr = _mm256_add_epi32(axr, _mm256_madd_epi16(y, r));
+        }
+
+        uint32_t tmp[8];
+        _mm256_storeu_si256((__m256i*)tmp, ax);
+        for (int j = 0; j < 8; ++j) { x += tmp[j]; }
+        _mm256_storeu_si256((__m256i*)tmp, axx);
+        for (int j = 0; j < 8; ++j) { xx += tmp[j]; }
+        _mm256_storeu_si256((__m256i*)tmp, axr);
+        for (int j = 0; j < 8; ++j) { xr += tmp[j]; }
+
+#elif defined(RVN_SIMD_SSE2)
+        const __m128i mask = _mm_set1_epi16(0x00ff);
+        const __m128i ones = _mm_set1_epi16(1);
+        const __m128i zero = _mm_setzero_si128();
+
+        __m128i ax = _mm_setzero_si128();
+        __m128i axx = _mm_setzero_si128();
+        __m128i axr = _mm_setzero_si128();
+
+        // 8 pixels per iteration as 8 x int16
+        for (; k + 8 <= n; k += 8)
+        {
+            __m128i y;
+            if (step == 2)
+            {
+                y = _mm_and_si128(
+                    _mm_loadu_si128((const __m128i*)(src + 2*k)), mask);
+            }
+            else
+            {
+                y = _mm_unpacklo_epi8(
+                    _mm_loadl_epi64((const __m128i*)(src + k)), zero);
+            }
+
+            const __m128i r = _mm_unpacklo_epi8(
+                _mm_loadl_epi64((const __m128i*)(rf + k)), zero);
+
+            ax = _mm_add_epi32(ax, _mm_madd_epi16(y, ones));
+            axx = _mm_add_epi32(axx, _mm_madd_epi16(y, y));
+            axr = _mm_add_epi32(axr, _mm_madd_epi16(y, r));
+        }
+
+        uint32_t tmp[4];
+        _mm_storeu_si128((__m128i*)tmp, ax);
+        x = (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+        _mm_storeu_si128((__m128i*)tmp, axx);
+        xx = (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+        _mm_storeu_si128((__m128i*)tmp, axr);
+        xr = (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+
+#elif defined(RVN_SIMD_NEON)
+        uint32x4_t ax = vdupq_n_u32(0);
+        uint32x4_t axx = vdupq_n_u32(0);
+        uint32x4_t axr = vdupq_n_u32(0);
+
+        // 16 pixels per iteration, vmull widens u8 x u8 -> u16 and vpadal
+        // adds adjacent pairs into the u32 accumulators
+        for (; k + 16 <= n; k += 16)
+        {
+            const uint8x16_t y = step == 2 ? vld2q_u8(src + 2*k).val[0] :
+                vld1q_u8(src + k);
+            const uint8x16_t r = vld1q_u8(rf + k);
+
+            const uint8x8_t ylo = vget_low_u8(y);
+            const uint8x8_t yhi = vget_high_u8(y);
+
+            ax = vpadalq_u16(ax, vpaddlq_u8(y));
+
+            axx = vpadalq_u16(axx, vmull_u8(ylo, ylo));
+            axx = vpadalq_u16(axx, vmull_u8(yhi, yhi));
+
+            axr = vpadalq_u16(axr, vmull_u8(ylo, vget_low_u8(r)));
+            axr = vpadalq_u16(axr, vmull_u8(yhi, vget_high_u8(r)));
+        }
+
+        uint32_t tmp[4];
+        vst1q_u32(tmp, ax);
+        x = (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+        vst1q_u32(tmp, axx);
+        xx = (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+        vst1q_u32(tmp, axr);
+        xr = (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+#endif
+
+        for (; k < n; ++k)
+        {
+            const uint32_t yi = src[k * step];
+            x += yi;
+            xx += yi * yi;
+            xr += yi * rf[k];
+        }
+
+        sx += x;
+        sxx += xx;
+        sxr += xr;
+    }
+    /* ---------------------------------------------------------------------- */
+    void correlate_luma_fixed(const uint8_t* luma, int step, int stride,
+        length_t bytes, const CropWindow& win, const uint8_t* rf, int rf_stride,
+        const uint32_t* rf_row_sums, LumaSums& sums)
+    {
+        sums = {0, 0, 0, 0, 0};
+
+        const int first_col = win.col * step;
+
+        for (int k = 0; k < win.height; ++k)
+        {
+            const length_t start = (win.row + k) * stride + first_col;
+
+            // as in correlate_luma(), pixels at or past <bytes> are skipped
+            if (start >= bytes) { break; }
+
+            const int n = RVN_MIN(win.width,
+                (int)((bytes - start + step - 1) / step));
+
+            const uint8_t* weights = rf + k * rf_stride;
+
+            if (step == 1 || step == 2)
+            {
+                correlate_row_fixed(luma + start, step, weights, n, sums.x,
+                    sums.xx, sums.xr);
+            }
+            else
+            {
+                for (int j = 0; j < n; ++j)
+                {
+                    const uint32_t yi = luma[start + j * step];
+                    sums.x += yi;
+                    sums.xx += yi * yi;
+                    sums.xr += yi * weights[j];
+                }
+            }
+
+            // the RF only counts where the frame does
+            if (n == win.width)
+            {
+                sums.r += rf_row_sums[k];
+            }
+            else
+            {
+                for (int j = 0; j < n; ++j) { sums.r += weights[j]; }
+            }
+
+            sums.n += n;
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    // <n> luma samples from every other byte of <src> (YUYV)
+    static inline void luma_row_yuyv(const uint8_t* src, int n, float offset,
+        float* dst)
+    {
+        int k = 0;
+
+#if defined(RVN_SIMD_AVX2)
+        const __m128i mask = _mm_set1_epi16(0x00ff);
+        const __m256 off = _mm256_set1_ps(offset);
+        for (; k + 8 <= n; k += 8)
+        {
+            __m128i raw = _mm_loadu_si128((const __m128i*)(src + 2*k));
+            __m256i y32 = _mm256_cvtepu16_epi32(_mm_and_si128(raw, mask));
+            _mm256_storeu_ps(dst + k,
+                _mm256_sub_ps(_mm256_cvtepi32_ps(y32), off));
+        }
+#elif defined(RVN_SIMD_SSE2)
+        const __m128i mask = _mm_set1_epi16(0x00ff);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 off = _mm_set1_ps(offset);
+        for (; k + 8 <= n; k += 8)
+        {
+            __m128i raw = _mm_loadu_si128((const __m128i*)(src + 2*k));
+            __m128i y16 = _mm_and_si128(raw, mask);
+            _mm_storeu_ps(dst + k, _mm_sub_ps(
+                _mm_cvtepi32_ps(_mm_unpacklo_epi16(y16, zero)), off));
+            _mm_storeu_ps(dst + k + 4, _mm_sub_ps(
+                _mm_cvtepi32_ps(_mm_unpackhi_epi16(y16, zero)), off));
+        }
+#elif defined(RVN_SIMD_NEON)
+        const float32x4_t off = vdupq_n_f32(offset);
+        for (; k + 16 <= n; k += 16)
+        {
+            uint8x16x2_t raw = vld2q_u8(src + 2*k);
+
+            uint16x8_t lo = vmovl_u8(vget_low_u8(raw.val[0]));
+            uint16x8_t hi = vmovl_u8(vget_high_u8(raw.val[0]));
+
+            vst1q_f32(dst + k, vsubq_f32(
+                vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), off));
+            vst1q_f32(dst + k + 4, vsubq_f32(
+                vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), off));
+            vst1q_f32(dst + k + 8, vsubq_f32(
+                vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), off));
+            vst1q_f32(dst + k + 12, vsubq_f32(
+                vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), off));
+        }
+#endif
+
+        for (; k < n; ++k) { dst[k] = ((float)src[2*k]) - offset; }
+    }
+    /* ---------------------------------------------------------------------- */
+    // <n> luma samples from consecutive bytes of <src> (GREY / planar Y)
+    static inline void luma_row_packed(const uint8_t* src, int n, float offset,
+        float* dst)
+    {
+        int k = 0;
+
+#if defined(RVN_SIMD_AVX2)
+        const __m256 off = _mm256_set1_ps(offset);
+        for (; k + 8 <= n; k += 8)
+        {
+            __m128i raw = _mm_loadl_epi64((const __m128i*)(src + k));
+            __m256i y32 = _mm256_cvtepu8_epi32(raw);
+            _mm256_storeu_ps(dst + k,
+                _mm256_sub_ps(_mm256_cvtepi32_ps(y32), off));
+        }
+#elif defined(RVN_SIMD_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 off = _mm_set1_ps(offset);
+        for (; k + 8 <= n; k += 8)
+        {
+            __m128i raw = _mm_loadl_epi64((const __m128i*)(src + k));
+            __m128i y16 = _mm_unpacklo_epi8(raw, zero);
+            _mm_storeu_ps(dst + k, _mm_sub_ps(
+                _mm_cvtepi32_ps(_mm_unpacklo_epi16(y16, zero)), off));
+            _mm_storeu_ps(dst + k + 4, _mm_sub_ps(
+                _mm_cvtepi32_ps(_mm_unpackhi_epi16(y16, zero)), off));
+        }
+#elif defined(RVN_SIMD_NEON)
+        const float32x4_t off = vdupq_n_f32(offset);
+        for (; k + 16 <= n; k += 16)
+        {
+            uint8x16_t raw = vld1q_u8(src + k);
+
+            uint16x8_t lo = vmovl_u8(vget_low_u8(raw));
+            uint16x8_t hi = vmovl_u8(vget_high_u8(raw));
+
+            vst1q_f32(dst + k, vsubq_f32(
+                vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), off));
+            vst1q_f32(dst + k + 4, vsubq_f32(
+                vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), off));
+            vst1q_f32(dst + k + 8, vsubq_f32(
+                vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), off));
+            vst1q_f32(dst + k + 12, vsubq_f32(
+                vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), off));
+        }
+#endif
+
+        for (; k < n; ++k) { dst[k] = ((float)src[k]) - offset; }
+    }
+    /* ---------------------------------------------------------------------- */
+    void luma_row(const uint8_t* src, int step, int n, float offset,
+        float* dst)
+    {
+        if (step == 2)
+        {
+            luma_row_yuyv(src, n, offset, dst);
+        }
+        else if (step == 1)
+        {
+            luma_row_packed(src, n, offset, dst);
+        }
+        else
+        {
+            for (int k = 0; k < n; ++k)
+            {
+                dst[k] = ((float)src[k * step]) - offset;
+            }
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    float dot(const float* y, const float* rf, int n)
+    {
+        float out = 0.0f;
+        int k = 0;
+#if defined(RVN_SIMD_AVX2)
+        __m256 acc = _mm256_setzero_ps();
+        for (; k + 8 <= n; k += 8)
+        {
+            acc = _mm256_fmadd_ps(_mm256_loadu_ps(y + k),
+                _mm256_load_ps(rf + k), acc);
+        }
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc),
+            _mm256_extractf128_ps(acc, 1));
+        float tmp[4];
+        _mm_storeu_ps(tmp, s);
+        out = (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+#elif defined(RVN_SIMD_SSE2)
+        __m128 acc = _mm_setzero_ps();
+        for (; k + 4 <= n; k += 4)
+        {
+            acc = _mm_add_ps(acc,
+                _mm_mul_ps(_mm_loadu_ps(y + k), _mm_load_ps(rf + k)));
+        }
+        float tmp[4];
+        _mm_storeu_ps(tmp, acc);
+        out = (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+#elif defined(RVN_SIMD_NEON)
+        float32x4_t acc = vdupq_n_f32(0.0f);
+        for (; k + 4 <= n; k += 4)
+        {
+            acc = vmlaq_f32(acc, vld1q_f32(y + k), vld1q_f32(rf + k));
+        }
+        float tmp[4];
+        vst1q_f32(tmp, acc);
+        out = (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+#endif
+        for (; k < n; ++k) { out += y[k] * rf[k]; }
+        return out;
+    }
+    /* ---------------------------------------------------------------------- */
+    void dot_energy(const float* y, const float* rf, int n, float& xy,
+        float& energy)
+    {
+        int k = 0;
+
+#if defined(RVN_SIMD_AVX2)
+        __m256 acc_xy = _mm256_setzero_ps();
+        __m256 acc_e = _mm256_setzero_ps();
+        for (; k + 8 <= n; k += 8)
+        {
+            __m256 yk = _mm256_loadu_ps(y + k);
+            acc_xy = _mm256_fmadd_ps(yk, _mm256_load_ps(rf + k), acc_xy);
+            acc_e = _mm256_fmadd_ps(yk, yk, acc_e);
+        }
+
+        __m128 sxy = _mm_add_ps(_mm256_castps256_ps128(acc_xy),
+            _mm256_extractf128_ps(acc_xy, 1));
+        __m128 se = _mm_add_ps(_mm256_castps256_ps128(acc_e),
+            _mm256_extractf128_ps(acc_e, 1));
+
+        float tmp[4];
+        _mm_storeu_ps(tmp, sxy);
+        xy += (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+        _mm_storeu_ps(tmp, se);
+        energy += (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+
+#elif defined(RVN_SIMD_SSE2)
+        __m128 acc_xy = _mm_setzero_ps();
+        __m128 acc_e = _mm_setzero_ps();
+        for (; k + 4 <= n; k += 4)
+        {
+            __m128 yk = _mm_loadu_ps(y + k);
+            acc_xy = _mm_add_ps(acc_xy, _mm_mul_ps(yk, _mm_load_ps(rf + k)));
+            acc_e = _mm_add_ps(acc_e, _mm_mul_ps(yk, yk));
+        }
+
+        float tmp[4];
+        _mm_storeu_ps(tmp, acc_xy);
+        xy += (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+        _mm_storeu_ps(tmp, acc_e);
+        energy += (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+
+#elif defined(RVN_SIMD_NEON)
+        float32x4_t acc_xy = vdupq_n_f32(0.0f);
+        float32x4_t acc_e = vdupq_n_f32(0.0f);
+        for (; k + 4 <= n; k += 4)
+        {
+            float32x4_t yk = vld1q_f32(y + k);
+            acc_xy = vmlaq_f32(acc_xy, yk, vld1q_f32(rf + k));
+            acc_e = vmlaq_f32(acc_e, yk, yk);
+        }
+
+        float tmp[4];
+        vst1q_f32(tmp, acc_xy);
+        xy += (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+        vst1q_f32(tmp, acc_e);
+        energy += (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+#endif
+
+        for (; k < n; ++k)
+        {
+            xy += y[k] * rf[k];
+            energy += y[k] * y[k];
+        }
+    }
+    /* ====================================================================== */
+    ReceptiveField::~ReceptiveField()
+    {
+        if (_raw != nullptr)
+        {
+            delete[] _raw;
+        }
+        if (_row_sums != nullptr)
+        {
+            delete[] _row_sums;
+        }
+        free_aligned(_centered);
+        free_aligned(_sep_rows);
+        free_aligned(_sep_cols);
+    }
+    /* ---------------------------------------------------------------------- */
+    bool ReceptiveField::load(const char* filepath, float tolerance)
+    {
+        bool success = false;
+
+        std::ifstream ifs;
+        ifs.open(filepath, std::ifstream::in | std::ifstream::binary);
+
+        if (ifs.good())
+        {
+            std::string tmp;
+            std::getline(ifs, tmp);
+            if (tmp == "P5")
+            {
+                int width, height, white;
+                ifs >> width >> height >> white;
+                if (width > 0 && height > 0 && white < 256)
+                {
+                    _width = width;
+                    _height = height;
+
+                    _raw = new uint8_t[width*height];
+                    ifs.read(reinterpret_cast<char*>(_raw), width*height);
+                    if (ifs)
+                    {
+                        // pre-calculate the mean and 2-norm of the rf
+                        _mag = two_norm(_raw, width*height, _mean);
+                        build_centered();
+
+                        success = isvalid();
+                    }
+                }
+            }
+        }
+
+        ifs.close();
+
+        if (success && tolerance > 0.0f) { (void)separate(tolerance); }
+
+        return success;
+    }
+    /* ---------------------------------------------------------------------- */
+    bool ReceptiveField::separate(float tolerance, int max_rank)
+    {
+        free_aligned(_sep_rows);
+        free_aligned(_sep_cols);
+
+        _sep_rows = nullptr;
+        _sep_cols = nullptr;
+        _rank = 0;
+        _rank_error = 1.0f;
+
+        if (!isvalid() || max_rank < 1) { return false; }
+
+        const int w = _width;
+        const int h = _height;
+
+        // the residual, from which each component is taken out in turn
+        std::vector<double> res(w * h);
+        for (int k = 0; k < h; ++k)
+        {
+            for (int j = 0; j < w; ++j)
+            {
+                res[k * w + j] = _centered[k * _stride + j];
+            }
+        }
+
+        double total = 0.0;
+        for (size_t k = 0; k < res.size(); ++k) { total += res[k] * res[k]; }
+
+        if (total <= 0.0) { return false; }
+
+        std::vector<double> u(h), v(w);
+        std::vector<std::vector<double>> cols, rows;
+
+        double left = total;
+
+        while ((int)cols.size() < max_rank && sqrt(left / total) > tolerance)
+        {
+            // power iteration on the residual, starting from it's strongest
+            // row: u = R v / |R v|, v = R' u -> the top singular vectors, w/
+            // the singular value left in v
+            int first = 0;
+            double best = -1.0;
+            for (int k = 0; k < h; ++k)
+            {
+                double e = 0.0;
+                for (int j = 0; j < w; ++j)
+                {
+                    e += res[k*w + j] * res[k*w + j];
+                }
+                if (e > best) { best = e; first = k; }
+            }
+
+            for (int j = 0; j < w; ++j) { v[j] = res[first * w + j]; }
+
+            double sigma = 0.0;
+            for (int it = 0; it < 500; ++it)
+            {
+                double nu = 0.0;
+                for (int k = 0; k < h; ++k)
+                {
+                    double acc = 0.0;
+                    for (int j = 0; j < w; ++j) { acc += res[k*w + j] * v[j]; }
+                    u[k] = acc;
+                    nu += acc * acc;
+                }
+
+                nu = sqrt(nu);
+                if (nu <= 0.0) { break; }
+
+                for (int k = 0; k < h; ++k) { u[k] /= nu; }
+
+                std::fill(v.begin(), v.end(), 0.0);
+                for (int k = 0; k < h; ++k)
+                {
+                    for (int j = 0; j < w; ++j) { v[j] += res[k*w + j] * u[k]; }
+                }
+
+                double s = 0.0;
+                for (int j = 0; j < w; ++j) { s += v[j] * v[j]; }
+                s = sqrt(s);
+
+                const bool done = fabs(s - sigma) <= 1e-9 * s;
+                sigma = s;
+
+                if (done) { break; }
+            }
+
+            // the error is that of the residual itself, so it holds however
+            // well the iteration converged
+            left = 0.0;
+            for (int k = 0; k < h; ++k)
+            {
+                for (int j = 0; j < w; ++j)
+                {
+                    res[k*w + j] -= u[k] * v[j];
+                    left += res[k*w + j] * res[k*w + j];
+                }
+            }
+
+            cols.push_back(u);
+            rows.push_back(v);
+        }
+
+        const float error = (float)sqrt(left / total);
+
+        if (error > tolerance)
+        {
+            printf("[RF]: %d x %d RF has no separable approximation w/in "
+                "%.2f%% (%.2f%% w/ %d components)\n", w, h, 100.0f * tolerance,
+                100.0f * error, max_rank);
+            return false;
+        }
+
+        _rank = cols.size();
+        _rank_error = error;
+
+        _sep_rows = alloc_aligned<float>(_rank * _stride);
+        _sep_cols = alloc_aligned<float>(_rank * _height);
+
+        if (_sep_rows == nullptr || _sep_cols == nullptr)
+        {
+            free_aligned(_sep_rows);
+            free_aligned(_sep_cols);
+            _sep_rows = nullptr;
+            _sep_cols = nullptr;
+            _rank = 0;
+            return false;
+        }
+
+        for (int c = 0; c < _rank; ++c)
+        {
+            std::copy(rows[c].begin(), rows[c].end(), _sep_rows + c * _stride);
+            std::copy(cols[c].begin(), cols[c].end(), _sep_cols + c * h);
+        }
+
+        // k row + k column passes vs. one w x h correlation per position,
+        // only against direct correlation, the FFT is often quicker (see
+        // CorrelationMap::separable_gain())
+        printf("[RF]: %d x %d RF ~ rank %d, %.2f%% error, %.1fx fewer "
+            "multiply-adds per position than direct correlation (not the "
+            "FFT)\n", w, h, _rank, 100.0f * error,
+            ((float)w * h) / (_rank * (w + h)));
+
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    void ReceptiveField::correlate(const ImagePacket* packet, length_t bytes,
+        int col, int row, float offset, float& xy, float& energy) const
+    {
+        const int step = packet->luma_step();
+        const int stride = packet->luma_stride();
+
+        bytes = packet->luma_bytes(bytes);
+
+        const SizedKernel kernel = step == 1 || step == 2 ?
+            _kernel[step - 1] : nullptr;
+
+        // the sized kernels only take windows that end before <bytes>,
+        // anything else (windows clipped by a short frame) goes the long way
+        const length_t last = (length_t)(row + _height - 1) * stride +
+            (col + _width) * step;
+
+        if (kernel != nullptr && last <= bytes)
+        {
+            kernel(packet->luma() + row * stride + col * step, stride,
+                _centered, offset, xy, energy);
+        }
+        else
+        {
+            const CropWindow win = {col, row, _width, _height};
+            correlate_luma(packet->luma(), step, stride, bytes, win,
+                _centered, _stride, offset, xy, energy);
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    float ReceptiveField::correlate_fixed(const ImagePacket* packet,
+        length_t bytes, int col, int row, double frame_mean) const
+    {
+        const length_t luma_bytes = packet->luma_bytes(bytes);
+        const CropWindow win = {col, row, _width, _height};
+
+        LumaSums s;
+        correlate_luma_fixed(packet->luma(), packet->luma_step(),
+            packet->luma_stride(), luma_bytes, win, _raw, _width, _row_sums,
+            s);
+
+        // expand sum((y - m) (r - rm)) and sum((y - m)^2) w/ the frame mean
+        // m and the RF mean rm, the sums are exact so only these few terms
+        // are rounded
+        const double m = frame_mean;
+        const double rm = _mean;
+
+        const double xy = (double)s.xr - m * s.r - rm * ((double)s.x - m * s.n);
+        const double energy = (double)s.xx - m * (2.0 * s.x - m * s.n);
+
+        // same as xy / mx / sqrt(mn / mx) w/ mx, mn the max, min of the two
+        // magnitudes (see NeuronFilter::filter())
+        return (float)(xy / sqrt(energy * _mag));
+    }
+    /* ---------------------------------------------------------------------- */
+    void ReceptiveField::build_centered()
+    {
+        // rows are padded (w/ zeros) to keep every row aligned for the kernel
+        _stride = simd_stride(_width);
+        _centered = alloc_aligned<float>(_stride * _height);
+
+        if (_centered == nullptr) { return; }
+
+        _row_sums = new uint32_t[_height];
+
+        for (int k = 0; k < _height; ++k)
+        {
+            _row_sums[k] = 0;
+            for (int j = 0; j < _width; ++j)
+            {
+                _centered[k * _stride + j] =
+                    ((float)_raw[k * _width + j]) - _mean;
+                _row_sums[k] += _raw[k * _width + j];
+            }
+        }
+
+        _kernel[0] = sized_kernel(_width, _height, _stride, 1);
+        _kernel[1] = sized_kernel(_width, _height, _stride, 2);
+    }
+    /* ====================================================================== */
+}
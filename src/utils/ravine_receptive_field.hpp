@@ -0,0 +1,172 @@
+#ifndef RAVINE_RECEPTIVE_FIELD_HPP_
+#define RAVINE_RECEPTIVE_FIELD_HPP_
+
+#include <cinttypes>
+
+#include "ravine_packets.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    uint64_t sum_bytes(const uint8_t* data, int length);
+    float mean(const uint8_t* data, int length);
+    float two_norm(const uint8_t* data, int length, float& mn);
+
+    // sum and number (<n>) of the luma samples in the first <bytes> bytes
+    // of <packet>, only the Y bytes of YUYV frames count
+    uint64_t sum_luma(const ImagePacket* packet, length_t bytes, uint32_t& n);
+
+    // the mean of the same, i.e. the frame mean the neuron models subtract
+    double luma_mean(const ImagePacket* packet, length_t bytes);
+    /* ---------------------------------------------------------------------- */
+    // zero-mean dot product (<xy>) and energy (<energy>) of the luma plane
+    // <luma> (<step> bytes between samples, <stride> bytes per row, see
+    // ImagePacket) w/in <win> against the pre-centered RF <rf> (<rf_stride>
+    // floats per row), <offset> is subtracted from every luma sample and
+    // pixels at or beyond <bytes> are skipped
+    void correlate_luma(const uint8_t* luma, int step, int stride,
+        length_t bytes, const CropWindow& win, const float* rf, int rf_stride,
+        float offset, float& xy, float& energy);
+    /* ---------------------------------------------------------------------- */
+    // correlate_luma() for a window that lies wholly w/in the frame and an RF
+    // whose size (and so row stride) is known at compile time, <luma> points
+    // at the window's first pixel
+    typedef void (*SizedKernel)(const uint8_t* luma, int stride,
+        const float* rf, float offset, float& xy, float& energy);
+
+    // the kernel for a <width> x <height> RF of <rf_stride> floats per row
+    // over luma samples <step> bytes apart, nullptr if there is none (only
+    // square RFs of 32, 64, 128 and 256 px have one)
+    SizedKernel sized_kernel(int width, int height, int rf_stride, int step);
+    /* ---------------------------------------------------------------------- */
+    // integer sums over the pixels of a window that lie before the end of
+    // the frame: of the luma (<x>), it's square (<xx>), it's product w/ the
+    // raw RF (<xr>), of the RF itself (<r>) and the number of pixels (<n>)
+    struct LumaSums
+    {
+        uint64_t x;
+        uint64_t xx;
+        uint64_t xr;
+        uint64_t r;
+        uint32_t n;
+    };
+    /* ---------------------------------------------------------------------- */
+    // as correlate_luma(), but against the raw (uint8) RF <rf> (<rf_stride>
+    // bytes per row, w/ <rf_row_sums> the sum of each of it's rows) and w/
+    // no offset, all in integer arithmetic
+    void correlate_luma_fixed(const uint8_t* luma, int step, int stride,
+        length_t bytes, const CropWindow& win, const uint8_t* rf, int rf_stride,
+        const uint32_t* rf_row_sums, LumaSums& sums);
+    /* ---------------------------------------------------------------------- */
+    // <n> luma samples, <step> bytes apart, from <src> into <dst> as floats,
+    // subtracting <offset> from each
+    void luma_row(const uint8_t* src, int step, int n, float offset,
+        float* dst);
+    /* ---------------------------------------------------------------------- */
+    // <y> . <rf> over <n> elements, <rf> must be aligned, <y> need not
+    float dot(const float* y, const float* rf, int n);
+    /* ---------------------------------------------------------------------- */
+    // <xy> += <y> . <rf> and <energy> += <y> . <y> over <n> elements, <rf>
+    // must be aligned (e.g. a row of ReceptiveField::centered()), <y> need not
+    void dot_energy(const float* y, const float* rf, int n, float& xy,
+        float& energy);
+    /* ====================================================================== */
+    class ReceptiveField
+    {
+    public:
+        ReceptiveField() {}
+        ~ReceptiveField();
+
+        // RFs own aligned memory, so no copies
+        ReceptiveField(const ReceptiveField&) = delete;
+        ReceptiveField& operator=(const ReceptiveField&) = delete;
+
+        // read a binary (P5) pgm file and build the centered copy of the RF,
+        // w/ a <tolerance> > 0 also it's separable approximation (see
+        // separate(), not finding one w/in <tolerance> is not an error)
+        bool load(const char* filepath, float tolerance = 0.0f);
+
+        // approximate the centered RF by the sum of the fewest (and at most
+        // <max_rank>) separable components, column x row, that leave a
+        // residual w/in <tolerance> of it's 2-norm (i.e. the top singular
+        // vectors of the RF). Returns false (and a rank() of 0) if
+        // <max_rank> components are not enough
+        bool separate(float tolerance, int max_rank = 8);
+
+        // correlate_luma() of the window at (<col>, <row>) of <packet>, w/
+        // the size specific kernel when there is one and the window is w/in
+        // <bytes>
+        void correlate(const ImagePacket* packet, length_t bytes, int col,
+            int row, float offset, float& xy, float& energy) const;
+
+        // the normalized correlation NeuronFilter computes from correlate(),
+        // w/ the sums over the window in (SIMD) integer arithmetic straight
+        // from the uint8 luma and only the final normalization in floating
+        // point. <frame_mean> is the mean of the frame's luma (see
+        // luma_mean())
+        float correlate_fixed(const ImagePacket* packet, length_t bytes,
+            int col, int row, double frame_mean) const;
+
+        inline bool isvalid() const { return _centered != nullptr; }
+
+        inline int width() const { return _width; }
+        inline int height() const { return _height; }
+        inline int stride() const { return _stride; }
+
+        // true if correlate() has a size specific kernel for this RF
+        inline bool is_sized() const { return _kernel[0] != nullptr; }
+
+        inline float mean() const { return _mean; }
+        inline float mag() const { return _mag; }
+
+        // number of separable components, 0 if there is no approximation,
+        // and the approximation's relative error
+        inline int rank() const { return _rank; }
+        inline float rank_error() const { return _rank_error; }
+
+        // component <c> is sep_col(c) (height() floats) times sep_row(c)
+        // (width() floats, aligned like the rows of centered())
+        inline const float* sep_row(int c) const
+        {
+            return _sep_rows + c * _stride;
+        }
+        inline const float* sep_col(int c) const
+        {
+            return _sep_cols + c * _height;
+        }
+
+        inline const uint8_t* raw() const { return _raw; }
+        inline const float* centered() const { return _centered; }
+
+    private:
+        void build_centered();
+
+    private:
+        int _width = 0;
+        int _height = 0;
+
+        // floats per row of _centered, padded so that every row is aligned
+        int _stride = 0;
+
+        float _mean = 0.0f;
+        float _mag = 0.0f;
+
+        uint8_t* _raw = nullptr;
+        float* _centered = nullptr;
+
+        // sum of each row of _raw
+        uint32_t* _row_sums = nullptr;
+
+        // sized_kernel()s for packed (GREY / planar) and YUYV luma
+        SizedKernel _kernel[2] = {nullptr, nullptr};
+
+        // separable approximation, _rank rows of _stride and columns of
+        // _height floats
+        int _rank = 0;
+        float _rank_error = 1.0f;
+        float* _sep_rows = nullptr;
+        float* _sep_cols = nullptr;
+    };
+    /* ====================================================================== */
+}
+#endif
@@ -0,0 +1,76 @@
+#ifndef RAVINE_SIMD_HPP_
+#define RAVINE_SIMD_HPP_
+
+#include <cstdlib>
+#include <cinttypes>
+
+// pick the widest instruction set the compiler was told it can use, on the pi
+// (aarch64, or armv7 w/ -mfpu=neon) that is NEON, on x86_64 SSE2 is always
+// available and AVX2 / FMA are used when building w/ -march=native (see the
+// "native" target in the Makefile)
+#if defined(__AVX2__) && defined(__FMA__)
+    #define RVN_SIMD_AVX2 1
+    #include <immintrin.h>
+#elif defined(__SSE2__)
+    #define RVN_SIMD_SSE2 1
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define RVN_SIMD_NEON 1
+    #include <arm_neon.h>
+#endif
+
+// alignment (in bytes) of buffers that the SIMD kernels load from, 32 covers
+// AVX2 and is harmless for everything else
+#define RVN_SIMD_ALIGN 32
+
+// number of floats per aligned block, rows of aligned 2D buffers are padded
+// to a multiple of this so that every row starts aligned
+#define RVN_SIMD_FLOATS (RVN_SIMD_ALIGN / sizeof (float))
+
+namespace RVN
+{
+    /* ---------------------------------------------------------------------- */
+    inline const char* simd_name()
+    {
+#if defined(RVN_SIMD_AVX2)
+        return "AVX2";
+#elif defined(RVN_SIMD_SSE2)
+        return "SSE2";
+#elif defined(RVN_SIMD_NEON)
+        return "NEON";
+#else
+        return "scalar";
+#endif
+    }
+    /* ---------------------------------------------------------------------- */
+    // round <n> up to a multiple of RVN_SIMD_FLOATS
+    inline int simd_stride(int n)
+    {
+        return ((n + RVN_SIMD_FLOATS - 1) / RVN_SIMD_FLOATS) * RVN_SIMD_FLOATS;
+    }
+    /* ---------------------------------------------------------------------- */
+    // allocate <n> zero-initialized T's aligned to RVN_SIMD_ALIGN, must be
+    // freed w/ free_aligned()
+    template <class T>
+    T* alloc_aligned(size_t n)
+    {
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, RVN_SIMD_ALIGN, n * sizeof (T)) != 0)
+        {
+            return nullptr;
+        }
+
+        T* out = static_cast<T*>(ptr);
+        for (size_t k = 0; k < n; ++k) { out[k] = T(); }
+
+        return out;
+    }
+    /* ---------------------------------------------------------------------- */
+    template <class T>
+    void free_aligned(T* ptr)
+    {
+        if (ptr != nullptr) { free(ptr); }
+    }
+    /* ---------------------------------------------------------------------- */
+}
+#endif
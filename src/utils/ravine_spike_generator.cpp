@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+#include "ravine_spike_generator.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    const char* mode_name(SpikeMode mode)
+    {
+        switch (mode)
+        {
+        case SpikeMode::Poisson:
+            return "poisson";
+        case SpikeMode::LIF:
+            return "lif";
+        default:
+            return "threshold";
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    bool parse_spike_params(const std::string& spec, SpikeParams& params)
+    {
+        const size_t colon = spec.find(':');
+        const std::string kind = spec.substr(0, colon);
+
+        SpikeParams tmp;
+
+        if (kind == "poisson")
+        {
+            tmp.mode = SpikeMode::Poisson;
+        }
+        else if (kind == "lif")
+        {
+            tmp.mode = SpikeMode::LIF;
+        }
+        else if (kind != "threshold" || colon != std::string::npos)
+        {
+            return false;
+        }
+
+        if (colon != std::string::npos)
+        {
+            // GAIN,OFFSET,MAX_RATE,REFRACTORY,TAU_M, any of them trailing
+            // can be left out
+            float* fields[] = {&tmp.gain, &tmp.offset, &tmp.max_rate,
+                &tmp.refractory, &tmp.tau_m};
+            const float scale[] = {1.0f, 1.0f, 1.0f, 1e-3f, 1e-3f};
+
+            std::istringstream is(spec.substr(colon + 1));
+            std::string tok;
+
+            int k = 0;
+            while (std::getline(is, tok, ','))
+            {
+                std::istringstream it(tok);
+                float value;
+                if (k >= 5 || !(it >> value) || !it.eof()) { return false; }
+
+                *fields[k] = value * scale[k];
+                ++k;
+            }
+
+            if (k < 1) { return false; }
+        }
+
+        if (tmp.gain <= 0.0f || tmp.max_rate <= 0.0f || tmp.refractory < 0.0f
+            || tmp.tau_m <= 0.0f)
+        {
+            return false;
+        }
+
+        params = tmp;
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    uint64_t spike_seed()
+    {
+        static std::atomic<uint64_t> count{0};
+
+        const uint64_t now = std::chrono::steady_clock::now().time_since_epoch()
+            .count();
+
+        // splitmix64 of the time and call count
+        uint64_t z = now + (++count) * 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+    /* ====================================================================== */
+    SpikeGenerator::SpikeGenerator(int n, const SpikeParams& params,
+        uint64_t seed)
+    {
+        (void)configure(n, params, seed);
+    }
+    /* ---------------------------------------------------------------------- */
+    bool SpikeGenerator::configure(int n, const SpikeParams& params,
+        uint64_t seed)
+    {
+        if (n < 0 || params.gain <= 0.0f || params.max_rate <= 0.0f ||
+            params.refractory < 0.0f || params.tau_m <= 0.0f)
+        {
+            return false;
+        }
+
+        _params = params;
+
+        // a rate of 1 / refractory would leave no time b/t spikes
+        if (_params.refractory > 0.0f)
+        {
+            _params.max_rate = RVN_MIN(_params.max_rate,
+                0.9f / _params.refractory);
+        }
+
+        // xorshift can't start from 0
+        _rng = seed != 0 ? seed : 0x853c49e6748fea9bULL;
+
+        _last.assign(n, -1.0);
+        _threshold.assign(n, 0.0f);
+        _state.assign(n, 0.0f);
+        _dead.assign(n, 0.0);
+
+        for (int k = 0; k < n; ++k)
+        {
+            if (_params.mode == SpikeMode::Poisson)
+            {
+                _state[k] = -logf(uniform());
+            }
+        }
+
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    void SpikeGenerator::reset()
+    {
+        std::fill(_last.begin(), _last.end(), -1.0);
+    }
+    /* ---------------------------------------------------------------------- */
+    float SpikeGenerator::rate(float act) const
+    {
+        const float r = _params.gain * (act - _params.offset);
+        return r > 0.0f ? RVN_MIN(r, _params.max_rate) : 0.0f;
+    }
+    /* ---------------------------------------------------------------------- */
+    void SpikeGenerator::generate(const float* act, const double* time,
+        SpikeBatch& out)
+    {
+        const int first = out.size();
+        const int n = size();
+
+        for (int k = 0; k < n; ++k)
+        {
+            const double t1 = time[k];
+
+            if (_params.mode == SpikeMode::Threshold)
+            {
+                if (act[k] > _threshold[k])
+                {
+                    out.push(t1, k);
+
+                    // increase threshold by 10%
+                    _threshold[k] += (1.0f - _threshold[k]) * _dthreshold;
+                }
+                else
+                {
+                    // decrease threshold by 10%
+                    _threshold[k] *= (1.0f - _dthreshold);
+                }
+
+                continue;
+            }
+
+            // the first frame (since a reset) only marks the time, as does
+            // one that isn't after the last
+            const double last = _last[k];
+            _last[k] = t1;
+
+            if (last < 0.0 || t1 <= last) { continue; }
+
+            const double t0 = RVN_MAX(last, t1 - _params.max_interval);
+            const float r = rate(act[k]);
+
+            if (_params.mode == SpikeMode::Poisson)
+            {
+                poisson(k, r, t0, t1, out);
+            }
+            else
+            {
+                lif(k, r, t0, t1, out);
+            }
+        }
+
+        // each neuron's spikes are in order, the batch has to be as a whole
+        if (n > 1 && out.size() - first > 1)
+        {
+            std::sort(out.data() + first, out.data() + out.size(),
+                [](const Spike& a, const Spike& b) { return a.time < b.time; }
+            );
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void SpikeGenerator::poisson(int k, float rate, double t0, double t1,
+        SpikeBatch& out)
+    {
+        const float d = _params.refractory;
+
+        // w/ a dead time of <d> after each spike the rate is lambda / (1 +
+        // lambda d), so lambda is raised to make up for it
+        const float lambda = rate > 0.0f ? rate / (1.0f - rate * d) : 0.0f;
+
+        // time rescaling: a spike every time the rate (outside of refractory
+        // periods) integrates to a unit exponential draw, which carries over
+        // from one interval to the next as the rate changes
+        double t = RVN_MAX(t0, _dead[k]);
+
+        while (lambda > 0.0f && t < t1)
+        {
+            const double ts = t + _state[k] / lambda;
+
+            if (ts > t1)
+            {
+                _state[k] -= lambda * (float)(t1 - t);
+                break;
+            }
+
+            out.push(ts, k);
+
+            _state[k] = -logf(uniform());
+            _dead[k] = ts + d;
+            t = _dead[k];
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void SpikeGenerator::lif(int k, float rate, double t0, double t1,
+        SpikeBatch& out)
+    {
+        const float d = _params.refractory;
+        const float tau = _params.tau_m;
+
+        // dV/dt = (D - V) / tau from V = 0 reaches 1 after tau ln(D / (D -
+        // 1)), so the drive D that fires every 1 / rate (refractory period
+        // included) is 1 + 1 / (e^x - 1), x = (1 / rate - d) / tau. D - 1 is
+        // kept apart, at low rates it's far below float resolution of D
+        const float excess = rate > 0.0f ?
+            1.0f / expm1f((1.0f / rate - d) / tau) : 0.0f;
+        const float drive = rate > 0.0f ? 1.0f + excess : 0.0f;
+
+        float v = _state[k];
+
+        // the membrane stays at reset until the refractory period ends
+        double t = RVN_MAX(t0, _dead[k]);
+
+        while (t < t1)
+        {
+            // time to threshold, if the drive can get there at all
+            double ts = t1 + 1.0;
+            if (excess > 0.0f)
+            {
+                ts = v < 1.0f ? t + tau * log1pf((1.0f - v) / excess) : t;
+            }
+
+            if (ts > t1)
+            {
+                v = drive + (v - drive) * expf(-(float)(t1 - t) / tau);
+                break;
+            }
+
+            out.push(ts, k);
+
+            v = 0.0f;
+            _dead[k] = ts + d;
+            t = _dead[k];
+        }
+
+        _state[k] = v;
+    }
+    /* ====================================================================== */
+}
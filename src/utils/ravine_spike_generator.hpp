@@ -0,0 +1,126 @@
+#ifndef RAVINE_SPIKE_GENERATOR_HPP_
+#define RAVINE_SPIKE_GENERATOR_HPP_
+
+#include <string>
+#include <vector>
+
+#include <cinttypes>
+
+#include "ravine_packets.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // how activations become spikes:
+    //      Threshold - at most one spike per frame, at the frame's time, when
+    //                  the activation exceeds an adaptive threshold
+    //      Poisson   - a Poisson process (w/ a refractory period) at a rate
+    //                  set by the activation
+    //      LIF       - a leaky integrate-and-fire neuron driven so that it
+    //                  fires at that same rate for a steady activation
+    enum class SpikeMode { Threshold, Poisson, LIF };
+
+    const char* mode_name(SpikeMode mode);
+    /* ---------------------------------------------------------------------- */
+    struct SpikeParams
+    {
+        SpikeMode mode = SpikeMode::Threshold;
+
+        // rate (Hz) = <gain> x (activation - <offset>), rectified and capped
+        // at <max_rate>, which is at most 0.9 / <refractory>
+        float gain = 500.0f;
+        float offset = 0.05f;
+        float max_rate = 200.0f;
+
+        // s, no spikes for this long after one
+        float refractory = 0.002f;
+
+        // s, LIF membrane time constant
+        float tau_m = 0.020f;
+
+        // s, a longer gap b/t frames (e.g. a stalled stream) only gets
+        // spikes for it's last <max_interval>
+        float max_interval = 0.25f;
+    };
+    /* ---------------------------------------------------------------------- */
+    // parse "MODE[:GAIN[,OFFSET[,MAX_RATE[,REFRACTORY[,TAU_M]]]]]" where MODE
+    // is threshold, poisson or lif and times are in ms, e.g. "poisson" or
+    // "lif:800,0.1,150,2,10". Returns false (and leaves <params> alone) if
+    // <spec> is malformed
+    bool parse_spike_params(const std::string& spec, SpikeParams& params);
+
+    // a seed that differs from one call (and run) to the next, so that
+    // generators don't draw the same spikes
+    uint64_t spike_seed();
+    /* ====================================================================== */
+    // turns each frame's activations into spike times for a set of neurons:
+    // every frame, each neuron's activation sets it's rate over the
+    // interval since it's previous frame (that of the exposure that produced
+    // it), and the spikes w/in that interval are drawn at sub-frame times.
+    // State is O(1) per neuron
+    class SpikeGenerator
+    {
+    public:
+        SpikeGenerator(int n = 1, const SpikeParams& params = SpikeParams(),
+            uint64_t seed = 0x853c49e6748fea9bULL);
+
+        // <n> neurons w/ <params>, false (and nothing changes) if <params>
+        // are invalid. Starts over (see reset()) and re-seeds
+        bool configure(int n, const SpikeParams& params, uint64_t seed);
+
+        inline int size() const { return _last.size(); }
+        inline const SpikeParams& params() const { return _params; }
+
+        // neuron k's activation <act>[k] for it's frame at <time>[k] (s),
+        // frames must come in order. The spikes since each neuron's previous
+        // frame are appended to <out>, which is then sorted by time
+        void generate(const float* act, const double* time, SpikeBatch& out);
+
+        // the (Poisson / LIF) rate for activation <act>
+        float rate(float act) const;
+
+        // forget when the last frame was, e.g. when the stream restarts, so
+        // that the next frame starts a new interval (adaptive thresholds are
+        // kept)
+        void reset();
+
+    private:
+        // uniform on (0, 1]
+        inline float uniform()
+        {
+            // xorshift64*
+            _rng ^= _rng >> 12;
+            _rng ^= _rng << 25;
+            _rng ^= _rng >> 27;
+
+            const uint64_t r = _rng * 0x2545f4914f6cdd1dULL;
+            return ((r >> 40) + 1) * (1.0f / 16777216.0f);
+        }
+
+        void poisson(int k, float rate, double t0, double t1, SpikeBatch& out);
+        void lif(int k, float rate, double t0, double t1, SpikeBatch& out);
+
+    private:
+        SpikeParams _params;
+
+        uint64_t _rng;
+
+        // time of each neuron's previous frame (< 0 before the first)
+        std::vector<double> _last;
+
+        // Threshold: the adaptive threshold
+        std::vector<float> _threshold;
+
+        // Poisson: the (unit exponential) integrated rate left until the next
+        // spike, LIF: the membrane potential (threshold 1, reset 0)
+        std::vector<float> _state;
+
+        // end of the refractory period that follows the last spike
+        std::vector<double> _dead;
+
+        //threshold change per sample in %
+        static constexpr float _dthreshold = 0.1f;
+    };
+    /* ====================================================================== */
+}
+#endif
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+#include "ravine_spike_scheduler.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    SpikeScheduler::SpikeScheduler(int sample_rate, float latency, int length)
+        : _sample_rate(sample_rate), _latency(latency), _length(length),
+        _pending(length), _onsets(length)
+    {
+        _data = malloc(sizeof(Spike) * _length);
+        if (_data != nullptr)
+        {
+            // fails unless <length> is a power of 2
+            if (PaUtil_InitializeRingBuffer(&_queue, sizeof(Spike), _length,
+                _data) < 0)
+            {
+                free(_data);
+                _data = nullptr;
+            }
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    SpikeScheduler::~SpikeScheduler()
+    {
+        if (_data != nullptr)
+        {
+            free(_data);
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    int SpikeScheduler::push(const Spike* spikes, int n)
+    {
+        const int written = PaUtil_WriteRingBuffer(&_queue, spikes, n);
+        _dropped += n - written;
+
+        return written;
+    }
+    /* ---------------------------------------------------------------------- */
+    int SpikeScheduler::schedule(double dac_time, int nframes,
+        const int*& onsets)
+    {
+        onsets = _onsets.data();
+
+        // everything queued joins those still waiting from earlier buffers
+        _npending += PaUtil_ReadRingBuffer(&_queue, _pending.data() + _npending,
+            _length - _npending);
+
+        const double fs = _sample_rate;
+        int nonsets = 0, kept = 0;
+
+        for (int k = 0; k < _npending; ++k)
+        {
+            const Spike& s = _pending[k];
+
+            // sample (relative to the start of this buffer) at which the
+            // spike is heard
+            const double offset = (s.time + _latency - dac_time) * fs;
+
+            if (offset >= nframes)
+            {
+                // not yet, keep it for a later buffer
+                _pending[kept++] = s;
+                continue;
+            }
+
+            int idx = (int)floor(offset);
+            if (idx < 0)
+            {
+                if (offset < -max_late * fs)
+                {
+                    ++_discarded;
+                    continue;
+                }
+
+                ++_late;
+                idx = 0;
+            }
+
+            _onsets[nonsets++] = idx;
+            _render_latency.add(dac_time + idx / fs - s.time);
+        }
+
+        _npending = kept;
+
+        // batches arrive in order but each is sorted on it's own, so spikes
+        // from two batches can interleave
+        std::sort(_onsets.data(), _onsets.data() + nonsets);
+
+        return nonsets;
+    }
+    /* ====================================================================== */
+}
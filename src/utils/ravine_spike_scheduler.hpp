@@ -0,0 +1,92 @@
+#ifndef RAVINE_SPIKE_SCHEDULER_HPP_
+#define RAVINE_SPIKE_SCHEDULER_HPP_
+
+#include <vector>
+
+#include <cinttypes>
+
+extern "C"
+{
+#include "pa_ringbuffer.h"
+}
+
+#include "ravine_stats.hpp"
+#include "ravine_packets.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // hands timestamped spikes from the model's thread to the audio callback
+    // through a lock-free single producer / single consumer queue, and works
+    // out where in each output buffer a spike falls: a spike at time t (Clock
+    // seconds) is heard at t + latency(), to the sample, as long as it
+    // reaches the callback before then
+    class SpikeScheduler
+    {
+    public:
+        // <length> (a power of 2) spikes can be waiting at a time
+        SpikeScheduler(int sample_rate, float latency = 0.150f,
+            int length = 16384);
+        ~SpikeScheduler();
+
+        inline bool isvalid() const { return _data != nullptr; }
+
+        // producer side: queue <n> spikes, in order, returns the number
+        // queued, those that don't fit are dropped
+        int push(const Spike* spikes, int n);
+
+        // consumer side: the sample offsets, in order, of the spikes heard
+        // during the <nframes> samples the first of which reaches the DAC at
+        // <dac_time> (Clock seconds). Spikes that should already have been
+        // heard are placed at offset 0 (see late()), those more than
+        // <max_late> overdue (e.g. left over from a stopped stream) are
+        // discarded. The offsets stay valid until the next call
+        int schedule(double dac_time, int nframes, const int*& onsets);
+
+        // s, from a spike's time to it's onset at the DAC, only change it
+        // while nothing is calling schedule()
+        inline void set_latency(float latency) { _latency = latency; }
+        inline float latency() const { return _latency; }
+
+        // spikes that didn't fit in the queue (producer side) or were
+        // discarded as overdue (consumer side)
+        inline uint64_t dropped() const { return _dropped + _discarded; }
+
+        // spikes played late, i.e. that reached schedule() after their onset
+        inline uint64_t late() const { return _late; }
+
+        // s, time to onset of each spike played
+        inline const RunningStats& render_latency() const
+        {
+            return _render_latency;
+        }
+
+    public:
+        static constexpr float max_late = 0.25f;
+
+    private:
+        int _sample_rate;
+        float _latency;
+        int _length;
+
+        PaUtilRingBuffer _queue;
+        void* _data = nullptr;
+
+        // only touched by push()
+        uint64_t _dropped = 0;
+
+        // only touched by schedule(): spikes taken from the queue that aren't
+        // due yet and the onsets of the last buffer, both <_length> long so
+        // they never allocate
+        std::vector<Spike> _pending;
+        int _npending = 0;
+
+        std::vector<int> _onsets;
+
+        uint64_t _late = 0;
+        uint64_t _discarded = 0;
+        RunningStats _render_latency;
+    };
+    /* ====================================================================== */
+}
+#endif
@@ -43,6 +43,9 @@ namespace RVN
         inline void reset() { _ptr = 0; }
         inline int loc() { return _ptr; }
 
+        inline const float* data() const { return _data; }
+        inline int length() const { return _length; }
+
         inline bool isvalid() { return (_data != nullptr) && (_length > 0); }
 
     private:
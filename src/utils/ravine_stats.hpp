@@ -0,0 +1,54 @@
+#ifndef RAVINE_STATS_HPP_
+#define RAVINE_STATS_HPP_
+
+#include <cmath>
+#include <limits>
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // running mean / sd / min / max of a series of samples (e.g. latencies),
+    // O(1) per sample and no allocation so it's safe to use on the capture /
+    // audio threads
+    class RunningStats
+    {
+    public:
+        RunningStats() { reset(); }
+
+        inline void reset()
+        {
+            _n = 0;
+            _mean = 0.0;
+            _m2 = 0.0;
+            _min = std::numeric_limits<double>::max();
+            _max = std::numeric_limits<double>::lowest();
+        }
+
+        inline void add(double x)
+        {
+            // Welford's update
+            ++_n;
+            const double d = x - _mean;
+            _mean += d / _n;
+            _m2 += d * (x - _mean);
+
+            if (x < _min) { _min = x; }
+            if (x > _max) { _max = x; }
+        }
+
+        inline long count() const { return _n; }
+        inline double mean() const { return _mean; }
+        inline double sd() const { return _n > 1 ? sqrt(_m2 / (_n - 1)) : 0.0; }
+        inline double min() const { return _n > 0 ? _min : 0.0; }
+        inline double max() const { return _n > 0 ? _max : 0.0; }
+
+    private:
+        long _n;
+        double _mean;
+        double _m2;
+        double _min;
+        double _max;
+    };
+    /* ====================================================================== */
+}
+#endif
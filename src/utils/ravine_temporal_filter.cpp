@@ -0,0 +1,248 @@
+#include <sstream>
+#include <cstdio>
+#include <cmath>
+
+#include "ravine_temporal_filter.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // comma separated numbers, false if any isn't one
+    static bool parse_list(const std::string& str, std::vector<float>& out)
+    {
+        std::istringstream is(str);
+        std::string tok;
+
+        out.clear();
+        while (std::getline(is, tok, ','))
+        {
+            std::istringstream it(tok);
+            float value;
+            if (!(it >> value) || !it.eof()) { return false; }
+
+            out.push_back(value);
+        }
+
+        return !out.empty();
+    }
+    /* ---------------------------------------------------------------------- */
+    bool parse_temporal_kernel(const std::string& spec, TemporalKernel& kernel)
+    {
+        if (spec == "none")
+        {
+            kernel = TemporalKernel();
+            return true;
+        }
+
+        const size_t colon = spec.find(':');
+        if (colon == std::string::npos) { return false; }
+
+        const std::string kind = spec.substr(0, colon);
+
+        std::vector<float> values;
+        if (!parse_list(spec.substr(colon + 1), values)) { return false; }
+
+        TemporalKernel tmp;
+
+        if (kind == "biphasic")
+        {
+            if (values.size() < 2 || values.size() > 4) { return false; }
+
+            tmp.type = TemporalKernel::Type::Biphasic;
+            tmp.tau_fast = values[0] / 1000.0f;
+            tmp.tau_slow = values[1] / 1000.0f;
+            tmp.weight = values.size() > 2 ? values[2] : 1.0f;
+            tmp.order = values.size() > 3 ? (int)values[3] : 3;
+
+            if (tmp.tau_fast <= 0.0f || tmp.tau_slow <= 0.0f ||
+                tmp.weight < 0.0f || tmp.order < 1 ||
+                tmp.order > TemporalFilter::max_order ||
+                (values.size() > 3 && values[3] != tmp.order))
+            {
+                return false;
+            }
+        }
+        else if (kind == "fir")
+        {
+            if ((int)values.size() > TemporalFilter::max_taps)
+            {
+                return false;
+            }
+
+            tmp.type = TemporalKernel::Type::FIR;
+            tmp.taps = values;
+        }
+        else
+        {
+            return false;
+        }
+
+        kernel = tmp;
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    std::string kernel_name(const TemporalKernel& kernel)
+    {
+        char buf[96];
+
+        switch (kernel.type)
+        {
+        case TemporalKernel::Type::Biphasic:
+            snprintf(buf, sizeof(buf), "biphasic %.1f / %.1f ms, weight %.2f, "
+                "order %d", kernel.tau_fast * 1000.0f,
+                kernel.tau_slow * 1000.0f, kernel.weight, kernel.order);
+            return buf;
+        case TemporalKernel::Type::FIR:
+            snprintf(buf, sizeof(buf), "fir, %d taps",
+                (int)kernel.taps.size());
+            return buf;
+        default:
+            return "none";
+        }
+    }
+    /* ====================================================================== */
+    // advance an <order> stage cascade of unit gain low-passes <y> over an
+    // interval during which it's input was <x>: the deviations from <x>
+    // decay as a chain of identical poles, i.e. through the lower triangular
+    // (Toeplitz) matrix of <c> (see TemporalFilter::coefficients())
+    static float advance(float* y, int order, const float* c, float x)
+    {
+        float e[TemporalFilter::max_order];
+
+        for (int i = 0; i < order; ++i) { e[i] = y[i] - x; }
+
+        for (int i = 0; i < order; ++i)
+        {
+            float s = 0.0f;
+            for (int j = 0; j <= i; ++j) { s += c[i - j] * e[j]; }
+
+            y[i] = x + s;
+        }
+
+        return y[order - 1];
+    }
+    /* ====================================================================== */
+    bool TemporalFilter::add(const TemporalKernel& kernel)
+    {
+        Neuron n = {kernel.type, kernel.order, kernel.tau_fast,
+            kernel.tau_slow, kernel.weight, (int)_state.size(),
+            (int)_taps.size(), (int)kernel.taps.size()};
+
+        switch (kernel.type)
+        {
+        case TemporalKernel::Type::Biphasic:
+            if (kernel.tau_fast <= 0.0f || kernel.tau_slow <= 0.0f ||
+                kernel.order < 1 || kernel.order > max_order)
+            {
+                return false;
+            }
+            _state.resize(_state.size() + 2 * kernel.order, 0.0f);
+            break;
+
+        case TemporalKernel::Type::FIR:
+            if (kernel.taps.empty() || n.ntaps > max_taps) { return false; }
+
+            _state.resize(_state.size() + n.ntaps, 0.0f);
+            _taps.insert(_taps.end(), kernel.taps.begin(), kernel.taps.end());
+            break;
+
+        default:
+            break;
+        }
+
+        _neuron.push_back(n);
+        _identity = _identity && kernel.type == TemporalKernel::Type::None;
+
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    void TemporalFilter::reset()
+    {
+        _primed = false;
+        _frames = 0;
+    }
+    /* ---------------------------------------------------------------------- */
+    void TemporalFilter::coefficients(float dt, float tau, float* c) const
+    {
+        const float h = dt / tau;
+
+        c[0] = expf(-h);
+        for (int m = 1; m < max_order; ++m) { c[m] = c[m - 1] * h / m; }
+    }
+    /* ---------------------------------------------------------------------- */
+    void TemporalFilter::step(double time, float* act)
+    {
+        if (_identity) { return; }
+
+        const float dt = _primed && time > _time ? (float)(time - _time) : 0.0f;
+
+        // neurons usually share a kernel (or a few), so the coefficients are
+        // only recomputed when the time constant changes from one to the next
+        float tau_fast = -1.0f, tau_slow = -1.0f;
+        float cf[max_order], cs[max_order];
+
+        const int n = size();
+
+        for (int k = 0; k < n; ++k)
+        {
+            const Neuron& nrn = _neuron[k];
+            float* state = _state.data() + nrn.state;
+            const float x = act[k];
+
+            if (nrn.type == TemporalKernel::Type::Biphasic)
+            {
+                if (!_primed)
+                {
+                    // steady state for a constant input <x>
+                    for (int i = 0; i < 2 * nrn.order; ++i) { state[i] = x; }
+                }
+                else
+                {
+                    if (nrn.tau_fast != tau_fast)
+                    {
+                        tau_fast = nrn.tau_fast;
+                        coefficients(dt, tau_fast, cf);
+                    }
+                    if (nrn.tau_slow != tau_slow)
+                    {
+                        tau_slow = nrn.tau_slow;
+                        coefficients(dt, tau_slow, cs);
+                    }
+
+                    (void)advance(state, nrn.order, cf, x);
+                    (void)advance(state + nrn.order, nrn.order, cs, x);
+                }
+
+                act[k] = state[nrn.order - 1] -
+                    nrn.weight * state[2 * nrn.order - 1];
+            }
+            else if (nrn.type == TemporalKernel::Type::FIR)
+            {
+                // a ring of the last ntaps responses, newest at <head>
+                const int head = _frames % nrn.ntaps;
+
+                if (!_primed)
+                {
+                    for (int i = 0; i < nrn.ntaps; ++i) { state[i] = x; }
+                }
+                state[head] = x;
+
+                const float* taps = _taps.data() + nrn.taps;
+
+                float y = 0.0f;
+                for (int i = 0; i < nrn.ntaps; ++i)
+                {
+                    const int idx = head - i;
+                    y += taps[i] * state[idx < 0 ? idx + nrn.ntaps : idx];
+                }
+
+                act[k] = y;
+            }
+        }
+
+        _primed = true;
+        _time = time;
+        ++_frames;
+    }
+    /* ====================================================================== */
+}
@@ -0,0 +1,107 @@
+#ifndef RAVINE_TEMPORAL_FILTER_HPP_
+#define RAVINE_TEMPORAL_FILTER_HPP_
+
+#include <string>
+#include <vector>
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // the temporal half of a space-time separable RF: the neuron's response
+    // to a frame is this kernel applied to it's RF's (spatial) responses to
+    // that frame and the ones before it, so no past frames are needed
+    struct TemporalKernel
+    {
+        enum class Type { None, Biphasic, FIR };
+
+        Type type = Type::None;
+
+        // Biphasic: an <order> stage low-pass w/ time constant <tau_fast>
+        // (s) minus <weight> times one w/ <tau_slow>, i.e. a difference of
+        // gamma kernels: a brief positive lobe followed by a long, shallow,
+        // negative one. It's gain for a constant input is 1 - <weight>
+        float tau_fast = 0.0f;
+        float tau_slow = 0.0f;
+        float weight = 1.0f;
+        int order = 1;
+
+        // FIR: one tap per frame received, newest first
+        std::vector<float> taps;
+    };
+    /* ---------------------------------------------------------------------- */
+    // parse a kernel given as "none", "biphasic:FAST,SLOW[,WEIGHT[,ORDER]]"
+    // (time constants in ms, WEIGHT 1 and ORDER 3 by default) or
+    // "fir:T0,T1,...", e.g. "biphasic:15,60" or "fir:1,-0.5,-0.5". Returns
+    // false (and leaves <kernel> alone) if <spec> is malformed
+    bool parse_temporal_kernel(const std::string& spec, TemporalKernel& kernel);
+
+    // a short description of <kernel>, for logging
+    std::string kernel_name(const TemporalKernel& kernel);
+    /* ====================================================================== */
+    // a bank of temporal kernels, one per neuron, each w/ O(1) state: 2 x
+    // <order> floats for a biphasic kernel, the last few responses for an
+    // FIR one
+    //
+    // the biphasic kernels follow the frames' timestamps rather than
+    // counting frames, so a dropped or late frame is accounted for: each
+    // response is taken to hold over the interval since the frame before it
+    // (the exposure that produced it), and the cascade is advanced over
+    // that interval exactly, whatever it's length
+    class TemporalFilter
+    {
+    public:
+        static constexpr int max_order = 8;
+        static constexpr int max_taps = 64;
+
+        // the next neuron gets <kernel>, false if the kernel is invalid
+        bool add(const TemporalKernel& kernel);
+
+        inline int size() const { return _neuron.size(); }
+
+        // true if no neuron has a kernel, step() is then a no-op
+        inline bool is_identity() const { return _identity; }
+
+        // replace each neuron's spatial response (in <act>) to the frame at
+        // <time> (s) w/ it's spatiotemporal response, frames must come in
+        // order. The first frame after a reset() is taken as having been
+        // seen forever, so that there's no onset transient
+        void step(double time, float* act);
+
+        // forget all past responses (e.g. when the stream restarts)
+        void reset();
+
+    private:
+        struct Neuron
+        {
+            TemporalKernel::Type type;
+            int order;
+            float tau_fast;
+            float tau_slow;
+            float weight;
+
+            // into _state: order fast then order slow stages, or the ring of
+            // past responses, and for FIR into _taps
+            int state;
+            int taps;
+            int ntaps;
+        };
+
+        // c[m] = e^-h h^m / m! for h = <dt> / <tau>
+        void coefficients(float dt, float tau, float* c) const;
+
+    private:
+        std::vector<Neuron> _neuron;
+        std::vector<float> _state;
+        std::vector<float> _taps;
+
+        bool _identity = true;
+
+        bool _primed = false;
+        double _time = 0.0;
+
+        // frames since the reset, for the FIR rings
+        unsigned _frames = 0;
+    };
+    /* ====================================================================== */
+}
+#endif
@@ -0,0 +1,160 @@
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "ravine_thread_policy.hpp"
+
+#define NROLE 4
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // indexed by ThreadRole
+    static ThreadPolicy policies[NROLE];
+    /* ---------------------------------------------------------------------- */
+    const char* role_name(ThreadRole role)
+    {
+        switch (role)
+        {
+            case ThreadRole::Capture: return "capture";
+            case ThreadRole::Compute: return "compute";
+            case ThreadRole::Audio: return "audio";
+            default: return "io";
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void set_thread_policy(ThreadRole role, const ThreadPolicy& policy)
+    {
+        policies[(int)role] = policy;
+        policies[(int)role].isset = true;
+    }
+    /* ---------------------------------------------------------------------- */
+    const ThreadPolicy& get_thread_policy(ThreadRole role)
+    {
+        return policies[(int)role];
+    }
+    /* ---------------------------------------------------------------------- */
+    bool parse_thread_policy(const std::string& spec)
+    {
+        const size_t eq = spec.find('=');
+        if (eq == std::string::npos) { return false; }
+
+        const std::string name = spec.substr(0, eq);
+
+        const ThreadRole roles[] = {ThreadRole::Capture, ThreadRole::Compute,
+            ThreadRole::Audio, ThreadRole::IO};
+
+        int idx = -1;
+        for (int k = 0; k < NROLE; ++k)
+        {
+            if (name == role_name(roles[k])) { idx = k; }
+        }
+        if (idx < 0) { return false; }
+
+        // SCHED[:PRIO] and the optional @CPU,CPU...
+        std::string sched = spec.substr(eq + 1);
+        std::string cpus;
+
+        const size_t at = sched.find('@');
+        if (at != std::string::npos)
+        {
+            cpus = sched.substr(at + 1);
+            sched.resize(at);
+        }
+
+        ThreadPolicy policy;
+
+        const size_t colon = sched.find(':');
+        const std::string kind = sched.substr(0, colon);
+
+        if (kind == "fifo")
+        {
+            if (colon == std::string::npos) { return false; }
+
+            std::istringstream is(sched.substr(colon + 1));
+            if (!(is >> policy.priority) || !is.eof()) { return false; }
+
+            if (policy.priority < sched_get_priority_min(SCHED_FIFO) ||
+                policy.priority > sched_get_priority_max(SCHED_FIFO))
+            {
+                return false;
+            }
+            policy.fifo = true;
+        }
+        else if (kind != "other" || colon != std::string::npos)
+        {
+            return false;
+        }
+
+        if (!cpus.empty())
+        {
+            std::istringstream is(cpus);
+            std::string tok;
+            while (std::getline(is, tok, ','))
+            {
+                std::istringstream it(tok);
+                int cpu;
+                if (!(it >> cpu) || !it.eof() || cpu < 0 || cpu >= CPU_SETSIZE)
+                {
+                    return false;
+                }
+                policy.cpus.push_back(cpu);
+            }
+        }
+
+        set_thread_policy(roles[idx], policy);
+
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    void apply_thread_policy(ThreadRole role, const char* name)
+    {
+        pthread_t self = pthread_self();
+
+        // the kernel keeps 15 characters (+ the terminating null)
+        char short_name[16];
+        strncpy(short_name, name, sizeof(short_name) - 1);
+        short_name[sizeof(short_name) - 1] = '\0';
+
+        pthread_setname_np(self, short_name);
+
+        const ThreadPolicy& policy = get_thread_policy(role);
+
+        if (!policy.isset) { return; }
+
+        sched_param param = {};
+        param.sched_priority = policy.fifo ? policy.priority : 0;
+
+        int err = pthread_setschedparam(self,
+            policy.fifo ? SCHED_FIFO : SCHED_OTHER, &param);
+
+        if (err != 0)
+        {
+            printf("[THREAD]: failed to set the %s policy of %s: %s\n",
+                role_name(role), short_name, strerror(err));
+        }
+
+        if (!policy.cpus.empty())
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+
+            for (size_t k = 0; k < policy.cpus.size(); ++k)
+            {
+                CPU_SET(policy.cpus[k], &set);
+            }
+
+            err = pthread_setaffinity_np(self, sizeof(set), &set);
+
+            if (err != 0)
+            {
+                printf("[THREAD]: failed to pin %s to it's CPUs: %s\n",
+                    short_name, strerror(err));
+            }
+        }
+    }
+    /* ====================================================================== */
+}
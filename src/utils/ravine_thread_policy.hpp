@@ -0,0 +1,70 @@
+#ifndef RAVINE_THREAD_POLICY_HPP_
+#define RAVINE_THREAD_POLICY_HPP_
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <utility>
+#include <functional>
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // what a thread does, every thread we spawn (and PortAudio's callback
+    // thread) has one, and gets that role's ThreadPolicy:
+    //      Capture - V4L2 / CaptureManager frame capture
+    //      Compute - model filters (neuron, population, response map)
+    //      Audio   - PortAudio callback
+    //      IO      - file writers and the event (TCP) listener
+    enum class ThreadRole { Capture, Compute, Audio, IO };
+
+    const char* role_name(ThreadRole role);
+    /* ====================================================================== */
+    struct ThreadPolicy
+    {
+        // SCHED_FIFO w/ <priority> (1 - 99) if true, otherwise SCHED_OTHER
+        bool fifo = false;
+        int priority = 0;
+
+        // CPUs the thread may run on, empty for any
+        std::vector<int> cpus;
+
+        // false until set, threads w/ unset policies are only named
+        bool isset = false;
+    };
+    /* ---------------------------------------------------------------------- */
+    // set the policy of every thread of <role> spawned from now on, not
+    // thread safe: only call this from main() before any streams are opened
+    void set_thread_policy(ThreadRole role, const ThreadPolicy& policy);
+    const ThreadPolicy& get_thread_policy(ThreadRole role);
+
+    // parse and set a policy given as "ROLE=SCHED[:PRIO][@CPU[,CPU...]]"
+    // where ROLE is capture, compute, audio or io and SCHED is fifo or other,
+    // e.g. "capture=fifo:80@2" or "io=other@0,1". Returns false (and sets
+    // nothing) if <spec> is malformed
+    bool parse_thread_policy(const std::string& spec);
+
+    // name the calling thread <name> (at most 15 characters are kept) and
+    // apply <role>'s policy to it, a policy that can't be applied (e.g.
+    // SCHED_FIFO w/o the needed privileges) is reported but not fatal
+    void apply_thread_policy(ThreadRole role, const char* name);
+    /* ---------------------------------------------------------------------- */
+    // std::thread(f, args...), but the thread first calls
+    // apply_thread_policy(<role>, <name>), <name> must outlive the thread
+    // (i.e. a string literal)
+    template <class F, class... Args>
+    std::thread spawn_thread(ThreadRole role, const char* name, F&& f,
+        Args&&... args)
+    {
+        auto task = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
+
+        return std::thread([role, name, task]() mutable
+            {
+                apply_thread_policy(role, name);
+                task();
+            }
+        );
+    }
+    /* ====================================================================== */
+}
+#endif
@@ -30,9 +30,9 @@ namespace RVN
     }
     /* ---------------------------------------------------------------------- */
     template <typename T>
-    void delete_queue(std::queue<T*> q)
+    void delete_queue(std::queue<T*>& q)
     {
-        for (int k = 0; k < q.size(); ++k)
+        while (!q.empty())
         {
             T* tmp = pop_queue(q);
             if (tmp != nullptr)
@@ -0,0 +1,182 @@
+#include "ravine_simd.hpp"
+#include "ravine_packets.hpp"
+#include "ravine_voice_pool.hpp"
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // <dst> += <src> over <n> samples
+    static void add(float* dst, const float* src, int n)
+    {
+        int k = 0;
+
+#if defined(RVN_SIMD_AVX2)
+        for (; k + 8 <= n; k += 8)
+        {
+            _mm256_storeu_ps(dst + k, _mm256_add_ps(_mm256_loadu_ps(dst + k),
+                _mm256_loadu_ps(src + k)));
+        }
+#elif defined(RVN_SIMD_SSE2)
+        for (; k + 4 <= n; k += 4)
+        {
+            _mm_storeu_ps(dst + k, _mm_add_ps(_mm_loadu_ps(dst + k),
+                _mm_loadu_ps(src + k)));
+        }
+#elif defined(RVN_SIMD_NEON)
+        for (; k + 4 <= n; k += 4)
+        {
+            vst1q_f32(dst + k, vaddq_f32(vld1q_f32(dst + k),
+                vld1q_f32(src + k)));
+        }
+#endif
+
+        for (; k < n; ++k) { dst[k] += src[k]; }
+    }
+    /* ---------------------------------------------------------------------- */
+    // <dst> = <value> over <n> samples
+    static void fill(float* dst, float value, int n)
+    {
+        int k = 0;
+
+#if defined(RVN_SIMD_AVX2)
+        const __m256 v = _mm256_set1_ps(value);
+        for (; k + 8 <= n; k += 8) { _mm256_storeu_ps(dst + k, v); }
+#elif defined(RVN_SIMD_SSE2)
+        const __m128 v = _mm_set1_ps(value);
+        for (; k + 4 <= n; k += 4) { _mm_storeu_ps(dst + k, v); }
+#elif defined(RVN_SIMD_NEON)
+        const float32x4_t v = vdupq_n_f32(value);
+        for (; k + 4 <= n; k += 4) { vst1q_f32(dst + k, v); }
+#endif
+
+        for (; k < n; ++k) { dst[k] = value; }
+    }
+    /* ---------------------------------------------------------------------- */
+    // <out> = <out> x <gate> + <mix> over <n> samples, <gate> and <mix>
+    // aligned
+    static void blend(float* out, const float* gate, const float* mix, int n)
+    {
+        int k = 0;
+
+#if defined(RVN_SIMD_AVX2)
+        for (; k + 8 <= n; k += 8)
+        {
+            _mm256_storeu_ps(out + k, _mm256_fmadd_ps(_mm256_loadu_ps(out + k),
+                _mm256_load_ps(gate + k), _mm256_load_ps(mix + k)));
+        }
+#elif defined(RVN_SIMD_SSE2)
+        for (; k + 4 <= n; k += 4)
+        {
+            _mm_storeu_ps(out + k, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(out + k),
+                _mm_load_ps(gate + k)), _mm_load_ps(mix + k)));
+        }
+#elif defined(RVN_SIMD_NEON)
+        for (; k + 4 <= n; k += 4)
+        {
+            vst1q_f32(out + k, vmlaq_f32(vld1q_f32(mix + k),
+                vld1q_f32(out + k), vld1q_f32(gate + k)));
+        }
+#endif
+
+        for (; k < n; ++k) { out[k] = out[k] * gate[k] + mix[k]; }
+    }
+    /* ====================================================================== */
+    VoicePool::VoicePool(const float* waveform, int length, int capacity,
+        int max_block) :
+        _waveform(waveform), _length(length), _capacity(capacity),
+        _max_block(max_block), _max_voices(capacity)
+    {
+        if (_waveform == nullptr || _length < 1 || _capacity < 1 ||
+            _max_block < 1)
+        {
+            return;
+        }
+
+        _voice = new Voice[_capacity];
+
+        // the out buffer (PortAudio's) isn't necessarily aligned, these are
+        _mix = alloc_aligned<float>(simd_stride(_max_block));
+        _gate = alloc_aligned<float>(simd_stride(_max_block));
+    }
+    /* ---------------------------------------------------------------------- */
+    VoicePool::~VoicePool()
+    {
+        if (_voice != nullptr) { delete[] _voice; }
+
+        free_aligned(_mix);
+        free_aligned(_gate);
+    }
+    /* ---------------------------------------------------------------------- */
+    bool VoicePool::set_max_voices(int n)
+    {
+        if (n < 1 || n > _capacity) { return false; }
+
+        _max_voices = n;
+        return true;
+    }
+    /* ---------------------------------------------------------------------- */
+    void VoicePool::play(Voice& voice, int end)
+    {
+        const int n = RVN_MIN(end - voice.begin, _length - voice.pos);
+        if (n > 0)
+        {
+            add(_mix + voice.begin, _waveform + voice.pos, n);
+            fill(_gate + voice.begin, 0.0f, n);
+
+            voice.pos += n;
+            voice.begin += n;
+        }
+    }
+    /* ---------------------------------------------------------------------- */
+    void VoicePool::render(const int* onsets, int nonsets, float* out,
+        int nframes)
+    {
+        if (!isvalid()) { return; }
+
+        nframes = RVN_MIN(nframes, _max_block);
+
+        fill(_mix, 0.0f, nframes);
+        fill(_gate, 1.0f, nframes);
+
+        for (int j = 0; j < nonsets; ++j)
+        {
+            const int onset = onsets[j];
+
+            // voices that end by the onset play out in full, as the oldest
+            // ends first these are all at the front
+            while (_nactive > 0 &&
+                oldest().begin + _length - oldest().pos <= onset)
+            {
+                play(oldest(), nframes);
+                pop();
+            }
+
+            // no room, the oldest voice stops here
+            while (_nactive >= _max_voices)
+            {
+                play(oldest(), onset);
+                pop();
+                ++_stolen;
+            }
+
+            Voice& voice = _voice[(_head + _nactive) % _capacity];
+            voice.pos = 0;
+            voice.begin = onset;
+            ++_nactive;
+        }
+
+        // the rest play to the end of the block, or of the waveform
+        for (int j = 0; j < _nactive; ++j)
+        {
+            Voice& voice = _voice[(_head + j) % _capacity];
+
+            play(voice, nframes);
+            voice.begin = 0;
+        }
+
+        while (_nactive > 0 && oldest().pos >= _length) { pop(); }
+
+        blend(out, _gate, _mix, nframes);
+    }
+    /* ====================================================================== */
+}
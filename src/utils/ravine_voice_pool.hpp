@@ -0,0 +1,90 @@
+#ifndef RAVINE_VOICE_POOL_HPP_
+#define RAVINE_VOICE_POOL_HPP_
+
+#include <cinttypes>
+
+namespace RVN
+{
+    /* ====================================================================== */
+    // plays any number of overlapping copies ("voices") of a spike waveform,
+    // mixed additively, one block of samples at a time. Voices all have the
+    // same length and start in order, so they also end in order and live in
+    // a FIFO: when all max_voices() are playing a new spike takes over the
+    // oldest one. Nothing is allocated after construction
+    class VoicePool
+    {
+    public:
+        // voices of <waveform> (<length> samples, not owned, it has to
+        // outlive the pool), at most <capacity> at once, in blocks of at most
+        // <max_block> samples
+        VoicePool(const float* waveform, int length, int capacity = 256,
+            int max_block = 1024);
+        ~VoicePool();
+
+        inline bool isvalid() const
+        {
+            return _voice != nullptr && _mix != nullptr && _gate != nullptr;
+        }
+
+        // at most <n> (1 to the capacity) voices at once, only change it
+        // while nothing is calling render()
+        bool set_max_voices(int n);
+        inline int max_voices() const { return _max_voices; }
+
+        // voices still playing
+        inline int active() const { return _nactive; }
+
+        // voices cut short to make room for a new one
+        inline uint64_t stolen() const { return _stolen; }
+
+        // a voice starts at each of the <nonsets> <onsets> (sample offsets
+        // w/in the block, in order, repeats each get their own voice), then
+        // wherever any voice is playing during the <nframes> samples of <out>
+        // it's contents (e.g. background noise) are replaced by the sum of
+        // the voices, left as is everywhere else. The sum isn't scaled
+        void render(const int* onsets, int nonsets, float* out, int nframes);
+
+        // stop every voice
+        inline void reset() { _head = _nactive = 0; }
+
+    private:
+        struct Voice
+        {
+            // next sample of the waveform, and the offset w/in the current
+            // block that it plays at
+            int pos;
+            int begin;
+        };
+
+        inline Voice& oldest() { return _voice[_head]; }
+        inline void pop()
+        {
+            _head = (_head + 1) % _capacity;
+            --_nactive;
+        }
+
+        // mix <voice> into the block up to (not including) sample <end>
+        void play(Voice& voice, int end);
+
+    private:
+        const float* _waveform;
+        int _length;
+
+        int _capacity;
+        int _max_block;
+        int _max_voices;
+
+        // FIFO of the playing voices, oldest at <_head>
+        Voice* _voice = nullptr;
+        int _head = 0;
+        int _nactive = 0;
+
+        uint64_t _stolen = 0;
+
+        // sum of the voices and where none is playing (1) over a block
+        float* _mix = nullptr;
+        float* _gate = nullptr;
+    };
+    /* ====================================================================== */
+}
+#endif